@@ -21,6 +21,7 @@ CONFIG += ordered
 SUBDIRS += \
     libqrencode \
     libSESAM \
+    mkpwdict \
     SESAM2Chrome \
     Qt-SESAM \
     UnitTests
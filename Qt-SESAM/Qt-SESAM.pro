@@ -60,6 +60,7 @@ SOURCES += main.cpp \
     tcpclient.cpp \
     keepass2xmlreader.cpp \
     hackhelper.cpp \
+    saltsearch.cpp \
     expandablegroupbox.cpp \
     logger.cpp \
     passwordsafereader.cpp
@@ -71,6 +72,7 @@ HEADERS  += \
     global.h \
     masterpassworddialog.h \
     hackhelper.h \
+    saltsearch.h \
     servercertificatewidget.h \
     changemasterpassworddialog.h \
     passwordchecker.h \
@@ -22,6 +22,7 @@
 #include "changemasterpassworddialog.h"
 #include "ui_changemasterpassworddialog.h"
 #include "passwordchecker.h"
+#include "strengthestimator.h"
 #include "util.h"
 
 
@@ -37,6 +38,7 @@ public:
   }
 
   PasswordChecker *passwordChecker;
+  StrengthEstimator strengthEstimator;
 };
 
 
@@ -63,6 +65,8 @@ ChangeMasterPasswordDialog::~ChangeMasterPasswordDialog()
 
 void ChangeMasterPasswordDialog::invalidate(void)
 {
+  Q_D(ChangeMasterPasswordDialog);
+  d->strengthEstimator.clear();
   SecureErase(ui->currentPasswordLineEdit->text());
   SecureErase(ui->newPasswordLineEdit1->text());
   SecureErase(ui->newPasswordLineEdit2->text());
@@ -123,15 +127,17 @@ void ChangeMasterPasswordDialog::comparePasswords(void)
     QString grade;
     QColor color;
     if (d->passwordChecker != Q_NULLPTR) {
-      qint64 pos = d->passwordChecker->findInPasswordFile(password);
+      quint32 breachCount = 0;
+      qint64 pos = d->passwordChecker->findInPasswordFile(password, &breachCount);
       found = (pos >= 0);
       if (found) {
-        grade = tr("Listed");
+        grade = (breachCount > 0) ? tr("Listed (%1 breaches)").arg(breachCount) : tr("Listed");
         color.setRgb(147, 209, 240);
       }
     }
     if (!found) {
-      PasswordChecker::evaluatePasswordStrength(ui->newPasswordLineEdit1->text(), color, grade, Q_NULLPTR);
+      d->strengthEstimator.setPassword(password);
+      PasswordChecker::evaluatePasswordStrength(d->strengthEstimator, color, grade);
     }
     ui->strengthLabel->setText(tr("%1").arg(grade));
     ui->strengthLabel->setStyleSheet(QString("background-color: rgb(%1, %2, %3); font-weight: bold").arg(color.red()).arg(color.green()).arg(color.blue()));
@@ -18,9 +18,12 @@
 */
 
 #include <limits>
+#include <cmath>
 #include "easyselectorwidget.h"
 #include "util.h"
 #include "password.h"
+#include "cryptoexecutor.h"
+#include "strengthestimator.h"
 #include <QDebug>
 #include <QSizePolicy>
 #include <QPainter>
@@ -39,6 +42,8 @@
 const int EasySelectorWidget::DefaultMinLength = 4;
 const int EasySelectorWidget::DefaultMaxLength = 36;
 
+static const int SpeedTestMSecs = 3000;
+
 
 class EasySelectorWidgetPrivate {
 public:
@@ -86,6 +91,7 @@ EasySelectorWidget::~EasySelectorWidget()
 {
   Q_D(EasySelectorWidget);
   onSpeedTestAbort();
+  CryptoExecutor::instance().cancel("speedTest");
   d->speedTestFuture.waitForFinished();
 }
 
@@ -343,9 +349,6 @@ bool EasySelectorWidget::tooltipTextAt(const QPoint &pos, QString &helpText) con
 qreal EasySelectorWidget::sha1Secs(int length, int complexityValue, qreal sha1PerSec) const
 {
   int charCount = 0;
-  if (qFuzzyIsNull(sha1PerSec)) {
-    return std::numeric_limits<qreal>::infinity();
-  }
   Password::Complexity complexity = Password::Complexity::fromValue(complexityValue);
   if (complexity.digits) {
     charCount += Password::Digits.count();
@@ -359,11 +362,9 @@ qreal EasySelectorWidget::sha1Secs(int length, int complexityValue, qreal sha1Pe
   if (complexity.extra) {
     charCount += d_ptr->extraCharCount;
   }
-  static const int Iterations = 1;
-  const qreal perms = qPow(charCount, length);
-  const qreal t2secs = perms * Iterations / sha1PerSec;
-  return .5 * t2secs;
-
+  // generated passwords are random, so an attacker has to try every combination
+  const qreal guessesLog10 = length * std::log10(qreal(charCount));
+  return StrengthEstimator::crackSeconds(guessesLog10, sha1PerSec);
 }
 
 
@@ -411,8 +412,9 @@ void EasySelectorWidget::setMaxLength(int maxLength)
 void EasySelectorWidget::onSpeedTestBegin(void)
 {
   Q_D(EasySelectorWidget);
-  QTimer::singleShot(3000, this, SLOT(onSpeedTestAbort()));
-  d->speedTestFuture = QtConcurrent::run(this, &EasySelectorWidget::speedTest);
+  d->speedTestFuture = CryptoExecutor::instance().run(CryptoExecutor::Background, "speedTest", [this]() {
+    speedTest();
+  });
 }
 
 
@@ -430,6 +432,13 @@ void EasySelectorWidget::onSpeedTestAbort(void)
 }
 
 
+/*!
+ * \brief EasySelectorWidget::speedTest
+ *
+ * Measures SHA-1 throughput for `SpeedTestMSecs` from the moment the task
+ * actually starts, so time spent waiting in the `CryptoExecutor` queue
+ * doesn't cut the measurement short.
+ */
 void EasySelectorWidget::speedTest(void)
 {
   Q_D(EasySelectorWidget);
@@ -439,7 +448,7 @@ void EasySelectorWidget::speedTest(void)
   QElapsedTimer t;
   t.start();
   qint64 n = 0;
-  while (!d->doAbortSpeedTest && t.elapsed() < 5000) {
+  while (!d->doAbortSpeedTest && t.elapsed() < SpeedTestMSecs) {
     for (auto d = data.begin(); d != data.end(); ++d) {
       *d = qrand() & 0xff;
     }
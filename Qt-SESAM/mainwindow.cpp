@@ -35,7 +35,10 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QFile>
+#include <QSaveFile>
+#include <QBuffer>
 #include <QFileInfo>
+#include <QCryptographicHash>
 #include <QFileDialog>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -77,9 +80,20 @@
 #include "expandablegroupbox.h"
 #if HACKING_MODE_ENABLED
 #include "hackhelper.h"
+#include "saltsearch.h"
 #endif
+#include "hashbackend.h"
+#include "iterationcalibrator.h"
 #include "pbkdf2.h"
 #include "password.h"
+#include "passwordscheduler.h"
+#include "derivedkeycache.h"
+#include "saltkeyivpool.h"
+#include "speculativederiver.h"
+#include "derivation.h"
+#include "cryptoexecutor.h"
+#include "passwordbatch.h"
+#include "vaultaudit.h"
 #include "crypter.h"
 #include "securebytearray.h"
 #include "securestring.h"
@@ -93,6 +107,10 @@
 
 static const int DefaultMasterPasswordInvalidationTimeMins = 5;
 static const bool CompressionEnabled = true;
+#if HACKING_MODE_ENABLED
+static const int HackShardCount = 4;
+static const qint64 HackCheckpointIntervalMSecs = 30 * 1000;
+#endif
 static const int NotFound = -1;
 
 enum TabIndexes {
@@ -134,11 +152,12 @@ public:
     , expandableGroupBox(new ExpandableGroupbox)
     , expandableGroupBoxLastExpanded(false)
 #if HACKING_MODE_ENABLED
-    , hackIterationDurationMs(0)
     , hackSalt(4, 0)
-    , hackPermutations(1)
+    , hackShardLock(Q_NULLPTR)
     , hackingMode(false)
 #endif
+    , passwordScheduler(&password)
+    , speculativeDeriver(&derivedKeyCache)
     , trayIcon(QIcon(":/images/ctSESAM.ico"))
     , salt(Crypter::generateSalt())
     , deleteReply(Q_NULLPTR)
@@ -196,15 +215,18 @@ public:
   ExpandableGroupbox *expandableGroupBox;
   bool expandableGroupBoxLastExpanded;
 #if HACKING_MODE_ENABLED
-  qint64 hackIterationDurationMs;
-  QElapsedTimer hackClock;
-  QElapsedTimer hackIterationClock;
+  SaltSearch saltSearch;
   QByteArray hackSalt;
   PositionTable hackPos;
-  qint64 hackPermutations;
+  QString hackStateBaseName;
+  QLockFile *hackShardLock;
+  QElapsedTimer hackCheckpointClock;
   bool hackingMode;
 #endif
   Password password;
+  PasswordScheduler passwordScheduler;
+  DerivedKeyCache derivedKeyCache;
+  SpeculativeDeriver speculativeDeriver;
   QDateTime createdDate;
   QDateTime modifiedDate;
   QSystemTrayIcon trayIcon;
@@ -213,6 +235,7 @@ public:
   SecureByteArray IV;
   SecureByteArray KGK;
   QFuture<void> keyGenerationFuture;
+  SaltKeyIVPool saltKeyIVPool;
   QMutex keyGenerationMutex;
   QString masterPassword;
   QSslConfiguration sslConf;
@@ -229,6 +252,12 @@ public:
   int masterPasswordChangeStep;
   QSemaphore interactionSemaphore;
   QFuture<void> backupFileDeletionFuture;
+  QFuture<void> hashBenchmarkFuture;
+  QFutureWatcher<void> auditWatcher;
+  CancellationToken auditToken;
+  QScopedPointer<PasswordChecker> auditPasswordChecker;
+  QVector<VaultAudit::Finding> auditFindings;
+  QMetaObject::Connection auditCancelConnection;
   TcpClient tcpClient;
   bool doConvertLocalToLegacy;
   QLockFile *lockFile;
@@ -355,6 +384,8 @@ MainWindow::MainWindow(bool forceStart, QWidget *parent)
   QObject::connect(ui->actionImportKGK, SIGNAL(triggered(bool)), SLOT(onImportKGK()));
   QObject::connect(ui->actionKeePassXmlFile, SIGNAL(triggered(bool)), SLOT(onImportKeePass2XmlFile()));
   QObject::connect(ui->actionPasswordSafeFile, SIGNAL(triggered(bool)), SLOT(onImportPasswordSafeFile()));
+  QObject::connect(ui->actionAuditVault, SIGNAL(triggered(bool)), SLOT(onAuditVault()));
+  QObject::connect(&d->auditWatcher, SIGNAL(finished()), SLOT(onVaultAuditFinished()));
   QObject::connect(d->optionsDialog, SIGNAL(serverCertificatesUpdated(QList<QSslCertificate>)), SLOT(onServerCertificatesUpdated(QList<QSslCertificate>)));
   QObject::connect(d->masterPasswordDialog, SIGNAL(accepted()), SLOT(onMasterPasswordEntered()));
   QObject::connect(d->masterPasswordDialog, SIGNAL(closing()), SLOT(onMasterPasswordClosing()), Qt::DirectConnection);
@@ -363,16 +394,22 @@ MainWindow::MainWindow(bool forceStart, QWidget *parent)
   QObject::connect(ui->actionDeleteOldBackupFiles, SIGNAL(triggered(bool)), SLOT(removeOutdatedBackupFiles()));
 #if HACKING_MODE_ENABLED
   QObject::connect(ui->actionHackLegacyPassword, SIGNAL(triggered(bool)), SLOT(hackLegacyPassword()));
+  QObject::connect(&d->saltSearch, SIGNAL(progress(qint64, qreal, qreal)), SLOT(onSaltSearchProgress(qint64, qreal, qreal)));
+  QObject::connect(&d->saltSearch, SIGNAL(found(QByteArray, QString)), SLOT(onSaltSearchFound(QByteArray, QString)));
+  QObject::connect(&d->saltSearch, SIGNAL(finished()), SLOT(onSaltSearchFinished()));
 #else
   ui->actionHackLegacyPassword->setVisible(false);
 #endif
   QObject::connect(ui->actionRegenerateSaltKeyIV, SIGNAL(triggered(bool)), SLOT(generateSaltKeyIV()));
   QObject::connect(this, SIGNAL(saltKeyIVGenerated()), SLOT(onGeneratedSaltKeyIV()), Qt::ConnectionType::QueuedConnection);
+  QObject::connect(this, SIGNAL(hashBackendsBenchmarked()), SLOT(onHashBackendsBenchmarked()), Qt::ConnectionType::QueuedConnection);
   QObject::connect(d->progressDialog, SIGNAL(cancelled()), SLOT(cancelServerOperation()));
 
+  d->password.setKeyCache(&d->derivedKeyCache);
   QObject::connect(&d->password, SIGNAL(generated()), SLOT(onPasswordGenerated()));
   QObject::connect(&d->password, SIGNAL(generationAborted()), SLOT(onPasswordGenerationAborted()));
   QObject::connect(&d->password, SIGNAL(generationStarted()), SLOT(onPasswordGenerationStarted()));
+  QObject::connect(&d->password, SIGNAL(generationProgress(int, int, qreal, qreal)), SLOT(onPasswordGenerationProgress(int, int, qreal, qreal)));
 
   QObject::connect(&d->tcpClient, SIGNAL(receivedMessage(QJsonDocument)), SLOT(onMessageFromTcpClient(QJsonDocument)));
 
@@ -434,6 +471,9 @@ MainWindow::MainWindow(bool forceStart, QWidget *parent)
   ui->statusBar->addPermanentWidget(d->countdownWidget);
   setDirty(false);
   ui->tabWidget->setCurrentIndex(TabGeneratedPassword);
+  d->hashBenchmarkFuture = CryptoExecutor::instance().run(CryptoExecutor::Normal, "benchmark", [this]() {
+    benchmarkHashBackendsThread();
+  });
   enterMasterPassword();
 }
 
@@ -508,6 +548,9 @@ void MainWindow::closeEvent(QCloseEvent *e)
   Q_D(MainWindow);
   cancelPasswordGeneration();
   d->backupFileDeletionFuture.waitForFinished();
+  d->hashBenchmarkFuture.waitForFinished();
+  d->auditToken.cancel();
+  d->auditWatcher.waitForFinished();
   saveSettings();
   if (d->parameterSetDirty && !ui->domainsComboBox->currentText().isEmpty()) {
     QMessageBox::StandardButton button = saveYesNoCancel();
@@ -722,6 +765,9 @@ void MainWindow::cancelPasswordGeneration(void)
   Q_D(MainWindow);
 #if HACKING_MODE_ENABLED
   if (d->hackingMode) {
+    d->saltSearch.cancel();
+    saveHackCheckpoint();
+    releaseHackShard();
     d->hackingMode = false;
     ui->renewSaltPushButton->setEnabled(true);
     ui->legacyPasswordLineEdit->setReadOnly(false);
@@ -847,7 +893,28 @@ void MainWindow::restartInvalidationTimer(void)
 
 void MainWindow::onPasswordGenerationStarted(void)
 {
-  // do nothing
+#if HACKING_MODE_ENABLED
+  Q_D(MainWindow);
+  if (d->hackingMode)
+    return;
+#endif
+  ui->statusBar->showMessage(tr("Generating password ..."));
+}
+
+
+void MainWindow::onPasswordGenerationProgress(int iterationsDone, int iterations, qreal iterationsPerSecond, qreal secondsRemaining)
+{
+  Q_D(MainWindow);
+#if HACKING_MODE_ENABLED
+  if (d->hackingMode)
+    return;
+#endif
+  if (d->password.isAborted())
+    return;
+  ui->statusBar->showMessage(tr("Generating password ... %1% (%2 iterations/s, %3 s remaining)")
+                             .arg(100 * qint64(iterationsDone) / iterations)
+                             .arg(iterationsPerSecond, 0, 'f', 0)
+                             .arg(secondsRemaining, 0, 'f', 1));
 }
 
 
@@ -857,14 +924,11 @@ void MainWindow::updatePassword(void)
   // qDebug() << "MainWindow::updatePassword() triggered by" << (sender() ? sender()->objectName() : "NONE");
   if (!d->masterPassword.isEmpty()) {
     if (ui->legacyPasswordLineEdit->text().isEmpty()) {
-      stopPasswordGeneration();
-#if HACKING_MODE_ENABLED
-      if (!d->hackingMode) {
+      d->passwordScheduler.request(d->KGK, collectedDomainSettings());
+      if (d->passwordScheduler.hasPendingRequest()) {
         ui->generatedPasswordLineEdit->setText(QString());
         ui->statusBar->showMessage(QString());
       }
-#endif
-      d->password.generateAsync(d->KGK, collectedDomainSettings());
     }
     else {
       ui->generatedPasswordLineEdit->setText(QString());
@@ -997,16 +1061,17 @@ void MainWindow::setTemplate(void)
 void MainWindow::stopPasswordGeneration(void)
 {
   Q_D(MainWindow);
-  if (d->password.isRunning()) {
-    d->password.abortGeneration();
-    d->password.waitForFinished();
-  }
+  d->passwordScheduler.cancel();
 }
 
 
 void MainWindow::changeMasterPassword(void)
 {
   Q_D(MainWindow);
+  if (d->auditWatcher.isRunning()) {
+    ui->statusBar->showMessage(tr("Cannot change the master password while the vault audit is running."), 3000);
+    return;
+  }
   int rc = QMessageBox::Yes;
   if (!d->optionsDialog->syncToFileEnabled() && !d->optionsDialog->syncToServerEnabled()) {
     rc = QMessageBox::warning(this,
@@ -1033,6 +1098,7 @@ void MainWindow::changeMasterPassword(void)
       else {
         saveAllDomainDataToSettings();
         d->masterPassword = d->changeMasterPasswordDialog->newPassword();
+        d->saltKeyIVPool.setMasterPassword(d->masterPassword.toUtf8());
         d->keyGenerationFuture.waitForFinished();
         generateSaltKeyIV().waitForFinished();
         cleanupAfterMasterPasswordChanged();
@@ -1064,6 +1130,7 @@ void MainWindow::nextChangeMasterPasswordStep(void)
   case 2:
     d->progressDialog->setValue(2);
     d->masterPassword = d->changeMasterPasswordDialog->newPassword();
+    d->saltKeyIVPool.setMasterPassword(d->masterPassword.toUtf8());
     generateSaltKeyIV().waitForFinished();
     d->progressDialog->setText(tr("Writing to sync peers ..."));
     if (d->optionsDialog->useSyncFile()) {
@@ -1127,48 +1194,86 @@ void MainWindow::onPasswordGenerated(void)
     }
 #if HACKING_MODE_ENABLED
   }
-  else { // in hacking mode
-    ui->generatedPasswordLineEdit->setText(d->password());
-    PositionTable st(d->password());
-    if (d->hackPos == st) {
-      const QString &newCharTable = d->hackPos.substitute(st, usedCharacters());
-      ui->usedCharactersPlainTextEdit->setPlainText(newCharTable);
-      d->hackingMode = false;
-      ui->renewSaltPushButton->setEnabled(true);
-      ui->legacyPasswordLineEdit->setReadOnly(false);
-      hideActivityIcons();
-      int button = QMessageBox::question(
-            this,
-            tr("Finished \"hacking\""),
-            tr("Found a salt in %1 that allows to calculate the legacy password from the domain settings :-) "
-               "The legacy password is no longer needed. "
-               "Do you want to clear the legacy password and save the new domain settings?").arg(makeHMS(d->hackClock.elapsed())));
-      if (button == QMessageBox::Yes) {
-        ui->legacyPasswordLineEdit->setText(QString());
-        ui->tabWidget->setCurrentIndex(0);
-        saveCurrentDomainSettings();
-      }
-      restartInvalidationTimer();
-    }
-    else {
-      const qint64 dt = d->hackIterationClock.restart();
-      d->hackIterationDurationMs = (d->hackIterationDurationMs > 0)
-          ? (d->hackIterationDurationMs + dt) / 2
-          : dt;
-      ui->statusBar->showMessage(
-            tr("Hacking ... t%1 (%2ms) t: %3")
-            .arg(makeHMS(d->hackClock.elapsed() - 3 * d->hackPermutations * d->hackIterationDurationMs / 2))
-            .arg(dt)
-            .arg(makeHMS(d->hackClock.elapsed()))
-            );
-      incrementEndianless(d->hackSalt);
-      ui->saltBase64LineEdit->setText(d->hackSalt.toBase64());
-    }
-  }
 #endif
 }
 
 
+#if HACKING_MODE_ENABLED
+void MainWindow::onSaltSearchProgress(qint64 candidatesTested, qreal candidatesPerSecond, qreal secondsRemaining)
+{
+  Q_D(MainWindow);
+  if (checkHackFoundByOtherProcess())
+    return;
+  if (d->hackCheckpointClock.elapsed() >= HackCheckpointIntervalMSecs) {
+    saveHackCheckpoint();
+    d->hackCheckpointClock.restart();
+  }
+  ui->statusBar->showMessage(
+        tr("Hacking ... shard %5/%6: %1 salts tested (%2/s), expected to take another %3, t: %4")
+        .arg(candidatesTested)
+        .arg(candidatesPerSecond, 0, 'f', 0)
+        .arg(makeHMS(qint64(1e3 * secondsRemaining)))
+        .arg(makeHMS(d->saltSearch.elapsedMSecs()))
+        .arg(d->saltSearch.checkpoint().shard + 1)
+        .arg(HackShardCount));
+}
+
+
+void MainWindow::onSaltSearchFound(const QByteArray &salt, const QString &password)
+{
+  Q_D(MainWindow);
+  if (!QFile::exists(d->hackStateBaseName + ".found")) {
+    QVariantMap map;
+    map["salt"] = QString::fromUtf8(salt.toBase64());
+    writeHackStateFile(d->hackStateBaseName + ".found", QJsonDocument::fromVariant(map).toJson(QJsonDocument::Compact));
+  }
+  releaseHackShard();
+  removeHackStateFiles();
+  d->hackSalt = salt;
+  ui->saltBase64LineEdit->setText(salt.toBase64());
+  ui->generatedPasswordLineEdit->setText(password);
+  const PositionTable st(password);
+  const QString &newCharTable = d->hackPos.substitute(st, usedCharacters());
+  ui->usedCharactersPlainTextEdit->setPlainText(newCharTable);
+  d->hackingMode = false;
+  ui->renewSaltPushButton->setEnabled(true);
+  ui->legacyPasswordLineEdit->setReadOnly(false);
+  hideActivityIcons();
+  int button = QMessageBox::question(
+        this,
+        tr("Finished \"hacking\""),
+        tr("Found a salt in %1 that allows to calculate the legacy password from the domain settings :-) "
+           "The legacy password is no longer needed. "
+           "Do you want to clear the legacy password and save the new domain settings?").arg(makeHMS(d->saltSearch.elapsedMSecs())));
+  if (button == QMessageBox::Yes) {
+    ui->legacyPasswordLineEdit->setText(QString());
+    ui->tabWidget->setCurrentIndex(0);
+    saveCurrentDomainSettings();
+  }
+  restartInvalidationTimer();
+}
+
+
+void MainWindow::onSaltSearchFinished(void)
+{
+  Q_D(MainWindow);
+  if (!d->hackingMode)
+    return;
+  saveHackCheckpoint();
+  releaseHackShard();
+  if (claimHackShard())
+    return;
+  removeHackStateFiles();
+  d->hackingMode = false;
+  ui->renewSaltPushButton->setEnabled(true);
+  ui->legacyPasswordLineEdit->setReadOnly(false);
+  ui->statusBar->showMessage(tr("Hacking finished after %1 without finding a matching salt.")
+                             .arg(makeHMS(d->saltSearch.elapsedMSecs())));
+  restartInvalidationTimer();
+}
+#endif
+
+
 void MainWindow::onPasswordGenerationAborted(void)
 {
   onPasswordGenerated();
@@ -1206,7 +1311,16 @@ QFuture<void> &MainWindow::generateSaltKeyIV(void)
   Q_D(MainWindow);
 //  qDebug() << "MainWindow::generateSaltKeyIV()";
   _LOG("MainWindow::generateSaltKeyIV() ...");
-  d->keyGenerationFuture = QtConcurrent::run(this, &MainWindow::generateSaltKeyIVThread);
+  SaltKeyIVPool::Entry entry;
+  if (d->saltKeyIVPool.tryTake(entry)) {
+    useSaltKeyIV(entry);
+    d->keyGenerationFuture = QFuture<void>();
+  }
+  else {
+    d->keyGenerationFuture = CryptoExecutor::instance().run(CryptoExecutor::Background, "saltKeyIV", [this]() {
+      generateSaltKeyIVThread();
+    });
+  }
   return d->keyGenerationFuture;
 }
 
@@ -1221,8 +1335,18 @@ void MainWindow::generateSaltKeyIVThread(void)
     return;
   }
   QMutexLocker(&d->keyGenerationMutex);
-  d->salt = Crypter::generateSalt();
-  Crypter::makeKeyAndIVFromPassword(d->masterPassword.toUtf8(), d->salt, d->masterKey, d->IV);
+  useSaltKeyIV(d->saltKeyIVPool.take());
+}
+
+
+void MainWindow::useSaltKeyIV(const SaltKeyIVPool::Entry &entry)
+{
+  Q_D(MainWindow);
+  if (!entry.isValid())
+    return;
+  d->salt = entry.salt;
+  d->masterKey = entry.key;
+  d->IV = entry.IV;
   emit saltKeyIVGenerated();
 }
 
@@ -1235,6 +1359,21 @@ void MainWindow::onGeneratedSaltKeyIV(void)
 }
 
 
+void MainWindow::benchmarkHashBackendsThread(void)
+{
+  HashBackendRegistry::instance().benchmark();
+  emit hashBackendsBenchmarked();
+}
+
+
+void MainWindow::onHashBackendsBenchmarked(void)
+{
+  foreach (QString line, HashBackendRegistry::instance().report()) {
+    _LOG(line);
+  }
+}
+
+
 static const QString KGKFileExtension = QObject::tr("KGK file (*.pem *.kgk)");
 
 
@@ -1565,12 +1704,14 @@ void MainWindow::makeDomainComboBox(void)
   ui->domainsComboBox->addItems(domainNames);
   if (d->completer != Q_NULLPTR) {
     QObject::disconnect(d->completer, SIGNAL(activated(QString)), this, SLOT(onDomainSelected(QString)));
+    QObject::disconnect(d->completer, SIGNAL(highlighted(QString)), this, SLOT(onDomainHighlighted(QString)));
     delete d->completer;
   }
   d->completer = new QCompleter(domainNames);
   d->completer->setCaseSensitivity(Qt::CaseInsensitive);
   d->completer->setFilterMode(Qt::MatchContains);
   QObject::connect(d->completer, SIGNAL(activated(QString)), this, SLOT(onDomainSelected(QString)));
+  QObject::connect(d->completer, SIGNAL(highlighted(QString)), this, SLOT(onDomainHighlighted(QString)));
   ui->domainsComboBox->setCompleter(d->completer);
   ui->domainsComboBox->setCurrentIndex(-1);
   ui->domainsComboBox->blockSignals(false);
@@ -1695,6 +1836,7 @@ bool MainWindow::wipeFile(const QString &filename)
 
 void MainWindow::cleanupAfterMasterPasswordChanged(void)
 {
+  Crypter::clearKeyCache();
   static const QStringList BackupFilenameFilters = { QString("*-%1-backup.txt").arg(AppName) };
   const QString &backupFilePath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
   const QStringList backupFileNames = QDir(backupFilePath).entryList(BackupFilenameFilters, QDir::Files | QDir::CaseSensitive, QDir::NoSort);
@@ -1750,7 +1892,9 @@ void MainWindow::removeOutdatedBackupFiles(void)
   const QString &backupFilePath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
   const QStringList backupFileNames = QDir(backupFilePath).entryList(BackupFilenameFilters, QDir::Files | QDir::CaseSensitive, QDir::NoSort);
   if (!backupFileNames.isEmpty()) {
-    d->backupFileDeletionFuture = QtConcurrent::run(this, &MainWindow::removeOutdatedBackupFilesThread);
+    d->backupFileDeletionFuture = CryptoExecutor::instance().run(CryptoExecutor::Background, "backupFiles", [this]() {
+      removeOutdatedBackupFilesThread();
+    });
   }
   else {
     ui->statusBar->showMessage(tr("There are no backup files present in %1.")
@@ -1945,6 +2089,11 @@ void MainWindow::saveUiSettings(void)
   d->settings.setValue("misc/maxPasswordLength", d->optionsDialog->maxPasswordLength());
   d->settings.setValue("misc/defaultPasswordLength", d->optionsDialog->defaultPasswordLength());
   d->settings.setValue("misc/defaultPBKDF2Iterations", d->optionsDialog->defaultIterations());
+  d->settings.setValue("misc/targetDerivationMSecs", d->optionsDialog->targetDerivationMSecs());
+  if (d->optionsDialog->calibratedIterationsPerSecond() > 0) {
+    d->settings.setValue("misc/calibration/key", IterationCalibrator::cacheKey());
+    d->settings.setValue("misc/calibration/iterationsPerSecond", d->optionsDialog->calibratedIterationsPerSecond());
+  }
   d->settings.setValue("misc/saltLength", d->optionsDialog->saltLength());
   d->settings.setValue("misc/writeBackups", d->optionsDialog->writeBackups());
   d->settings.setValue("misc/autoDeleteBackupFiles", d->optionsDialog->autoDeleteBackupFiles());
@@ -1973,6 +2122,10 @@ void MainWindow::restoreUiSettings(void)
   d->optionsDialog->setMaxPasswordLength(d->settings.value("misc/maxPasswordLength", Password::DefaultMaxLength).toInt());
   d->optionsDialog->setDefaultPasswordLength(d->settings.value("misc/defaultPasswordLength", DomainSettings::DefaultPasswordLength).toInt());
   d->optionsDialog->setDefaultIterations(d->settings.value("misc/defaultPBKDF2Iterations", DomainSettings::DefaultIterations).toInt());
+  d->optionsDialog->setTargetDerivationMSecs(d->settings.value("misc/targetDerivationMSecs", IterationCalibrator::DefaultTargetMSecs).toInt());
+  if (d->settings.value("misc/calibration/key").toString() == IterationCalibrator::cacheKey()) {
+    d->optionsDialog->setCalibratedIterationsPerSecond(d->settings.value("misc/calibration/iterationsPerSecond", 0).toReal());
+  }
   d->optionsDialog->setMaxBackupFileAge(d->settings.value("misc/maxBackupFileAge", 30).toInt());
   d->optionsDialog->setMaxAttachmentSizeKbyte(d->settings.value("misc/maxAttachmentSizeKbyte", 50).toInt());
   d->optionsDialog->setAutoDeleteBackupFiles(d->settings.value("misc/autoDeleteBackupFiles", true).toBool());
@@ -2045,19 +2198,186 @@ void MainWindow::hackLegacyPassword(void)
     d->hackingMode = true;
     d->hackSalt.fill(0);
     d->hackPos = PositionTable(pwd);
-    d->hackPermutations = d->hackPos.permutations();
-    d->hackIterationDurationMs = 0;
     const QStringList &chrs = pwd.split("", QString::SkipEmptyParts).toSet().toList(); // keep this for backwards compatibility (Qt < 5.5)
     ui->usedCharactersPlainTextEdit->setPlainText(chrs.join(""));
     ui->legacyPasswordLineEdit->setReadOnly(true);
     ui->usedCharactersPlainTextEdit->setReadOnly(true);
     ui->renewSaltPushButton->setEnabled(false);
     ui->passwordLengthSpinBox->setValue(pwd.size());
-    d->hackClock.restart();
-    d->hackIterationClock.restart();
     unblockUpdatePassword();
-    ui->saltBase64LineEdit->setText(d->hackSalt.toBase64());
+    const DomainSettings &ds = collectedDomainSettings();
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(d->KGK);
+    hash.addData(QJsonDocument::fromVariant(QVariantList()
+                                            << ds.domainName << ds.userName << ds.iterations
+                                            << ds.passwordTemplate << ds.extraCharacters
+                                            << ds.legacyPassword).toJson(QJsonDocument::Compact));
+    d->hackStateBaseName = QString("%1/hack-%2")
+        .arg(QStandardPaths::writableLocation(QStandardPaths::DataLocation))
+        .arg(QString::fromLatin1(hash.result().toHex().left(16)));
+    if (checkHackFoundByOtherProcess())
+      return;
+    if (!claimHackShard()) {
+      d->hackingMode = false;
+      ui->renewSaltPushButton->setEnabled(true);
+      ui->legacyPasswordLineEdit->setReadOnly(false);
+      restartInvalidationTimer();
+      QMessageBox::information(this, tr("Cannot hack"), tr("All shards of the salt range are being searched by other instances or have been searched already."));
+    }
+  }
+}
+
+
+/*!
+ * \brief MainWindow::claimHackShard
+ *
+ * Locks the first shard of the salt range no other process works on and
+ * that has not been searched completely, and starts or resumes searching it.
+ *
+ * \return `false` if there's no such shard.
+ */
+bool MainWindow::claimHackShard(void)
+{
+  Q_D(MainWindow);
+  for (int shard = 0; shard < HackShardCount; ++shard) {
+    QLockFile *lock = new QLockFile(QString("%1-%2.lck").arg(d->hackStateBaseName).arg(shard));
+    if (!lock->tryLock(0)) {
+      delete lock;
+      continue;
+    }
+    SaltSearch::Checkpoint cp;
+    QByteArray json;
+    if (readHackStateFile(hackStateFileName(shard), json)) {
+      cp = SaltSearch::Checkpoint::fromJson(json);
+    }
+    if (!cp.isValid() || cp.shard != shard || cp.shardCount != HackShardCount) {
+      cp = SaltSearch::Checkpoint();
+      cp.startSalt = d->hackSalt;
+      cp.shard = shard;
+      cp.shardCount = HackShardCount;
+      cp.nextIndex = cp.shardBegin();
+    }
+    if (cp.isExhausted()) {
+      delete lock;
+      continue;
+    }
+    d->hackShardLock = lock;
+    d->hackCheckpointClock.start();
+    d->saltSearch.resume(d->KGK, collectedDomainSettings(), d->hackPos, cp);
+    return true;
+  }
+  return false;
+}
+
+
+void MainWindow::releaseHackShard(void)
+{
+  Q_D(MainWindow);
+  SafeDelete(d->hackShardLock);
+}
+
+
+QString MainWindow::hackStateFileName(int shard) const
+{
+  return QString("%1-%2of%3.state").arg(d_ptr->hackStateBaseName).arg(shard).arg(HackShardCount);
+}
+
+
+/*!
+ * \brief MainWindow::saveHackCheckpoint
+ *
+ * Writes the current position of the salt search to the state file of its shard.
+ */
+void MainWindow::saveHackCheckpoint(void)
+{
+  Q_D(MainWindow);
+  if (d->hackShardLock == Q_NULLPTR)
+    return;
+  const SaltSearch::Checkpoint &cp = d->saltSearch.checkpoint();
+  writeHackStateFile(hackStateFileName(cp.shard), cp.toJson());
+}
+
+
+bool MainWindow::writeHackStateFile(const QString &filename, const QByteArray &data)
+{
+  Q_D(MainWindow);
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  QBuffer in;
+  in.setData(data);
+  in.open(QIODevice::ReadOnly);
+  return Crypter::encode(d->masterKey, d->IV, d->salt, d->kgk(), &in, &file, CompressionEnabled) && file.commit();
+}
+
+
+bool MainWindow::readHackStateFile(const QString &filename, QByteArray &data)
+{
+  Q_D(MainWindow);
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  const QByteArray &cipher = file.readAll();
+  file.close();
+  if (cipher.isEmpty())
+    return false;
+  SecureByteArray KGK;
+  data = Crypter::decode(d->masterPassword.toUtf8(), cipher, CompressionEnabled, KGK);
+  return !data.isEmpty() && KGK == d->KGK;
+}
+
+
+/*!
+ * \brief MainWindow::removeHackStateFiles
+ *
+ * Deletes the state, lock and found files of the current salt search,
+ * unless another instance is still searching one of its shards.
+ */
+void MainWindow::removeHackStateFiles(void)
+{
+  Q_D(MainWindow);
+  QList<QLockFile*> locks;
+  bool allLocked = true;
+  for (int shard = 0; shard < HackShardCount && allLocked; ++shard) {
+    QLockFile *lock = new QLockFile(QString("%1-%2.lck").arg(d->hackStateBaseName).arg(shard));
+    allLocked = lock->tryLock(0);
+    locks.append(lock);
   }
+  if (allLocked) {
+    for (int shard = 0; shard < HackShardCount; ++shard) {
+      QFile::remove(hackStateFileName(shard));
+    }
+    QFile::remove(d->hackStateBaseName + ".found");
+  }
+  qDeleteAll(locks); // unlocking removes the lock files
+}
+
+
+/*!
+ * \brief MainWindow::checkHackFoundByOtherProcess
+ *
+ * If another instance has found a matching salt, stops the search and presents that salt.
+ *
+ * \return `true` if a salt has been found.
+ */
+bool MainWindow::checkHackFoundByOtherProcess(void)
+{
+  Q_D(MainWindow);
+  const QString &foundFileName = d->hackStateBaseName + ".found";
+  if (!QFile::exists(foundFileName))
+    return false;
+  QByteArray json;
+  if (!readHackStateFile(foundFileName, json))
+    return false;
+  const QByteArray &salt = QByteArray::fromBase64(QJsonDocument::fromJson(json).toVariant().toMap()["salt"].toByteArray());
+  if (salt.isEmpty())
+    return false;
+  d->saltSearch.cancel();
+  DerivationRequest request(d->KGK, collectedDomainSettings());
+  request.salt = salt;
+  onSaltSearchFound(salt, Derivation::derive(request).password);
+  return true;
 }
 #endif
 
@@ -2146,9 +2466,7 @@ void MainWindow::syncWithFile(void)
                          tr("The sync file %1 cannot be opened for reading. Reason: %2")
                          .arg(d->optionsDialog->syncFilename()).arg(syncFile.errorString()), QMessageBox::Ok);
   }
-  QByteArray domains = syncFile.readAll();
-  syncFile.close();
-  syncWith(SyncPeerFile, domains);
+  syncWith(SyncPeerFile, &syncFile);
 }
 
 
@@ -2170,6 +2488,10 @@ void MainWindow::beginSyncWithServer(void)
 void MainWindow::onSync(void)
 {
   Q_D(MainWindow);
+  if (d->auditWatcher.isRunning()) {
+    ui->statusBar->showMessage(tr("Cannot sync while the vault audit is running."), 3000);
+    return;
+  }
   restartInvalidationTimer();
   d->domainSettingsBeforceSync = d->domains.at(ui->domainsComboBox->currentText());
   if (d->optionsDialog->useSyncFile() && !d->optionsDialog->syncFilename().isEmpty()) {
@@ -2237,18 +2559,34 @@ void MainWindow::warnAboutDifferingKGKs(void)
 }
 
 
-void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEncoded)
+/*!
+ * \brief MainWindow::syncWith
+ *
+ * Decrypts the domain settings read from `remoteDomainsEncoded` and merges
+ * them with the local ones. The device must be seekable and is closed
+ * before anything is written back to the sync peer.
+ */
+void MainWindow::syncWith(SyncPeer syncPeer, QIODevice *remoteDomainsEncoded)
 {
   Q_D(MainWindow);
   // qDebug() << "MainWindow::syncWith(" << syncPeer << ")";
   QJsonDocument remoteJSON;
   d->doConvertLocalToLegacy = false;
-  if (!remoteDomainsEncoded.isEmpty()) {
+  auto decode = [remoteDomainsEncoded](const SecureByteArray &masterPassword, SecureByteArray &KGK) {
+    QByteArray plain;
+    QBuffer out(&plain);
+    out.open(QIODevice::WriteOnly);
+    remoteDomainsEncoded->seek(0);
+    if (!Crypter::decode(masterPassword, remoteDomainsEncoded, &out, CompressionEnabled, KGK))
+      plain.clear();
+    return plain;
+  };
+  if (remoteDomainsEncoded->isOpen() && remoteDomainsEncoded->size() > 0) {
     QByteArray baDomains;
     bool ok = true;
     try {
       SecureByteArray KGK;
-      baDomains = Crypter::decode(d->masterPassword.toUtf8(), remoteDomainsEncoded, CompressionEnabled, KGK);
+      baDomains = decode(d->masterPassword.toUtf8(), KGK);
       if (d->KGK != KGK) {
         d->doConvertLocalToLegacy = !d->domains.isEmpty();
         d->KGK = KGK;
@@ -2264,7 +2602,7 @@ void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEnco
     if (!ok) { // fall back to new password
       try {
         SecureByteArray KGK;
-        baDomains = Crypter::decode(d->changeMasterPasswordDialog->newPassword().toUtf8(), remoteDomainsEncoded, CompressionEnabled, KGK);
+        baDomains = decode(d->changeMasterPasswordDialog->newPassword().toUtf8(), KGK);
         if (d->KGK != KGK && !d->domains.isEmpty()) {
           d->doConvertLocalToLegacy = true;
           d->KGK = KGK;
@@ -2275,6 +2613,7 @@ void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEnco
         return;
       }
     }
+    remoteDomainsEncoded->close();
     if (!baDomains.isEmpty()) {
       QJsonParseError parseError;
       remoteJSON = QJsonDocument::fromJson(baDomains, &parseError);
@@ -2286,6 +2625,7 @@ void MainWindow::syncWith(SyncPeer syncPeer, const QByteArray &remoteDomainsEnco
     }
   }
 
+  remoteDomainsEncoded->close();
   d->domains.setDirty(false);
   d->remoteDomains = DomainSettingsList::fromQJsonDocument(remoteJSON);
   mergeLocalAndRemoteData();
@@ -2339,14 +2679,12 @@ void MainWindow::convertToLegacyPassword(DomainSettings &ds)
 {
   Q_D(MainWindow);
   if (ds.legacyPassword.isEmpty()) {
-    Password pwd(ds);
     Q_ASSERT_X(!d->masterPassword.isEmpty(), "MainWindow::convertToLegacyPassword()", "d->masterPassword must not be empty");
     if (d->masterPassword.isEmpty()) {
       qWarning() << "Error in MainWindow::convertToLegacyPassword(): d->masterPassword must not be empty";
       return;
     }
-    pwd.generate(d->masterPassword.toUtf8());
-    ds.legacyPassword = pwd.password();
+    ds.legacyPassword = Derivation::derive(DerivationRequest(d->masterPassword.toUtf8(), ds)).password;
   }
 }
 
@@ -2393,34 +2731,54 @@ void MainWindow::writeToRemote(SyncPeer syncPeer)
 {
   Q_D(MainWindow);
   qDebug() << "MainWindow::writeToRemote(" << syncPeer << ")";
-  const QByteArray &cipher = cryptedRemoteDomains();
-  if (!cipher.isEmpty()) {
-    if ((syncPeer & SyncPeerFile) == SyncPeerFile && d->optionsDialog->syncToFileEnabled()) {
-      writeToSyncFile(cipher);
-    }
-    if ((syncPeer & SyncPeerServer) == SyncPeerServer && d->optionsDialog->syncToServerEnabled()) {
+  if ((syncPeer & SyncPeerFile) == SyncPeerFile && d->optionsDialog->syncToFileEnabled()) {
+    writeToSyncFile();
+  }
+  if ((syncPeer & SyncPeerServer) == SyncPeerServer && d->optionsDialog->syncToServerEnabled()) {
+    const QByteArray &cipher = cryptedRemoteDomains();
+    if (!cipher.isEmpty()) {
       sendToSyncServer(cipher);
     }
-  }
-  else {
-    // TODO: catch encryption error
+    else {
+      // TODO: catch encryption error
+    }
   }
 }
 
 
-void MainWindow::writeToSyncFile(const QByteArray &cipher)
+/*!
+ * \brief MainWindow::writeToSyncFile
+ *
+ * Encrypts the remote domain settings straight into the sync file.
+ * The file is replaced atomically once the encryption has succeeded.
+ */
+void MainWindow::writeToSyncFile(void)
 {
   Q_D(MainWindow);
-  if (d->optionsDialog->syncToFileEnabled()) {
-    QFile syncFile(d->optionsDialog->syncFilename());
-    syncFile.open(QIODevice::WriteOnly);
-    const qint64 bytesWritten = syncFile.write(cipher);
-    syncFile.close();
-    if (bytesWritten < 0) {
-      QMessageBox::warning(this, tr("Sync file write error"), tr("Writing to your sync file %1 failed: %2")
-                           .arg(d->optionsDialog->syncFilename())
-                           .arg(syncFile.errorString()), QMessageBox::Ok);
-    }
+  if (!d->optionsDialog->syncToFileEnabled())
+    return;
+  d->keyGenerationFuture.waitForFinished();
+  if (!validCredentials()) {
+    _LOG(QString("ERROR in MainWindow::writeToSyncFile(): invalid credentials"));
+    return;
+  }
+  QBuffer in;
+  in.setData(d->remoteDomains.toJson());
+  in.open(QIODevice::ReadOnly);
+  QSaveFile syncFile(d->optionsDialog->syncFilename());
+  bool ok = syncFile.open(QIODevice::WriteOnly);
+  try {
+    ok = ok && Crypter::encode(d->masterKey, d->IV, d->salt, d->kgk(), &in, &syncFile, CompressionEnabled) && syncFile.commit();
+  }
+  catch (CryptoPP::Exception &e) {
+    syncFile.cancelWriting();
+    wrongPasswordWarning((int)e.GetErrorType(), e.what());
+    return;
+  }
+  if (!ok) {
+    QMessageBox::warning(this, tr("Sync file write error"), tr("Writing to your sync file %1 failed: %2")
+                         .arg(d->optionsDialog->syncFilename())
+                         .arg(syncFile.errorString()), QMessageBox::Ok);
   }
 }
 
@@ -2521,6 +2879,7 @@ void MainWindow::onDomainTextChanged(const QString &domain)
   _LOG(QString("MainWindow::onDomainTextChanged(\"%1\") d->lastCleanDomainSettings.domainName = \"%2\"")
        .arg(domain)
        .arg(d->lastCleanDomainSettings.domainName));
+  speculateOnCompletions(domain);
   int idx = findDomainInComboBox(domain);
   if (idx == NotFound) {
     if (!d->lastCleanDomainSettings.isEmpty()) {
@@ -2536,6 +2895,61 @@ void MainWindow::onDomainTextChanged(const QString &domain)
 }
 
 
+void MainWindow::onDomainHighlighted(QString domain)
+{
+  Q_D(MainWindow);
+  if (d->masterPassword.isEmpty() || !domainComboboxContains(domain))
+    return;
+  DomainSettingsList candidates;
+  candidates.append(d->domains.at(domain));
+  d->speculativeDeriver.speculate(d->KGK, candidates);
+}
+
+
+/*!
+ * \brief MainWindow::speculateOnCompletions
+ *
+ * If the completer shows no more than `SpeculativeDeriver::MaxCandidates` domains
+ * for `text`, starts deriving their keys in the background, so that the password
+ * is available at once when the user selects one of them.
+ */
+void MainWindow::speculateOnCompletions(const QString &text)
+{
+  Q_D(MainWindow);
+  if (d->masterPassword.isEmpty())
+    return;
+  DomainSettingsList candidates;
+  if (!text.isEmpty()) {
+    foreach (const DomainSettings &ds, d->domains) {
+      if (!ds.deleted && ds.domainName.contains(text, Qt::CaseInsensitive)) {
+        candidates.append(ds);
+        if (candidates.size() > SpeculativeDeriver::MaxCandidates)
+          break;
+      }
+    }
+  }
+  if (candidates.isEmpty() || candidates.size() > SpeculativeDeriver::MaxCandidates) {
+    d->speculativeDeriver.cancel();
+  }
+  else {
+    d->speculativeDeriver.speculate(d->KGK, candidates);
+  }
+}
+
+
+void MainWindow::flushDerivedKeys(void)
+{
+  Q_D(MainWindow);
+  d->passwordScheduler.cancel();
+  d->password.abortGeneration();
+  d->password.waitForFinished();
+  d->speculativeDeriver.cancel();
+  d->speculativeDeriver.waitForDone();
+  d->derivedKeyCache.clear();
+  Crypter::clearKeyCache();
+}
+
+
 void MainWindow::onEasySelectorValuesChanged(int passwordLength, int complexityValue)
 {
   Q_D(MainWindow);
@@ -2574,49 +2988,33 @@ void MainWindow::onExportAllDomainSettingAsJSON(void)
 }
 
 
-struct DomainSettingsToTextConverter
+static SecureByteArray loginDataAsText(const DomainSettings &ds, const SecureString &pwd)
 {
-  explicit DomainSettingsToTextConverter(const SecureByteArray &kgk)
-    : kgk(kgk)
-  { /* ... */ }
-  typedef SecureByteArray result_type;
-  SecureByteArray kgk;
-  SecureByteArray operator()(const DomainSettings &ds)
-  {
-    SecureByteArray data;
-    if (!ds.deleted && !ds.expired()) {
-      SecureString pwd = ds.legacyPassword;
-      if (pwd.isEmpty()) {
-        Password gpwd(ds);
-        gpwd.generate(kgk);
-        pwd = gpwd.password();
-      }
-      if (!pwd.isEmpty()) {
-        QString notes = ds.notes;
-        notes.replace("\\", "\\\\");
-        notes.replace("\n", "\\n");
-        data = SecureString("[%1]\n"
-                            "pwd = %2\n")
-            .arg(ds.domainName)
-            .arg(pwd)
-            .toUtf8();
-        if (!ds.url.isEmpty()) {
-          data.append(QString("url = %1\n").arg(ds.url).toUtf8());
-        }
-        if (!ds.userName.isEmpty()) {
-          data.append(QString("user = %1\n").arg(ds.userName).toUtf8());
-        }
-        if (!notes.isEmpty()) {
-          data.append(SecureString("notes = %1\n").arg(notes).toUtf8());
-        }
-        if (!ds.groupHierarchy.isEmpty()) {
-          data.append(QString("group = %1\n").arg(ds.groupHierarchy).toUtf8());
-        }
-      }
+  SecureByteArray data;
+  if (!pwd.isEmpty()) {
+    QString notes = ds.notes;
+    notes.replace("\\", "\\\\");
+    notes.replace("\n", "\\n");
+    data = SecureString("[%1]\n"
+                        "pwd = %2\n")
+        .arg(ds.domainName)
+        .arg(pwd)
+        .toUtf8();
+    if (!ds.url.isEmpty()) {
+      data.append(QString("url = %1\n").arg(ds.url).toUtf8());
+    }
+    if (!ds.userName.isEmpty()) {
+      data.append(QString("user = %1\n").arg(ds.userName).toUtf8());
+    }
+    if (!notes.isEmpty()) {
+      data.append(SecureString("notes = %1\n").arg(notes).toUtf8());
+    }
+    if (!ds.groupHierarchy.isEmpty()) {
+      data.append(QString("group = %1\n").arg(ds.groupHierarchy).toUtf8());
     }
-    return data;
   }
-};
+  return data;
+}
 
 
 static const QString LoginDataFileExtension = QObject::tr("Login data file (*.txt *.sesam)");
@@ -2630,42 +3028,180 @@ void MainWindow::onExportAllLoginDataAsClearText(void)
                                    QString(),
                                    LoginDataFileExtension);
   if (!filename.isEmpty()) {
+    QVector<SecureString> passwords(d->domains.count());
+    QVector<QString> errorStrings(d->domains.count());
+    DomainSettingsList generated;
+    QVector<int> generatedIdx;
+    for (int i = 0; i < d->domains.count(); ++i) {
+      const DomainSettings &ds = d->domains.at(i);
+      if (ds.deleted || ds.expired())
+        continue;
+      if (ds.legacyPassword.isEmpty()) {
+        generated.append(ds);
+        generatedIdx.append(i);
+      }
+      else {
+        passwords[i] = ds.legacyPassword;
+      }
+    }
     QProgressDialog progressDialog(this);
     progressDialog.setLabelText(tr("Exporting logins\nin %1 thread%2 ...")
                                 .arg(QThread::idealThreadCount())
                                 .arg(QThread::idealThreadCount() == 1 ? "" : tr("s")));
+    progressDialog.setRange(0, generated.count());
     progressDialog.show();
-    QFutureWatcher<SecureByteArray> futureWatcher;
+    CancellationToken token;
+    QAtomicInt nDerived(0);
+    QFutureWatcher<void> futureWatcher;
     QObject::connect(&futureWatcher, SIGNAL(finished()), &progressDialog, SLOT(reset()));
-    QObject::connect(&progressDialog, SIGNAL(canceled()), &futureWatcher, SLOT(cancel()));
-    QObject::connect(&futureWatcher, SIGNAL(progressRangeChanged(int, int)), &progressDialog, SLOT(setRange(int, int)));
-    QObject::connect(&futureWatcher, SIGNAL(progressValueChanged(int)), &progressDialog, SLOT(setValue(int)));
-    QFuture<SecureByteArray> future = QtConcurrent::mappedReduced<SecureByteArray>(
-          d->domains,
-          DomainSettingsToTextConverter(d->KGK),
-          [](SecureByteArray &all, const SecureByteArray &intermediate)
-          {
-            if (!intermediate.isEmpty()) {
-              all.append(intermediate).append("\n");
-            }
-          },
-          QtConcurrent::OrderedReduce);
-    futureWatcher.setFuture(future);
+    QObject::connect(&progressDialog, &QProgressDialog::canceled, [&token]() {
+      token.cancel();
+    });
+    futureWatcher.setFuture(CryptoExecutor::instance().run(CryptoExecutor::Normal, "export", [&]() {
+      PasswordBatch::derive(generated, d->KGK, [&](const PasswordBatch::Result &result) {
+        if (result.error != Password::NoError) {
+          errorStrings[generatedIdx.at(result.index)] = result.errorString.isEmpty() ? tr("error %1").arg(result.error) : result.errorString;
+        }
+        else {
+          passwords[generatedIdx.at(result.index)] = result.password;
+        }
+        QMetaObject::invokeMethod(&progressDialog, "setValue", Qt::QueuedConnection, Q_ARG(int, nDerived.fetchAndAddRelaxed(1) + 1));
+      }, &token);
+    }));
     progressDialog.exec();
     futureWatcher.waitForFinished();
-    if (!futureWatcher.future().isCanceled()) {
+    if (!token.isCancelled()) {
+      SecureByteArray all;
+      int nExported = 0;
+      QStringList failed;
+      for (int i = 0; i < d->domains.count(); ++i) {
+        if (!errorStrings.at(i).isEmpty()) {
+          failed << QString("%1: %2").arg(d->domains.at(i).domainName).arg(errorStrings.at(i));
+          continue;
+        }
+        const SecureByteArray &data = loginDataAsText(d->domains.at(i), passwords.at(i));
+        if (!data.isEmpty()) {
+          all.append(data).append("\n");
+          ++nExported;
+        }
+      }
       QFile outFile(filename);
       bool ok = outFile.open(QIODevice::Truncate | QIODevice::WriteOnly);
       if (ok) {
-        outFile.write(future.result());
+        ok = outFile.write(all) == all.size();
         outFile.close();
       }
-      QMessageBox::information(this, tr("All login data exported"), tr("Successfully exported %1 logins.").arg(d->domains.count()));
+      if (!ok) {
+        QMessageBox::warning(this, tr("Export failed"), tr("Writing to %1 failed: %2").arg(filename).arg(outFile.errorString()));
+      }
+      else if (failed.isEmpty()) {
+        QMessageBox::information(this, tr("All login data exported"), tr("Successfully exported %1 logins.").arg(nExported));
+      }
+      else {
+        QMessageBox msgBox(this);
+        msgBox.setWindowTitle(tr("Login data partially exported"));
+        msgBox.setIcon(QMessageBox::Warning);
+        msgBox.setText(tr("Exported %1 logins. The passwords of %2 domains could not be generated and have not been exported.")
+                       .arg(nExported).arg(failed.count()));
+        msgBox.setDetailedText(failed.join("\n"));
+        msgBox.exec();
+      }
     }
   }
 }
 
 
+void MainWindow::onAuditVault(void)
+{
+  Q_D(MainWindow);
+  if (d->auditWatcher.isRunning())
+    return;
+  if (d->progressDialog->isVisible()) {
+    ui->statusBar->showMessage(tr("Cannot audit the vault while another operation is in progress."), 3000);
+    return;
+  }
+  ui->actionAuditVault->setEnabled(false);
+  d->auditPasswordChecker.reset(new PasswordChecker(d->optionsDialog->passwordFilename()));
+  PasswordChecker *passwordChecker = d->auditPasswordChecker.data();
+  VaultAudit::Options options;
+  options.breachCheck = [passwordChecker](const SecureString &password, quint32 *breachCount) {
+    return passwordChecker->findInPasswordFile(password, breachCount) >= 0;
+  };
+  const DomainSettingsList domains = d->domains;
+  const SecureByteArray KGK = d->KGK;
+  d->progressDialog->show();
+  d->progressDialog->raise();
+  d->progressDialog->setText(tr("Auditing %1 domains in %2 thread%3 ...")
+                             .arg(domains.count())
+                             .arg(QThread::idealThreadCount())
+                             .arg(QThread::idealThreadCount() == 1 ? "" : tr("s")));
+  d->progressDialog->setRange(0, 1);
+  d->progressDialog->setValue(0);
+  QObject::disconnect(d->progressDialog, SIGNAL(cancelled()), this, SLOT(cancelServerOperation()));
+  d->auditToken.reset();
+  d->auditCancelConnection = QObject::connect(d->progressDialog, &ProgressDialog::cancelled, [d]() {
+    d->auditToken.cancel();
+  });
+  d->auditFindings.clear();
+  d->auditWatcher.setFuture(CryptoExecutor::instance().run(CryptoExecutor::Normal, "vaultaudit", [d, domains, KGK, options]() {
+    d->auditFindings = VaultAudit::run(domains, KGK, options, [d](int done, int total) {
+      QMetaObject::invokeMethod(d->progressDialog, "setRange", Qt::QueuedConnection, Q_ARG(int, 0), Q_ARG(int, total));
+      QMetaObject::invokeMethod(d->progressDialog, "setValue", Qt::QueuedConnection, Q_ARG(int, done));
+    }, &d->auditToken);
+  }));
+}
+
+
+void MainWindow::onVaultAuditFinished(void)
+{
+  Q_D(MainWindow);
+  QObject::disconnect(d->auditCancelConnection);
+  QObject::connect(d->progressDialog, SIGNAL(cancelled()), SLOT(cancelServerOperation()));
+  d->progressDialog->hide();
+  ui->actionAuditVault->setEnabled(true);
+  d->auditPasswordChecker.reset();
+  QVector<VaultAudit::Finding> findings;
+  findings.swap(d->auditFindings);
+  if (d->auditToken.isCancelled()) {
+    ui->statusBar->showMessage(tr("Vault audit cancelled."), 3000);
+    return;
+  }
+  VaultAudit::sort(findings, VaultAudit::ByDomainName);
+  VaultAudit::sort(findings, VaultAudit::BySeverity, Qt::DescendingOrder);
+  QStringList report;
+  foreach (const VaultAudit::Finding &f, findings) {
+    if (f.issues == VaultAudit::NoIssue)
+      continue;
+    QStringList issues;
+    if (f.issues & VaultAudit::Breached)
+      issues << (f.breachCount > 0 ? tr("breached (%1 times)").arg(f.breachCount) : tr("breached"));
+    if (f.issues & VaultAudit::Reused)
+      issues << tr("used for %1 domains").arg(f.reuseCount);
+    if (f.issues & VaultAudit::WeakPassword)
+      issues << tr("weak");
+    if (f.issues & VaultAudit::InvalidTemplate)
+      issues << tr("invalid template");
+    if (f.issues & VaultAudit::LowIterations)
+      issues << tr("only %1 iterations").arg(f.iterations);
+    if (f.issues & VaultAudit::Expired)
+      issues << tr("expired");
+    report << QString("%1 (%2): %3").arg(f.domainName).arg(f.userName).arg(issues.join(", "));
+  }
+  QMessageBox msgBox(this);
+  msgBox.setWindowTitle(tr("Vault audit"));
+  if (report.isEmpty()) {
+    msgBox.setIcon(QMessageBox::Information);
+    msgBox.setText(tr("No issues found in %1 domains.").arg(findings.count()));
+  }
+  else {
+    msgBox.setIcon(QMessageBox::Warning);
+    msgBox.setText(tr("%1 of %2 domains have issues.").arg(report.count()).arg(findings.count()));
+    msgBox.setDetailedText(report.join("\n"));
+  }
+  msgBox.exec();
+}
+
+
 QImage MainWindow::currentDomainSettings2QRCode(void) const
 {
   static const int ModuleSize = 10;
@@ -2850,6 +3386,7 @@ void MainWindow::onMasterPasswordEntered(void)
   const bool repeatedPasswordEntry = d->masterPasswordDialog->repeatedPasswordEntry();
   if (!masterPwd.isEmpty()) {
     d->masterPassword = masterPwd;
+    d->saltKeyIVPool.setMasterPassword(d->masterPassword.toUtf8());
     ok = restoreSettings();
     if (ok) {
       createLanguageMenu();
@@ -2952,7 +3489,15 @@ void MainWindow::invalidateMasterPassword(bool reenter)
 {
   Q_D(MainWindow);
   qDebug() << "MainWindow::invalidatePassword()";
+#if HACKING_MODE_ENABLED
+  if (d->hackingMode) {
+    cancelPasswordGeneration();
+  }
+#endif
   SecureErase(d->masterPassword);
+  d->auditToken.cancel();
+  d->saltKeyIVPool.clear();
+  flushDerivedKeys();
   d->masterPasswordDialog->invalidatePassword();
   d->KGK.invalidate();
   d->masterKey.invalidate();
@@ -2967,6 +3512,7 @@ void MainWindow::lockApplication(void)
   Q_D(MainWindow);
   // qDebug() << "MainWindow::lockApplication() triggered by" << (sender() == Q_NULLPTR ? sender()->objectName() : "NONE");
   _LOG("MainWindow::lockApplication()");
+  flushDerivedKeys();
   if (d->interactionSemaphore.available() == 0) {
     restartInvalidationTimer();
     return;
@@ -3043,8 +3589,10 @@ void MainWindow::onReadFinished(QNetworkReply *reply)
     if (parseError.error == QJsonParseError::NoError) {
       QVariantMap map = json.toVariant().toMap();
       if (map["status"].toString() == "ok") {
-        QByteArray baDomains = QByteArray::fromBase64(map["result"].toByteArray());
-        syncWith(SyncPeerServer, baDomains);
+        QBuffer baDomains;
+        baDomains.setData(QByteArray::fromBase64(map["result"].toByteArray()));
+        baDomains.open(QIODevice::ReadOnly);
+        syncWith(SyncPeerServer, &baDomains);
       }
       else {
         d->progressDialog->setText(tr("Reading from the sync server failed. Status: %1 - Error: %2").arg(map["status"].toString()).arg(map["error"].toString()));
@@ -3066,6 +3614,16 @@ void MainWindow::onReadFinished(QNetworkReply *reply)
 
 void MainWindow::about(void)
 {
+  QStringList hashBackendReport;
+  if (HashBackendRegistry::instance().isBenchmarked()) {
+    foreach (QString line, HashBackendRegistry::instance().report()) {
+      hashBackendReport << line.toHtmlEscaped();
+    }
+  }
+  else {
+    hashBackendReport << tr("Hash backend benchmark is still running ...");
+  }
+  const QString &hashBackendInfo = hashBackendReport.join("<br/>");
   QMessageBox::about(
         this, tr("About %1 %2").arg(AppName).arg(AppVersion),
         tr("<p><b>%1 %5</b> is a domain specific password generator. "
@@ -3087,8 +3645,10 @@ void MainWindow::about(void)
            " Crypto++ is licensed under the Boost Software License, Version 1.0. "
            " libqrencode is licensed under the GNU Lesser General Public License 2.1 or later."
            "</p>"
+           "<p><small>%6</small></p>"
            )
-        .arg(AppName).arg(AppURL).arg(AppAuthor).arg(AppAuthorMail).arg(AppVersion));
+        .arg(AppName).arg(AppURL).arg(AppAuthor).arg(AppAuthorMail).arg(AppVersion)
+        .arg(hashBackendInfo));
 }
 
 
@@ -30,6 +30,7 @@
 #include <QSettings>
 #include <QCompleter>
 #include <QFuture>
+#include <QIODevice>
 #include <QMutex>
 #include <QTimer>
 #include <QJsonDocument>
@@ -52,6 +53,7 @@
 #include "domainsettingslist.h"
 #include "pbkdf2.h"
 #include "securebytearray.h"
+#include "saltkeyivpool.h"
 
 namespace Ui {
 class MainWindow;
@@ -101,14 +103,18 @@ private slots:
   void onPasswordGenerated(void);
   void onPasswordGenerationAborted(void);
   void onPasswordGenerationStarted(void);
+  void onPasswordGenerationProgress(int iterationsDone, int iterations, qreal iterationsPerSecond, qreal secondsRemaining);
   void saveCurrentDomainSettings(void);
   void onNotesChanged(void);
   void onLegacyPasswordChanged(QString);
   void onDomainTextChanged(const QString &);
   void onDomainSelected(QString);
+  void onDomainHighlighted(QString);
   void onEasySelectorValuesChanged(int passwordLength, int complexityValue);
   void onExportAllDomainSettingAsJSON(void);
   void onExportAllLoginDataAsClearText(void);
+  void onAuditVault(void);
+  void onVaultAuditFinished(void);
   void onExportCurrentSettingsAsQRCode(void);
   void onPasswordTemplateChanged(const QString &);
   void masterPasswordInvalidationTimeMinsChanged(int);
@@ -125,7 +131,7 @@ private slots:
   void openURL(void);
   void onForcedPush(void);
   void onSync(void);
-  void syncWith(SyncPeer syncPeer, const QByteArray &baDomains);
+  void syncWith(SyncPeer syncPeer, QIODevice *remoteDomainsEncoded);
   void onExpandableCheckBoxStateChanged(void);
   void onTabChanged(int idx);
   void clearClipboard(void);
@@ -150,9 +156,13 @@ private slots:
   void removeOutdatedBackupFiles(void);
 #if HACKING_MODE_ENABLED
   void hackLegacyPassword(void);
+  void onSaltSearchProgress(qint64 candidatesTested, qreal candidatesPerSecond, qreal secondsRemaining);
+  void onSaltSearchFound(const QByteArray &salt, const QString &password);
+  void onSaltSearchFinished(void);
 #endif
   QFuture<void> &generateSaltKeyIV(void);
   void onGeneratedSaltKeyIV(void);
+  void onHashBackendsBenchmarked(void);
   void onExportKGK(void);
   void onImportKGK(void);
   void onImportKeePass2XmlFile(void);
@@ -165,6 +175,7 @@ private slots:
 signals:
   void passwordGenerated(void);
   void saltKeyIVGenerated(void);
+  void hashBackendsBenchmarked(void);
   void backupFilesDeleted(int);
   void backupFilesDeleted(bool);
 
@@ -196,15 +207,19 @@ private: // methods
   void copyDomainSettingsToGUI(const QString &domain);
   void updateWindowTitle(void);
   void makeDomainComboBox(void);
+  void speculateOnCompletions(const QString &text);
+  void flushDerivedKeys(void);
   void wrongPasswordWarning(int errCode, QString errMsg);
   void restartInvalidationTimer(void);
   void generateSaltKeyIVThread(void);
+  void useSaltKeyIV(const SaltKeyIVPool::Entry &entry);
+  void benchmarkHashBackendsThread(void);
   DomainSettings collectedDomainSettings(void) const;
   QByteArray cryptedRemoteDomains(void);
   void mergeLocalAndRemoteData(void);
   void writeToRemote(SyncPeer syncPeer);
   void sendToSyncServer(const QByteArray &cipher);
-  void writeToSyncFile(const QByteArray &cipher);
+  void writeToSyncFile(void);
   void writeBackupFile(void);
   void createEmptySyncFile(void);
   void syncWithFile(void);
@@ -220,6 +235,16 @@ private: // methods
   void warnAboutDifferingKGKs(void);
   void convertToLegacyPassword(DomainSettings &ds);
   QString selectAlternativeDomainNameFor(const QString &domainName, const QStringList &domainNameList);
+#if HACKING_MODE_ENABLED
+  bool claimHackShard(void);
+  void releaseHackShard(void);
+  QString hackStateFileName(int shard) const;
+  void saveHackCheckpoint(void);
+  bool writeHackStateFile(const QString &filename, const QByteArray &data);
+  bool readHackStateFile(const QString &filename, QByteArray &data);
+  void removeHackStateFiles(void);
+  bool checkHackFoundByOtherProcess(void);
+#endif
   void saveSyncDataToSettings(void);
   bool wipeFile(const QString &filename);
   void cleanupAfterMasterPasswordChanged(void);
@@ -21,6 +21,7 @@
 #include "masterpassworddialog.h"
 #include "ui_masterpassworddialog.h"
 #include "passwordchecker.h"
+#include "strengthestimator.h"
 #include "util.h"
 #include "global.h"
 
@@ -32,6 +33,7 @@ public:
     : repeatedPasswordEntry(false)
   { /* ... */ }
   bool repeatedPasswordEntry;
+  StrengthEstimator strengthEstimator;
 };
 
 
@@ -63,6 +65,8 @@ MasterPasswordDialog::~MasterPasswordDialog()
 
 void MasterPasswordDialog::invalidatePassword(void)
 {
+  Q_D(MasterPasswordDialog);
+  d->strengthEstimator.clear();
   SecureErase(ui->passwordLineEdit->text());
   ui->passwordLineEdit->clear();
   SecureErase(ui->repeatPasswordLineEdit->text());
@@ -142,10 +146,12 @@ void MasterPasswordDialog::okClicked(void)
 
 void MasterPasswordDialog::checkPasswords(void)
 {
+  Q_D(MasterPasswordDialog);
   if (ui->repeatPasswordLineEdit->isVisible()) {
     QString grade;
     QColor color;
-    PasswordChecker::evaluatePasswordStrength(ui->passwordLineEdit->text(), color, grade, Q_NULLPTR);
+    d->strengthEstimator.setPassword(ui->passwordLineEdit->text());
+    PasswordChecker::evaluatePasswordStrength(d->strengthEstimator, color, grade);
     ui->strengthLabel->setText(tr("%1").arg(grade));
     ui->strengthLabel->setStyleSheet(QString("background-color: rgb(%1, %2, %3); font-weight: bold").arg(color.red()).arg(color.green()).arg(color.blue()));
     ui->okPushButton->setEnabled(!ui->passwordLineEdit->text().isEmpty() && ui->repeatPasswordLineEdit->text() == ui->passwordLineEdit->text());
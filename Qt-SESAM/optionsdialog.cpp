@@ -22,6 +22,8 @@
 #include "servercertificatewidget.h"
 #include "optionsdialog.h"
 #include "ui_optionsdialog.h"
+#include "iterationcalibrator.h"
+#include "cryptoexecutor.h"
 
 #include <QDebug>
 #include <QObject>
@@ -39,6 +41,7 @@
 #include <QJsonDocument>
 #include <QMovie>
 #include <QShortcut>
+#include <QFuture>
 
 static const QString HTTPS = "https";
 
@@ -51,6 +54,7 @@ public:
     , secure(false)
     , loaderIcon(":/images/loader.gif")
     , escShortcut(Q_NULLPTR)
+    , iterationsPerSecond(0)
   {
     sslConf.setCiphers(QSslSocket::supportedCiphers());
   }
@@ -67,6 +71,8 @@ public:
   bool secure;
   QMovie loaderIcon;
   QShortcut *escShortcut;
+  qreal iterationsPerSecond;
+  QFuture<void> calibrationFuture;
 };
 
 
@@ -84,6 +90,7 @@ OptionsDialog::OptionsDialog(QWidget *parent)
   QObject::connect(ui->checkConnectivityPushButton, SIGNAL(pressed()), SLOT(checkConnectivity()));
   QObject::connect(ui->selectPasswordFilePushButton, SIGNAL(pressed()), SLOT(choosePasswordFile()));
   QObject::connect(ui->serverRootURLLineEdit, SIGNAL(textChanged(QString)), SLOT(onServerRootUrlChanged(QString)));
+  QObject::connect(ui->calibrateIterationsPushButton, SIGNAL(pressed()), SLOT(calibrateIterations()));
   QObject::connect(ui->saltLengthSpinBox, SIGNAL(valueChanged(int)), SIGNAL(saltLengthChanged(int)));
   QObject::connect(ui->maxPasswordLengthSpinBox, SIGNAL(valueChanged(int)), SIGNAL(maxPasswordLengthChanged(int)));
   QObject::connect(ui->defaultPasswordLengthSpinBox, SIGNAL(valueChanged(int)), SIGNAL(defaultPasswordLengthChanged(int)));
@@ -97,6 +104,7 @@ OptionsDialog::OptionsDialog(QWidget *parent)
 
 OptionsDialog::~OptionsDialog()
 {
+  d_ptr->calibrationFuture.waitForFinished();
   delete ui;
 }
 
@@ -430,6 +438,63 @@ void OptionsDialog::setDefaultIterations(int iter)
 }
 
 
+int OptionsDialog::targetDerivationMSecs(void) const
+{
+  return ui->targetDerivationMSecsSpinBox->value();
+}
+
+
+void OptionsDialog::setTargetDerivationMSecs(int ms)
+{
+  ui->targetDerivationMSecsSpinBox->setValue(ms);
+}
+
+
+qreal OptionsDialog::calibratedIterationsPerSecond(void) const
+{
+  return d_ptr->iterationsPerSecond;
+}
+
+
+void OptionsDialog::setCalibratedIterationsPerSecond(qreal iterationsPerSecond)
+{
+  d_ptr->iterationsPerSecond = iterationsPerSecond;
+}
+
+
+/*!
+ * \brief OptionsDialog::calibrateIterations
+ *
+ * Sets the default iterations so that a derivation takes about `targetDerivationMSecs()`.
+ * The machine is only measured if there's no measurement yet. The measurement
+ * runs as a `CryptoExecutor` task; its result is applied in `onIterationsCalibrated()`.
+ */
+void OptionsDialog::calibrateIterations(void)
+{
+  Q_D(OptionsDialog);
+  if (d->iterationsPerSecond > 0) {
+    setDefaultIterations(IterationCalibrator::iterationsFor(targetDerivationMSecs(), d->iterationsPerSecond));
+    return;
+  }
+  if (d->calibrationFuture.isRunning())
+    return;
+  ui->calibrateIterationsPushButton->setEnabled(false);
+  d->calibrationFuture = CryptoExecutor::instance().run(CryptoExecutor::Normal, "calibration", [this]() {
+    const qreal iterationsPerSecond = IterationCalibrator::measure(true);
+    QMetaObject::invokeMethod(this, "onIterationsCalibrated", Qt::QueuedConnection, Q_ARG(qreal, iterationsPerSecond));
+  });
+}
+
+
+void OptionsDialog::onIterationsCalibrated(qreal iterationsPerSecond)
+{
+  Q_D(OptionsDialog);
+  d->iterationsPerSecond = iterationsPerSecond;
+  ui->calibrateIterationsPushButton->setEnabled(true);
+  setDefaultIterations(IterationCalibrator::iterationsFor(targetDerivationMSecs(), d->iterationsPerSecond));
+}
+
+
 bool OptionsDialog::syncToFileEnabled(void) const
 {
   return useSyncFile() && !syncFilename().isEmpty();
@@ -120,6 +120,12 @@ public:
   int defaultIterations(void) const;
   void setDefaultIterations(int);
 
+  int targetDerivationMSecs(void) const;
+  void setTargetDerivationMSecs(int);
+
+  qreal calibratedIterationsPerSecond(void) const;
+  void setCalibratedIterationsPerSecond(qreal);
+
   bool syncToFileEnabled(void) const;
   bool syncToServerEnabled(void) const;
 
@@ -146,6 +152,8 @@ private slots:
   void onReadFinished(QNetworkReply*);
   void sslErrorsOccured(QNetworkReply *, const QList<QSslError> &);
   void onServerRootUrlChanged(QString);
+  void calibrateIterations(void);
+  void onIterationsCalibrated(qreal iterationsPerSecond);
 
 private:
   Ui::OptionsDialog *ui;
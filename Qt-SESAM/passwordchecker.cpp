@@ -19,42 +19,228 @@
 
 
 #include "passwordchecker.h"
+#include "passworddictionary.h"
+#include "breachedhashlist.h"
+#include "cryptoexecutor.h"
+#include "cancellationtoken.h"
+#include "strengthestimator.h"
 
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDir>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFuture>
+#include <QVector>
 #include <QColor>
 
+#include <cstring>
+
+namespace {
+
+  /* Layout of the sidecar index file (native byte order, as it never
+   * leaves the machine it was built on):
+   *   IndexHeader
+   *   quint64 offsets[lineCount]  start of every non-empty line
+   *   uchar bloom[bloomBits / 8]
+   */
+  struct IndexHeader {
+    char magic[8];
+    quint32 version;
+    quint32 hashCount;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    quint64 lineCount;
+    quint64 bloomBits;
+  };
+
+  const char IndexMagic[8] = { 'S', 'E', 'S', 'A', 'M', 'P', 'W', 'X' };
+  const quint32 IndexVersion = 1;
+  const int OffsetChunkSize = 65536;
+  const quint64 CancellationCheckInterval = 65536;
+  const quint64 MaxBloomBits = Q_UINT64_C(8) << 30;
+
+  QString lineAt(const char *data, qint64 size, qint64 pos, qint64 *next)
+  {
+    const char *begin = data + pos;
+    const char *nl = reinterpret_cast<const char *>(memchr(begin, '\n', size_t(size - pos)));
+    const qint64 len = (nl != Q_NULLPTR) ? nl - begin : size - pos;
+    *next = pos + len + 1;
+    return QString::fromLatin1(begin, int(len)).trimmed();
+  }
+
+  QByteArray bloomKey(const QString &word)
+  {
+    return word.toCaseFolded().toUtf8();
+  }
+
+  void bloomHashes(const QByteArray &key, quint64 &h1, quint64 &h2)
+  {
+    // FNV-1a, then a SplitMix64 finalizer for the second hash
+    quint64 h = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < key.size(); ++i) {
+      h ^= static_cast<uchar>(key.at(i));
+      h *= Q_UINT64_C(1099511628211);
+    }
+    h1 = h;
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    h2 = h | 1;
+  }
+
+  void bloomInsert(uchar *bits, quint64 bitCount, int hashCount, const QByteArray &key)
+  {
+    quint64 h1, h2;
+    bloomHashes(key, h1, h2);
+    for (int i = 0; i < hashCount; ++i) {
+      const quint64 bit = (h1 + quint64(i) * h2) % bitCount;
+      bits[bit >> 3] |= uchar(1 << (bit & 7));
+    }
+  }
+
+  bool bloomContains(const uchar *bits, quint64 bitCount, int hashCount, const QByteArray &key)
+  {
+    quint64 h1, h2;
+    bloomHashes(key, h1, h2);
+    for (int i = 0; i < hashCount; ++i) {
+      const quint64 bit = (h1 + quint64(i) * h2) % bitCount;
+      if ((bits[bit >> 3] & (1 << (bit & 7))) == 0)
+        return false;
+    }
+    return true;
+  }
+
+}
+
+
 class PasswordCheckerPrivate
 {
 public:
   PasswordCheckerPrivate(void)
+    : data(Q_NULLPTR)
+    , size(0)
+    , sourceModified(0)
+    , offsets(Q_NULLPTR)
+    , lineCount(0)
+    , bloom(Q_NULLPTR)
+    , bloomBits(0)
+    , hashCount(0)
+    , indexed(0)
   { /* ... */ }
   ~PasswordCheckerPrivate()
   { /* ... */ }
   QFile pwdFile;
+  QMutex pwdFileMutex;
   QString pwdFilename;
+  const char *data;
+  qint64 size;
+  qint64 sourceModified;
+  QFile indexFile;
+  const quint64 *offsets;
+  quint64 lineCount;
+  const uchar *bloom;
+  quint64 bloomBits;
+  int hashCount;
+  QAtomicInt indexed;
+  PasswordDictionary dictionary;
+  BreachedHashList hashList;
+  CancellationToken cancelled;
+  QString tag;
+  QFuture<void> future;
 };
 
 
+const int PasswordChecker::BloomBitsPerEntry = 10;
+const int PasswordChecker::BloomHashCount = 7;
+
+
 PasswordChecker::PasswordChecker(const QString &passwordFilename, QObject *parent)
   : QObject(parent)
   , d_ptr(new PasswordCheckerPrivate)
 {
-  d_ptr->pwdFilename = passwordFilename;
+  Q_D(PasswordChecker);
+  d->pwdFilename = passwordFilename;
+  d->tag = QString("passwordindex:%1").arg(quintptr(this), 0, 16);
+  if (d->pwdFilename.isEmpty())
+    return;
+  if (PasswordDictionary::isDictionaryFile(d->pwdFilename) && d->dictionary.open(d->pwdFilename))
+    return;
+  if (BreachedHashList::isHashListFile(d->pwdFilename) && d->hashList.open(d->pwdFilename))
+    return;
+  d->pwdFile.setFileName(d->pwdFilename);
+  if (!d->pwdFile.open(QIODevice::ReadOnly))
+    return;
+  d->size = d->pwdFile.size();
+  d->sourceModified = QFileInfo(d->pwdFile).lastModified().toMSecsSinceEpoch();
+  if (d->size > 0) {
+    d->data = reinterpret_cast<const char *>(d->pwdFile.map(0, d->size));
+  }
+  if (d->data == Q_NULLPTR) {
+    d->pwdFile.close();
+    return;
+  }
+  d->future = CryptoExecutor::instance().run(CryptoExecutor::Background, d->tag, [this]() {
+    prepareIndex();
+  });
 }
 
 
 PasswordChecker::~PasswordChecker()
 {
-  // ...
+  Q_D(PasswordChecker);
+  CryptoExecutor::instance().cancel(d->tag);
+  d->cancelled.cancel();
+  d->future.waitForFinished();
 }
 
 
-qint64 PasswordChecker::findInPasswordFile(const QString &needle)
+/*!
+ * \brief PasswordChecker::isIndexed
+ *
+ * \return `true` if lookups are served by the sidecar index.
+ */
+bool PasswordChecker::isIndexed(void) const
+{
+  return d_ptr->indexed.loadAcquire() != 0;
+}
+
+
+/*!
+ * \brief PasswordChecker::findInPasswordFile
+ *
+ * Searches `needle` case-insensitively in the password list, or
+ * case-sensitively in a `BreachedHashList`. In the latter case the number
+ * of breaches the password has been seen in is stored in `breachCount`
+ * unless it is null; other lists leave it untouched.
+ *
+ * \return Offset of the matching line in a text password file, or the
+ * index of the matching entry in a `PasswordDictionary` or
+ * `BreachedHashList`; -1 if the password isn't listed.
+ *
+ * May be called from several threads at once: the lookups into mapped
+ * files are read-only, and the seek-based fallback is serialized.
+ */
+qint64 PasswordChecker::findInPasswordFile(const QString &needle, quint32 *breachCount)
 {
   Q_D(PasswordChecker);
+  if (d->hashList.isOpen())
+    return d->hashList.find(needle, breachCount);
+  if (d->dictionary.isOpen())
+    return d->dictionary.find(needle);
+  if (d->data != Q_NULLPTR)
+    return isIndexed() ? findInIndex(needle) : findInMappedFile(needle);
   qint64 pos = -1;
   if (!d->pwdFilename.isEmpty()) {
+    QMutexLocker locker(&d->pwdFileMutex);
     d->pwdFile.setFileName(d->pwdFilename);
     d->pwdFile.open(QIODevice::ReadOnly);
     if (d->pwdFile.isOpen()) {
@@ -66,6 +252,197 @@ qint64 PasswordChecker::findInPasswordFile(const QString &needle)
 }
 
 
+/*!
+ * \brief PasswordChecker::findInMappedFile
+ *
+ * Binary search over the bytes of the mapped password file, used until
+ * the index is ready. Line starts are found by scanning backwards in
+ * memory.
+ */
+qint64 PasswordChecker::findInMappedFile(const QString &needle) const
+{
+  const char *data = d_ptr->data;
+  qint64 lo = 0;
+  qint64 hi = d_ptr->size;
+  while (lo < hi) {
+    const qint64 mid = lo + (hi - lo) / 2;
+    qint64 start = mid;
+    while (start > lo && data[start - 1] != '\n') {
+      --start;
+    }
+    qint64 next;
+    const QString &word = lineAt(data, d_ptr->size, start, &next);
+    const int comparison = needle.compare(word, Qt::CaseInsensitive);
+    if (comparison < 0) {
+      hi = start;
+    }
+    else if (comparison > 0) {
+      lo = next;
+    }
+    else {
+      return start;
+    }
+  }
+  return -1;
+}
+
+
+/*!
+ * \brief PasswordChecker::findInIndex
+ *
+ * Tests `needle` against the Bloom filter and, if it may be listed,
+ * binary-searches the line offsets of the index.
+ */
+qint64 PasswordChecker::findInIndex(const QString &needle) const
+{
+  if (!bloomContains(d_ptr->bloom, d_ptr->bloomBits, d_ptr->hashCount, bloomKey(needle)))
+    return -1;
+  quint64 lo = 0;
+  quint64 hi = d_ptr->lineCount;
+  while (lo < hi) {
+    const quint64 mid = lo + (hi - lo) / 2;
+    const qint64 pos = qint64(d_ptr->offsets[mid]);
+    qint64 next;
+    const int comparison = needle.compare(lineAt(d_ptr->data, d_ptr->size, pos, &next), Qt::CaseInsensitive);
+    if (comparison < 0) {
+      hi = mid;
+    }
+    else if (comparison > 0) {
+      lo = mid + 1;
+    }
+    else {
+      return pos;
+    }
+  }
+  return -1;
+}
+
+
+QString PasswordChecker::indexFileName(void) const
+{
+  const QByteArray &pathHash = QCryptographicHash::hash(QFileInfo(d_ptr->pwdFilename).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+  return QString("%1/passwordindex-%2.idx")
+      .arg(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+      .arg(QString::fromLatin1(pathHash.toHex().left(16)));
+}
+
+
+/*!
+ * \brief PasswordChecker::loadIndex
+ *
+ * Maps the sidecar index if it exists and matches size and modification
+ * time of the password file.
+ */
+bool PasswordChecker::loadIndex(void)
+{
+  Q_D(PasswordChecker);
+  d->indexFile.setFileName(indexFileName());
+  if (!d->indexFile.open(QIODevice::ReadOnly))
+    return false;
+  const qint64 fileSize = d->indexFile.size();
+  const uchar *p = fileSize >= qint64(sizeof(IndexHeader)) ? d->indexFile.map(0, fileSize) : Q_NULLPTR;
+  if (p == Q_NULLPTR) {
+    d->indexFile.close();
+    return false;
+  }
+  const IndexHeader *header = reinterpret_cast<const IndexHeader *>(p);
+  const bool valid = memcmp(header->magic, IndexMagic, sizeof(IndexMagic)) == 0
+      && header->version == IndexVersion
+      && header->hashCount > 0 && header->hashCount <= 32
+      && header->sourceSize == d->size
+      && header->sourceModified == d->sourceModified
+      && header->bloomBits > 0 && header->bloomBits % 64 == 0
+      && quint64(fileSize) == sizeof(IndexHeader) + header->lineCount * sizeof(quint64) + header->bloomBits / 8;
+  if (!valid) {
+    d->indexFile.close();
+    return false;
+  }
+  d->offsets = reinterpret_cast<const quint64 *>(p + sizeof(IndexHeader));
+  d->lineCount = header->lineCount;
+  d->bloom = p + sizeof(IndexHeader) + header->lineCount * sizeof(quint64);
+  d->bloomBits = header->bloomBits;
+  d->hashCount = int(header->hashCount);
+  return true;
+}
+
+
+/*!
+ * \brief PasswordChecker::buildIndex
+ *
+ * Writes the sidecar index for the mapped password file. Takes two passes
+ * over the file: the first one counts the lines to size the Bloom filter,
+ * the second one streams the line offsets to disk.
+ */
+bool PasswordChecker::buildIndex(void)
+{
+  Q_D(PasswordChecker);
+  quint64 lineCount = 0;
+  quint64 linesScanned = 0;
+  qint64 pos = 0;
+  while (pos < d->size) {
+    if (++linesScanned % CancellationCheckInterval == 0 && d->cancelled.isCancelled())
+      return false;
+    qint64 next;
+    if (!lineAt(d->data, d->size, pos, &next).isEmpty()) {
+      ++lineCount;
+    }
+    pos = next;
+  }
+  IndexHeader header;
+  memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+  header.version = IndexVersion;
+  header.hashCount = quint32(BloomHashCount);
+  header.sourceSize = d->size;
+  header.sourceModified = d->sourceModified;
+  header.lineCount = lineCount;
+  // very long lists get a denser filter rather than one that doesn't fit into a QByteArray
+  header.bloomBits = (qBound(Q_UINT64_C(64), lineCount * quint64(BloomBitsPerEntry), MaxBloomBits) + 63) & ~Q_UINT64_C(63);
+  QByteArray bloom(int(header.bloomBits / 8), '\0');
+  uchar *bloomBits = reinterpret_cast<uchar *>(bloom.data());
+
+  const QString &filename = indexFileName();
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+  QSaveFile out(filename);
+  if (!out.open(QIODevice::WriteOnly))
+    return false;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  QVector<quint64> chunk;
+  chunk.reserve(OffsetChunkSize);
+  linesScanned = 0;
+  pos = 0;
+  while (pos < d->size) {
+    if (++linesScanned % CancellationCheckInterval == 0 && d->cancelled.isCancelled()) {
+      out.cancelWriting();
+      return false;
+    }
+    qint64 next;
+    const QString &word = lineAt(d->data, d->size, pos, &next);
+    if (!word.isEmpty()) {
+      chunk.append(quint64(pos));
+      bloomInsert(bloomBits, header.bloomBits, BloomHashCount, bloomKey(word));
+      if (chunk.size() == OffsetChunkSize) {
+        out.write(reinterpret_cast<const char *>(chunk.constData()), chunk.size() * sizeof(quint64));
+        chunk.clear();
+      }
+    }
+    pos = next;
+  }
+  out.write(reinterpret_cast<const char *>(chunk.constData()), chunk.size() * sizeof(quint64));
+  out.write(bloom);
+  return out.commit();
+}
+
+
+void PasswordChecker::prepareIndex(void)
+{
+  Q_D(PasswordChecker);
+  if (loadIndex() || (buildIndex() && loadIndex())) {
+    d->indexed.storeRelease(1);
+    emit indexReady();
+  }
+}
+
+
 qint64 PasswordChecker::findInPasswordFile(qint64 lo, qint64 hi, const QString &needle)
 {
   Q_D(PasswordChecker);
@@ -92,68 +469,66 @@ qint64 PasswordChecker::findInPasswordFile(qint64 lo, qint64 hi, const QString &
 }
 
 
-qreal PasswordChecker::entropy(const QString &str) {
-  static const int Range = 256;
-  const QByteArray &sample = str.toLatin1();
-  QVector<int> histo(Range, 0);
-  for (int i = 0; i < sample.size(); ++i) {
-    ++histo[static_cast<uchar>(sample.at(i))];
-  }
-  qreal ent = 0;
-  const qreal l = sample.size();
-  for (int i = 0; i < Range; ++i) {
-    const qreal p = qreal(histo[i]) / l;
-    if (p > 0) {
-      ent += p * M_LOG2E * qLn(1.0 / p);
-    }
-  }
-  const qreal bitsPerVariate = qLn(qreal(Range)) * M_LOG2E;
-  return ent / bitsPerVariate;
+/*!
+ * \brief PasswordChecker::evaluatePasswordStrength
+ *
+ * Grades the password `estimator` holds by its estimated number of guesses.
+ */
+void PasswordChecker::evaluatePasswordStrength(const StrengthEstimator &estimator, QColor &color, QString &grade)
+{
+  gradePasswordStrength(estimator.password().isEmpty(), estimator.guessesLog10(), color, grade);
+}
+
+
+void PasswordChecker::evaluatePasswordStrength(const QString &password, QColor &color, QString &grade, qreal *_guessesLog10)
+{
+  const qreal guessesLog10 = StrengthEstimator::guessesLog10(password);
+  gradePasswordStrength(password.isEmpty(), guessesLog10, color, grade);
+  if (_guessesLog10 != Q_NULLPTR)
+    *_guessesLog10 = guessesLog10;
 }
 
 
-void PasswordChecker::evaluatePasswordStrength(const QString &password, QColor &color, QString &grade, qreal *_fitness)
+void PasswordChecker::gradePasswordStrength(bool empty, qreal guessesLog10, QColor &color, QString &grade)
 {
-  qreal fitness = 0;
   color.setRgb(153, 153, 153);
-  if (password.isEmpty()) {
+  if (empty) {
     grade = "?";
   }
   else {
-    fitness = password.size() * entropy(password);
-    if (fitness >= 11.0) {
+    if (guessesLog10 >= 24) {
       color.setRgb(0, 255, 30);
       grade = tr("Supercalifragilisticexpialidocious");
     }
-    else if (fitness >= 9.0) {
+    else if (guessesLog10 >= 20) {
       color.setRgb(0, 255, 30);
       grade = tr("Brutally strong");
     }
-    else if (fitness >= 7.0) {
+    else if (guessesLog10 >= 17) {
       color.setRgb(0, 255, 30);
       grade = tr("Fabulous");
     }
-    else if (fitness >= 5.0) {
+    else if (guessesLog10 >= 14) {
       color.setRgb(0, 255, 30);
       grade = tr("Very good");
     }
-    else if (fitness >= 4.0) {
+    else if (guessesLog10 >= 12) {
       color.setRgb(111, 255, 0);
       grade = tr("Good");
     }
-    else if (fitness >= 3.0) {
+    else if (guessesLog10 >= 10) {
       color.setRgb(234, 255, 0);
       grade = tr("Mediocre");
     }
-    else if (fitness >= 2.5) {
+    else if (guessesLog10 >= 8) {
       color.setRgb(255, 153, 0);
       grade = tr("You can do better");
     }
-    else if (fitness >= 2.0) {
+    else if (guessesLog10 >= 6) {
       color.setRgb(255, 48, 0);
       grade = tr("Bad");
     }
-    else if (fitness >= 1.5) {
+    else if (guessesLog10 >= 3) {
       color.setRgb(255, 0, 0);
       grade = tr("It can hardly be worse");
     }
@@ -162,6 +537,4 @@ void PasswordChecker::evaluatePasswordStrength(const QString &password, QColor &
       grade = tr("Useless");
     }
   }
-  if (_fitness != Q_NULLPTR)
-    *_fitness = fitness;
 }
@@ -29,7 +29,25 @@
 #include "util.h"
 
 class PasswordCheckerPrivate;
-
+class StrengthEstimator;
+
+/*!
+ * \brief The PasswordChecker class
+ *
+ * Looks up passwords in a case-insensitively sorted list of breached
+ * passwords, one per line, in a binary `PasswordDictionary` built from
+ * such a list, or in a `BreachedHashList` of SHA-1 hashes. The binary
+ * formats are detected by their file signature and need no further
+ * preparation.
+ *
+ * A text list is memory-mapped once on construction. In the background a
+ * sidecar index is loaded from (or, on first use, built into) the cache
+ * directory. It holds the offset of every line and a Bloom filter over
+ * all case-folded entries. Once it is available, most passwords that are
+ * not listed are rejected with a handful of bit tests, and all others
+ * are found by a binary search over the line offsets; neither touches
+ * the file system.
+ */
 class PasswordChecker : public QObject
 {
   Q_OBJECT
@@ -37,12 +55,17 @@ public:
   explicit PasswordChecker(const QString &passwordFilename = QString(), QObject *parent = Q_NULLPTR);
   ~PasswordChecker();
 
-  qint64 findInPasswordFile(const QString &needle);
+  qint64 findInPasswordFile(const QString &needle, quint32 *breachCount = Q_NULLPTR);
+  bool isIndexed(void) const;
+
+  static void evaluatePasswordStrength(const StrengthEstimator &estimator, QColor &color, QString &grade);
+  static void evaluatePasswordStrength(const QString &password, QColor &color, QString &grade, qreal *_guessesLog10);
 
-  static qreal entropy(const QString &);
-  static void evaluatePasswordStrength(const QString &password, QColor &color, QString &grade, qreal *_fitness);
+  static const int BloomBitsPerEntry;
+  static const int BloomHashCount;
 
 signals:
+  void indexReady(void);
 
 public slots:
 
@@ -53,6 +76,13 @@ private:
 
 private: // methods
   qint64 findInPasswordFile(qint64 lo, qint64 hi, const QString &needle);
+  qint64 findInMappedFile(const QString &needle) const;
+  qint64 findInIndex(const QString &needle) const;
+  QString indexFileName(void) const;
+  bool loadIndex(void);
+  bool buildIndex(void);
+  void prepareIndex(void);
+  static void gradePasswordStrength(bool empty, qreal guessesLog10, QColor &color, QString &grade);
 };
 
 #endif // __PASSWORDCHECKER_H_
@@ -0,0 +1,379 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "saltsearch.h"
+#include "cancellationtoken.h"
+#include "derivation.h"
+#include "passwordtemplateplan.h"
+#include "pbkdf2.h"
+#include "sha512multibuffer.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QJsonDocument>
+#include <QVariantMap>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+#include <QtConcurrent>
+
+
+const int SaltSearch::ProgressIntervalMSecs = 500;
+static const quint64 Idle = ~Q_UINT64_C(0);
+
+
+SaltSearch::Checkpoint::Checkpoint(void)
+  : shard(0)
+  , shardCount(1)
+  , nextIndex(0)
+  , candidatesTested(0)
+  , elapsedMSecs(0)
+  , candidatesPerSecond(0)
+{ /* ... */ }
+
+
+bool SaltSearch::Checkpoint::isValid(void) const
+{
+  return startSalt.size() >= 2 && startSalt.size() <= 8 && shardCount > 0 && shard >= 0 && shard < shardCount;
+}
+
+
+bool SaltSearch::Checkpoint::isExhausted(void) const
+{
+  return nextIndex >= shardEnd();
+}
+
+
+/*!
+ * \brief SaltSearch::Checkpoint::shardBegin
+ *
+ * \return The index of the first candidate of the shard, counted from `startSalt`.
+ */
+quint64 SaltSearch::Checkpoint::shardBegin(void) const
+{
+  const quint64 spaceSize = Q_UINT64_C(1) << (8 * (startSalt.size() - 1));
+  return spaceSize / quint64(shardCount) * quint64(shard);
+}
+
+
+quint64 SaltSearch::Checkpoint::shardEnd(void) const
+{
+  const quint64 spaceSize = Q_UINT64_C(1) << (8 * (startSalt.size() - 1));
+  return (shard == shardCount - 1)
+      ? spaceSize
+      : spaceSize / quint64(shardCount) * quint64(shard + 1);
+}
+
+
+QByteArray SaltSearch::Checkpoint::toJson(void) const
+{
+  QVariantMap map;
+  map["startSalt"] = QString::fromUtf8(startSalt.toBase64());
+  map["shard"] = shard;
+  map["shardCount"] = shardCount;
+  map["nextIndex"] = QString::number(nextIndex);
+  map["candidatesTested"] = candidatesTested;
+  map["elapsedMSecs"] = elapsedMSecs;
+  map["candidatesPerSecond"] = candidatesPerSecond;
+  return QJsonDocument::fromVariant(map).toJson(QJsonDocument::Compact);
+}
+
+
+SaltSearch::Checkpoint SaltSearch::Checkpoint::fromJson(const QByteArray &json)
+{
+  const QVariantMap &map = QJsonDocument::fromJson(json).toVariant().toMap();
+  Checkpoint cp;
+  cp.startSalt = QByteArray::fromBase64(map["startSalt"].toByteArray());
+  cp.shard = map["shard"].toInt();
+  cp.shardCount = map["shardCount"].toInt();
+  cp.nextIndex = map["nextIndex"].toString().toULongLong();
+  cp.candidatesTested = map["candidatesTested"].toLongLong();
+  cp.elapsedMSecs = map["elapsedMSecs"].toLongLong();
+  cp.candidatesPerSecond = map["candidatesPerSecond"].toDouble();
+  return cp;
+}
+
+
+class SaltSearchPrivate {
+public:
+  SaltSearchPrivate(void)
+    : iterations(1)
+    , spaceSize(0)
+    , startValue(0)
+    , end(0)
+    , permutations(1)
+    , found(false)
+  {
+    timer.setInterval(SaltSearch::ProgressIntervalMSecs);
+  }
+  ~SaltSearchPrivate()
+  { /* ... */ }
+  QByteArray saltAt(quint64 idx) const;
+  void work(int worker);
+  quint64 lowWatermark(void) const;
+  SecureByteArray pwd;
+  int iterations;
+  QSharedPointer<const PasswordTemplatePlan> plan;
+  PositionTable target;
+  SaltSearch::Checkpoint origin;
+  quint64 spaceSize;
+  quint64 startValue;
+  quint64 end;
+  quint64 permutations;
+  QAtomicInteger<quint64> next;
+  QAtomicInteger<quint64> tested;
+  QVector<QSharedPointer<QAtomicInteger<quint64> > > inFlight;
+  CancellationToken token;
+  QMutex resultMutex;
+  bool found;
+  QByteArray foundSalt;
+  QString foundPassword;
+  QList<QFuture<void> > workers;
+  QThreadPool pool;
+  QElapsedTimer clock;
+  QTimer timer;
+};
+
+
+/*!
+ * \brief SaltSearchPrivate::saltAt
+ *
+ * \return The salt `idx` steps of `incrementEndianless()` after the start salt.
+ */
+QByteArray SaltSearchPrivate::saltAt(quint64 idx) const
+{
+  QByteArray salt = origin.startSalt;
+  quint64 v = (startValue + idx) & (spaceSize - 1);
+  for (int i = salt.size() - 1; i > 0; --i) {
+    salt[i] = static_cast<char>(v & 0xffU);
+    v >>= 8;
+  }
+  return salt;
+}
+
+
+/*!
+ * \brief SaltSearchPrivate::lowWatermark
+ *
+ * \return The index of the first candidate that has not been tested completely.
+ */
+quint64 SaltSearchPrivate::lowWatermark(void) const
+{
+  quint64 mark = qMin(next.load(), end);
+  foreach (const QSharedPointer<QAtomicInteger<quint64> > &first, inFlight) {
+    mark = qMin(mark, first->load());
+  }
+  return mark;
+}
+
+
+void SaltSearchPrivate::work(int worker)
+{
+  QAtomicInteger<quint64> &current = *inFlight.at(worker);
+  const int lanes = Sha512MultiBuffer::bestKernel().lanes;
+  QVector<PBKDF2Job> jobs;
+  jobs.reserve(lanes);
+  while (!token.isCancelled()) {
+    // publish a lower bound before taking the block, so that lowWatermark() never skips it
+    current.store(next.load());
+    const quint64 first = next.fetchAndAddRelaxed(quint64(lanes));
+    if (first >= end)
+      break;
+    current.store(first);
+    const int n = int(qMin(quint64(lanes), end - first));
+    jobs.resize(0);
+    for (int j = 0; j < n; ++j) {
+      jobs.append(PBKDF2Job(pwd, saltAt(first + quint64(j)), iterations));
+    }
+    const QVector<SecureByteArray> &keys = PBKDF2::generateBatch(jobs);
+    for (int j = 0; j < n; ++j) {
+      const SecureString &password = Derivation::shape(*plan, keys.at(j));
+      if (PositionTable(password) == target) {
+        QMutexLocker locker(&resultMutex);
+        if (!found) {
+          found = true;
+          foundSalt = jobs.at(j).salt;
+          foundPassword = password;
+        }
+        token.cancel();
+      }
+    }
+    tested.fetchAndAddRelaxed(quint64(n));
+  }
+  current.store(Idle);
+}
+
+
+SaltSearch::SaltSearch(QObject *parent)
+  : QObject(parent)
+  , d_ptr(new SaltSearchPrivate)
+{
+  Q_D(SaltSearch);
+  QObject::connect(&d->timer, SIGNAL(timeout()), SLOT(onTick()));
+}
+
+
+SaltSearch::~SaltSearch()
+{
+  Q_D(SaltSearch);
+  d->token.cancel();
+  d->pool.waitForDone();
+}
+
+
+/*!
+ * \brief SaltSearch::start
+ *
+ * Starts searching shard `shard` of `shardCount` in the background, counting from
+ * `startSalt`, which must be 2 to 8 bytes long. Emits `progress()` every
+ * `ProgressIntervalMSecs` milliseconds and `finished()` when done, preceded by
+ * `found()` if a matching salt has been found.
+ */
+void SaltSearch::start(const SecureByteArray &key, const DomainSettings &ds, const PositionTable &target, const QByteArray &startSalt, int shard, int shardCount)
+{
+  Checkpoint cp;
+  cp.startSalt = startSalt;
+  cp.shard = shard;
+  cp.shardCount = shardCount;
+  cp.nextIndex = cp.shardBegin();
+  resume(key, ds, target, cp);
+}
+
+
+/*!
+ * \brief SaltSearch::resume
+ *
+ * Continues the search described by `checkpoint`, as returned by `checkpoint()`.
+ */
+void SaltSearch::resume(const SecureByteArray &key, const DomainSettings &ds, const PositionTable &target, const Checkpoint &checkpoint)
+{
+  Q_D(SaltSearch);
+  Q_ASSERT_X(checkpoint.isValid(), "SaltSearch::resume()", "invalid checkpoint");
+  cancel();
+  const DerivationRequest request(key, ds);
+  d->pwd = request.pwd;
+  d->iterations = request.iterations;
+  d->plan = PasswordTemplatePlan::get(request.passwordTemplate, request.extraCharacters);
+  d->target = target;
+  d->permutations = target.permutations();
+  d->origin = checkpoint;
+  d->spaceSize = Q_UINT64_C(1) << (8 * (checkpoint.startSalt.size() - 1));
+  d->startValue = 0;
+  for (int i = 1; i < checkpoint.startSalt.size(); ++i) {
+    d->startValue = (d->startValue << 8) | quint8(checkpoint.startSalt.at(i));
+  }
+  d->end = checkpoint.shardEnd();
+  d->next.store(checkpoint.nextIndex);
+  d->tested.store(0);
+  d->token.reset();
+  d->found = false;
+  d->foundSalt.clear();
+  d->foundPassword.clear();
+  d->workers.clear();
+  d->pool.setMaxThreadCount(QThread::idealThreadCount());
+  d->inFlight.clear();
+  for (int i = 0; i < d->pool.maxThreadCount(); ++i) {
+    d->inFlight.append(QSharedPointer<QAtomicInteger<quint64> >(new QAtomicInteger<quint64>(Idle)));
+  }
+  for (int i = 0; i < d->pool.maxThreadCount(); ++i) {
+    d->workers.append(QtConcurrent::run(&d->pool, d, &SaltSearchPrivate::work, i));
+  }
+  d->clock.start();
+  d->timer.start();
+}
+
+
+/*!
+ * \brief SaltSearch::cancel
+ *
+ * Stops the search and waits for the workers to finish. `finished()` is not emitted.
+ */
+void SaltSearch::cancel(void)
+{
+  Q_D(SaltSearch);
+  d->timer.stop();
+  d->token.cancel();
+  d->pool.waitForDone();
+}
+
+
+/*!
+ * \brief SaltSearch::checkpoint
+ *
+ * \return A snapshot from which `resume()` can continue the current or last search.
+ */
+SaltSearch::Checkpoint SaltSearch::checkpoint(void) const
+{
+  Q_D(const SaltSearch);
+  Checkpoint cp = d->origin;
+  cp.nextIndex = d->lowWatermark();
+  cp.candidatesTested = d->origin.candidatesTested + qint64(d->tested.load());
+  cp.elapsedMSecs = elapsedMSecs();
+  cp.candidatesPerSecond = cp.elapsedMSecs > 0
+      ? 1e3 * qreal(cp.candidatesTested) / qreal(cp.elapsedMSecs)
+      : 0;
+  return cp;
+}
+
+
+bool SaltSearch::isRunning(void) const
+{
+  return d_ptr->timer.isActive();
+}
+
+
+qint64 SaltSearch::candidatesTested(void) const
+{
+  return d_ptr->origin.candidatesTested + qint64(d_ptr->tested.load());
+}
+
+
+qint64 SaltSearch::elapsedMSecs(void) const
+{
+  return d_ptr->origin.elapsedMSecs + (d_ptr->clock.isValid() ? d_ptr->clock.elapsed() : 0);
+}
+
+
+void SaltSearch::onTick(void)
+{
+  Q_D(SaltSearch);
+  const quint64 tested = quint64(candidatesTested());
+  const qint64 elapsed = qMax(Q_INT64_C(1), elapsedMSecs());
+  const qreal candidatesPerSecond = 1e3 * qreal(tested) / qreal(elapsed);
+  // on average, one in `permutations` candidates matches
+  const qreal secondsRemaining = (tested < d->permutations && candidatesPerSecond > 0)
+      ? qreal(d->permutations - tested) / candidatesPerSecond
+      : 0;
+  emit progress(qint64(tested), candidatesPerSecond, secondsRemaining);
+  foreach (QFuture<void> worker, d->workers) {
+    if (!worker.isFinished())
+      return;
+  }
+  d->timer.stop();
+  if (d->found) {
+    emit found(d->foundSalt, d->foundPassword);
+  }
+  emit finished();
+}
@@ -0,0 +1,101 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SALTSEARCH_H_
+#define __SALTSEARCH_H_
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QScopedPointer>
+
+#include "domainsettings.h"
+#include "securebytearray.h"
+#include "hackhelper.h"
+
+class SaltSearchPrivate;
+
+/*!
+ * \brief The SaltSearch class
+ *
+ * `SaltSearch` looks for a salt that makes the password derived from a
+ * given key and domain settings have the same character positions as a
+ * legacy password (see `PositionTable`).
+ *
+ * Candidate salts are enumerated like `incrementEndianless()` does, i.e.
+ * the first byte stays fixed and the remaining bytes form a big-endian
+ * counter. Worker threads on all cores take blocks of candidates from a
+ * shared counter and derive them with the multi-buffer PBKDF2 kernels,
+ * without touching the GUI.
+ *
+ * The candidate range can be split into `shardCount` shards, so that
+ * several processes can search in parallel. `checkpoint()` returns a
+ * resumable snapshot of the search; no candidate before
+ * `Checkpoint::nextIndex` is left untested.
+ */
+class SaltSearch : public QObject
+{
+  Q_OBJECT
+public:
+  explicit SaltSearch(QObject *parent = Q_NULLPTR);
+  ~SaltSearch();
+
+  static const int ProgressIntervalMSecs;
+
+  struct Checkpoint {
+    Checkpoint(void);
+    QByteArray startSalt;
+    int shard;
+    int shardCount;
+    quint64 nextIndex;
+    qint64 candidatesTested;
+    qint64 elapsedMSecs;
+    qreal candidatesPerSecond;
+    bool isValid(void) const;
+    bool isExhausted(void) const;
+    quint64 shardBegin(void) const;
+    quint64 shardEnd(void) const;
+    QByteArray toJson(void) const;
+    static Checkpoint fromJson(const QByteArray &json);
+  };
+
+  void start(const SecureByteArray &key, const DomainSettings &ds, const PositionTable &target, const QByteArray &startSalt, int shard = 0, int shardCount = 1);
+  void resume(const SecureByteArray &key, const DomainSettings &ds, const PositionTable &target, const Checkpoint &checkpoint);
+  void cancel(void);
+  Checkpoint checkpoint(void) const;
+  bool isRunning(void) const;
+  qint64 candidatesTested(void) const;
+  qint64 elapsedMSecs(void) const;
+
+signals:
+  void progress(qint64 candidatesTested, qreal candidatesPerSecond, qreal secondsRemaining);
+  void found(const QByteArray &salt, const QString &password);
+  void finished(void);
+
+private slots:
+  void onTick(void);
+
+private:
+  QScopedPointer<SaltSearchPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(SaltSearch)
+  Q_DISABLE_COPY(SaltSearch)
+};
+
+
+#endif // __SALTSEARCH_H_
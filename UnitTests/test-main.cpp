@@ -19,6 +19,22 @@
 
 
 #include "pbkdf2.h"
+#include "hmacengine.h"
+#include "hashbackend.h"
+#include "iterationcalibrator.h"
+#include "cryptoexecutor.h"
+#include "uint512.h"
+#include "passwordtemplateplan.h"
+#include "passwordbatch.h"
+#include "passwordscheduler.h"
+#include "derivedkeycache.h"
+#include "saltkeyivpool.h"
+#include "speculativederiver.h"
+#include "passworddictionary.h"
+#include "breachedhashlist.h"
+#include "strengthestimator.h"
+#include "vaultaudit.h"
+#include "derivation.h"
 #include "password.h"
 #include "crypter.h"
 #include "exporter.h"
@@ -26,8 +42,16 @@
 
 #include <QDebug>
 #include <QDir>
+#include <QTemporaryFile>
+#include <QBuffer>
 #include <QMessageAuthenticationCode>
 #include <QtTest/QTest>
+#include <QSignalSpy>
+#include <QMutex>
+#include <QSemaphore>
+
+#include <algorithm>
+#include <stdexcept>
 
 
 class TestSESAM : public QObject
@@ -61,6 +85,23 @@ private slots:
     QVERIFY(hmac.result() == QByteArray::fromHex("08fce52f6395d59c2a3fb8abb281d74ad6f112b9a9c787bcea290d94dadbc82b2ca3e5e12bf2277c7fedbb0154d5493e41bb7459f63c8e39554ea3651b812492"));
   }
 
+  void hmac_engine_sha512(void)
+  {
+    HMACEngine<Sha512> hmac("secret", 6);
+    QByteArray mac(Sha512::DigestSize, '\0');
+    hmac.mac("mes", 3, "sage", 4, reinterpret_cast<uchar*>(mac.data()));
+    QVERIFY(mac == QByteArray::fromHex("1bba587c730eedba31f53abb0b6ca589e09de4e894ee455e6140807399759adaafa069eec7c01647bb173dcb17f55d22af49a18071b748c5c2edd7f7a829c632"));
+  }
+
+  void hmac_engine_long_key(void)
+  {
+    const QByteArray key(200, 'k');
+    const QByteArray msg(300, 'm');
+    QByteArray mac(Sha384::DigestSize, '\0');
+    HMACEngine<Sha384>(key.constData(), key.size()).mac(msg.constData(), msg.size(), Q_NULLPTR, 0, reinterpret_cast<uchar*>(mac.data()));
+    QVERIFY(mac == QMessageAuthenticationCode::hash(msg, key, QCryptographicHash::Sha384));
+  }
+
   void base64(void)
   {
     QVERIFY(QByteArray::fromBase64(DomainSettings::DefaultSalt_base64) == "pepper");
@@ -103,6 +144,170 @@ private slots:
     QVERIFY(pbkdf2.derivedKey() == QByteArray::fromHex("db78c5091444940f9642fce519097ee7adfeb338fd6970855135539020b53fad"));
   }
 
+  void pbkdf2_sha256_rfc7914(void)
+  {
+    PBKDF2 pbkdf2(QString("passwordPASSWORDpassword").toUtf8(), QString("saltSALTsaltSALTsaltSALTsaltSALTsalt").toUtf8(), 4096, QCryptographicHash::Sha256);
+    QVERIFY(pbkdf2.derivedKey() == QByteArray::fromHex("348c89dbcbd32b2f32d814b8116e84cf2b17347ebc1800181c4e2a1fb8dd53e1"));
+  }
+
+  void pbkdf2_sha256_shani(void)
+  {
+    if (!Sha256NI::isSupported())
+      QSKIP("CPU lacks SHA extensions");
+    const HMACEngine<Sha256NI> hmac1("message", 7);
+    HMACEngine<Sha256NI>::PBKDF2Chain chain1;
+    hmac1.beginPBKDF2("salt", 4, chain1);
+    hmac1.iteratePBKDF2(chain1, 2);
+    QByteArray key1(Sha256NI::DigestSize, '\0');
+    HMACEngine<Sha256NI>::finishPBKDF2(chain1, reinterpret_cast<uchar*>(key1.data()));
+    QVERIFY(key1 == QByteArray::fromHex("db78c5091444940f9642fce519097ee7adfeb338fd6970855135539020b53fad"));
+    const HMACEngine<Sha256NI> hmac2("passwordPASSWORDpassword", 24);
+    HMACEngine<Sha256NI>::PBKDF2Chain chain2;
+    hmac2.beginPBKDF2("saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, chain2);
+    hmac2.iteratePBKDF2(chain2, 4095);
+    QByteArray key2(Sha256NI::DigestSize, '\0');
+    HMACEngine<Sha256NI>::finishPBKDF2(chain2, reinterpret_cast<uchar*>(key2.data()));
+    QVERIFY(key2 == QByteArray::fromHex("348c89dbcbd32b2f32d814b8116e84cf2b17347ebc1800181c4e2a1fb8dd53e1"));
+  }
+
+  void pbkdf2_cancellation_token(void)
+  {
+    CancellationToken token;
+    PBKDF2 pbkdf2;
+    pbkdf2.setCancellationToken(&token);
+    token.cancel();
+    pbkdf2.generate(QString("message").toUtf8(), QString("salt").toUtf8(), 100000, QCryptographicHash::Sha512);
+    QVERIFY(pbkdf2.isAborted());
+    token.reset();
+    pbkdf2.generate(QString("message").toUtf8(), QString("pepper").toUtf8(), 3, QCryptographicHash::Sha512);
+    QVERIFY(!pbkdf2.isAborted());
+    QVERIFY(pbkdf2.derivedKey() == QByteArray::fromHex("2646f9ccb58d21406815bafc62245771bf80aaa080a633ff1bdd660eb44f369a89da48fb041c5551a118de20cfb8b96b92e7a9945425ba889e9ad645614522eb"));
+  }
+
+  void pbkdf2_abort_queued(void)
+  {
+    CryptoExecutor &executor = CryptoExecutor::instance();
+    const int maxThreadCount = executor.maxThreadCount();
+    executor.setMaxThreadCount(1);
+    QSemaphore gate;
+    executor.run(CryptoExecutor::Normal, "gate", [&gate]() { gate.acquire(); });
+    PBKDF2 pbkdf2;
+    pbkdf2.generateAsync(QString("message").toUtf8(), QString("pepper").toUtf8(), 10000000, QCryptographicHash::Sha512);
+    pbkdf2.abortGeneration();
+    gate.release();
+    executor.waitForDone();
+    QVERIFY(pbkdf2.isAborted());
+    const PBKDF2 oneIteration(QString("message").toUtf8(), QString("pepper").toUtf8(), 1, QCryptographicHash::Sha512);
+    QVERIFY(pbkdf2.derivedKey() == oneIteration.derivedKey());
+    executor.setMaxThreadCount(maxThreadCount);
+  }
+
+  void pbkdf2_batch(void)
+  {
+    QVector<PBKDF2Job> jobs;
+    for (int i = 0; i < 11; ++i) {
+      jobs.append(PBKDF2Job(QString("message %1").arg(i).toUtf8(), QByteArray(i * 13, 's'), 1 + 97 * i));
+    }
+    const QVector<SecureByteArray> &keys = PBKDF2::generateBatch(jobs);
+    QVERIFY(keys.size() == jobs.size());
+    for (int i = 0; i < jobs.size(); ++i) {
+      PBKDF2 pbkdf2(jobs.at(i).pwd, jobs.at(i).salt, jobs.at(i).iterations, QCryptographicHash::Sha512);
+      QVERIFY(keys.at(i) == pbkdf2.derivedKey());
+    }
+  }
+
+  void hash_backend_registry(void)
+  {
+    HashBackendRegistry &registry = HashBackendRegistry::instance();
+    registry.benchmark();
+    QVERIFY(registry.isBenchmarked());
+    const QCryptographicHash::Algorithm algorithms[3] = { QCryptographicHash::Sha256, QCryptographicHash::Sha384, QCryptographicHash::Sha512 };
+    for (int i = 0; i < 3; ++i) {
+      int nSelected = 0;
+      foreach (HashBackendMeasurement m, registry.measurements()) {
+        if (m.algorithm == algorithms[i] && m.selected) {
+          ++nSelected;
+        }
+      }
+      QVERIFY(nSelected == 1);
+      QVERIFY(registry.backend(algorithms[i]) != Q_NULLPTR);
+    }
+    QScopedPointer<HashBackend::PBKDF2Chain> chain(registry.backend(QCryptographicHash::Sha256)->beginPBKDF2(QCryptographicHash::Sha256, SecureByteArray("password"), QByteArray("salt")));
+    chain->iterate(4095);
+    QVERIFY(chain->derivedKey() == QByteArray::fromHex("c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a"));
+  }
+
+  void crypto_executor(void)
+  {
+    CryptoExecutor &executor = CryptoExecutor::instance();
+    const int maxThreadCount = executor.maxThreadCount();
+    executor.setMaxThreadCount(1);
+    QSemaphore gate;
+    QMutex mutex;
+    QStringList order;
+    auto append = [&mutex, &order](const QString &s) {
+      QMutexLocker locker(&mutex);
+      order.append(s);
+    };
+    QSemaphore backgroundGate;
+    executor.run(CryptoExecutor::Background, "backgroundGate", [&backgroundGate]() { backgroundGate.acquire(); });
+    executor.run(CryptoExecutor::Normal, "gate", [&gate]() { gate.acquire(); });
+    QTRY_COMPARE(executor.activeCount(CryptoExecutor::Background), 1);
+    QTRY_COMPARE(executor.activeCount(CryptoExecutor::Normal), 1);
+    const QFuture<void> &background = executor.run(CryptoExecutor::Background, "background", [&append]() { append("background"); });
+    executor.run(CryptoExecutor::Normal, "normal", [&append]() { append("normal"); });
+    executor.run(CryptoExecutor::Interactive, "interactive", [&append]() { append("interactive"); });
+    QCOMPARE(executor.queueDepth(CryptoExecutor::Background), 1);
+    QCOMPARE(executor.cancel("background"), 1);
+    QVERIFY(background.isCanceled());
+    QCOMPARE(executor.queueDepth(CryptoExecutor::Background), 0);
+    gate.release();
+    // a running Background task must not hold up foreground work
+    QTRY_COMPARE(order, QStringList() << "interactive" << "normal");
+    backgroundGate.release();
+    executor.waitForDone();
+    const QFuture<void> &throwing = executor.run(CryptoExecutor::Normal, "throwing", []() { throw std::runtime_error("test"); });
+    executor.waitForDone();
+    QVERIFY(throwing.isFinished());
+    QCOMPARE(executor.activeCount(CryptoExecutor::Normal), 0);
+    executor.setMaxThreadCount(maxThreadCount);
+  }
+
+  void iteration_calibrator(void)
+  {
+    QVERIFY(IterationCalibrator::iterationsFor(250, 1e6) == 249856);
+    QVERIFY(IterationCalibrator::iterationsFor(250, 10) == IterationCalibrator::MinIterations);
+    QVERIFY(IterationCalibrator::iterationsFor(10000, 1e10) == IterationCalibrator::MaxIterations);
+    QVERIFY(IterationCalibrator::measure() > 0);
+  }
+
+  void uint512_divmod(void)
+  {
+    const QByteArray &bytes = QByteArray::fromHex("0123456789abcdef");
+    UInt512 v(reinterpret_cast<const uchar*>(bytes.constData()), bytes.size());
+    QString digits;
+    while (!v.isZero()) {
+      digits.prepend(QChar('0' + v.divMod(10)));
+    }
+    QVERIFY(digits == QString::number(Q_UINT64_C(0x0123456789abcdef)));
+    const QByteArray max(UInt512::Size, '\xff');
+    UInt512 w(reinterpret_cast<const uchar*>(max.constData()), max.size());
+    QVERIFY(w.divMod(0x10000) == 0xffff);
+    QVERIFY(w.divMod(7) == 1);
+  }
+
+  void password_template_plan(void)
+  {
+    QSharedPointer<const PasswordTemplatePlan> plan = PasswordTemplatePlan::get("xxAanno", "#!");
+    QVERIFY(plan == PasswordTemplatePlan::get("xxAanno", "#!"));
+    QVERIFY(plan->error() == Password::NoError);
+    QVERIFY(plan->length() == 7);
+    QVERIFY(plan->usedCharacters() == Password::Digits + Password::LowerChars + Password::UpperChars + "#!");
+    QVERIFY(PasswordTemplatePlan::get("xxo", QString())->error() == Password::EmptyCharacterSetError);
+    QVERIFY(PasswordTemplatePlan::get("xxq", QString())->error() == Password::EmptyCharacterSetError);
+    QVERIFY(PasswordTemplatePlan::get("nxq", QString())->error() == Password::EmptyTemplateError);
+  }
+
   void pwdgen_simple_password_1(void)
   {
     DomainSettings ds;
@@ -146,6 +351,154 @@ private slots:
     QVERIFY(pwd.remix() == "wLUwoQvKzBaYXbme");
   }
 
+  void pwdgen_update_remix_only(void)
+  {
+    DomainSettings ds;
+    ds.domainName = "MyFavoriteDomain";
+    ds.extraCharacters = "abcdefghijklmnopqrstuvwxyzABCDEFGHJKLMNPQRTUVWXYZ";
+    ds.iterations = 8192;
+    ds.passwordTemplate = "oxxxxxxxxxxxxxxx";
+    ds.salt_base64 = QString("pepper").toUtf8().toBase64();
+    Password pwd;
+    QVERIFY(pwd.needsKeyDerivation("foobar", ds));
+    QVERIFY(pwd.update("foobar", ds));
+    pwd.waitForFinished();
+    QVERIFY(pwd.password() == "wLUwoQvKzBaYXbme");
+    QVERIFY(!pwd.needsKeyDerivation("foobar", ds));
+    ds.passwordTemplate = "oxxxxxxx";
+    QVERIFY(!pwd.update("foobar", ds));
+    QVERIFY(pwd.password() == "wLUwoQvK");
+    ds.iterations = 4096;
+    QVERIFY(pwd.needsKeyDerivation("foobar", ds));
+    QVERIFY(pwd.update("foobar", ds));
+    pwd.waitForFinished();
+  }
+
+  void pwdgen_scheduler_latest_wins(void)
+  {
+    DomainSettings ds;
+    ds.domainName = "MyFavoriteDomain";
+    ds.extraCharacters = "abcdefghijklmnopqrstuvwxyzABCDEFGHJKLMNPQRTUVWXYZ";
+    ds.passwordTemplate = "oxxxxxxxxxxxxxxx";
+    ds.salt_base64 = QString("pepper").toUtf8().toBase64();
+    Password pwd;
+    PasswordScheduler scheduler(&pwd);
+    QSignalSpy dispatched(&scheduler, SIGNAL(derivationDispatched()));
+    for (int iterations = 4096; iterations <= 8192; iterations += 1024) {
+      ds.iterations = iterations;
+      scheduler.request("foobar", ds);
+      QVERIFY(scheduler.hasPendingRequest());
+    }
+    QVERIFY(!pwd.isRunning());
+    scheduler.flush();
+    QVERIFY(!scheduler.hasPendingRequest());
+    QCOMPARE(dispatched.count(), 1);
+    pwd.waitForFinished();
+    QVERIFY(pwd.password() == "wLUwoQvKzBaYXbme");
+    ds.passwordTemplate = "oxxxxxxx";
+    scheduler.request("foobar", ds);
+    QVERIFY(!scheduler.hasPendingRequest());
+    QVERIFY(pwd.password() == "wLUwoQvK");
+  }
+
+  void pwdgen_derived_key_cache(void)
+  {
+    DomainSettings ds;
+    ds.domainName = "MyFavoriteDomain";
+    ds.extraCharacters = "abcdefghijklmnopqrstuvwxyzABCDEFGHJKLMNPQRTUVWXYZ";
+    ds.iterations = 8192;
+    ds.passwordTemplate = "oxxxxxxxxxxxxxxx";
+    ds.salt_base64 = QString("pepper").toUtf8().toBase64();
+    DomainSettings other = ds;
+    other.domainName = "MyOtherDomain";
+    DerivedKeyCache cache(2);
+    Password pwd;
+    pwd.setKeyCache(&cache);
+    QVERIFY(pwd.update("foobar", ds));
+    pwd.waitForFinished();
+    QVERIFY(pwd.update("foobar", other));
+    pwd.waitForFinished();
+    QCOMPARE(cache.count(), 2);
+    QVERIFY(!pwd.needsKeyDerivation("foobar", ds));
+    QVERIFY(!pwd.update("foobar", ds));
+    QVERIFY(pwd.hexKey() == "cb0ae7b2b7fc969770a9bfc1eef3a9afd02d2b28d6d8e9cb324f41a31392a0f800ea7e2e43e847537ceb863a16a869d5e4dd6822cf3be0206440eff97dc2001c");
+    QVERIFY(pwd.password() == "wLUwoQvKzBaYXbme");
+    QVERIFY(pwd.needsKeyDerivation("barfoo", ds));
+    cache.clear();
+    QCOMPARE(cache.count(), 0);
+    QVERIFY(pwd.needsKeyDerivation("foobar", other));
+  }
+
+  void derived_key_cache_storage(void)
+  {
+    DerivedKeyCache cache(200);
+    for (int i = 0; i < 200; ++i) {
+      cache.insert(QByteArray::number(i), SecureByteArray(QByteArray(64, char(i))));
+    }
+    const SecureByteArray bigKey(QByteArray(100, 'k'));
+    cache.insert("big", bigKey);
+    QCOMPARE(cache.count(), 200);
+    SecureByteArray key;
+    QVERIFY(!cache.lookup("0", key));
+    QVERIFY(cache.lookup("199", key));
+    QVERIFY(key == QByteArray(64, char(199)));
+    QVERIFY(cache.lookup("big", key));
+    QVERIFY(key == bigKey);
+    cache.setCapacity(1);
+    QCOMPARE(cache.count(), 1);
+    QVERIFY(cache.lookup("big", key));
+    cache.insert("small", SecureByteArray("abc"));
+    QVERIFY(cache.lookup("small", key));
+    QVERIFY(key == QByteArray("abc"));
+  }
+
+  void pwdgen_speculative_derivation(void)
+  {
+    DomainSettings ds;
+    ds.domainName = "MyFavoriteDomain";
+    ds.extraCharacters = "abcdefghijklmnopqrstuvwxyzABCDEFGHJKLMNPQRTUVWXYZ";
+    ds.iterations = 8192;
+    ds.passwordTemplate = "oxxxxxxxxxxxxxxx";
+    ds.salt_base64 = QString("pepper").toUtf8().toBase64();
+    DomainSettings legacy = ds;
+    legacy.domainName = "MyLegacyDomain";
+    legacy.legacyPassword = "secret";
+    DomainSettingsList candidates;
+    candidates.append(legacy);
+    candidates.append(ds);
+    DerivedKeyCache cache;
+    SpeculativeDeriver speculativeDeriver(&cache);
+    speculativeDeriver.speculate("foobar", candidates);
+    speculativeDeriver.waitForDone();
+    QCOMPARE(cache.count(), 1);
+    QVERIFY(cache.contains(Password::keyFingerprint("foobar", ds)));
+    Password pwd;
+    pwd.setKeyCache(&cache);
+    QVERIFY(!pwd.update("foobar", ds));
+    QVERIFY(pwd.password() == "wLUwoQvKzBaYXbme");
+  }
+
+  void pwdgen_derivation_core(void)
+  {
+    DomainSettings ds;
+    ds.domainName = "MyFavoriteDomain";
+    ds.extraCharacters = "abcdefghijklmnopqrstuvwxyzABCDEFGHJKLMNPQRTUVWXYZ";
+    ds.iterations = 8192;
+    ds.passwordTemplate = "oxxxxxxxxxxxxxxx";
+    ds.salt_base64 = QString("pepper").toUtf8().toBase64();
+    const DerivationResult &result = Derivation::derive(DerivationRequest("foobar", ds));
+    QVERIFY(!result.aborted);
+    QCOMPARE(result.error, int(Password::NoError));
+    QVERIFY(result.derivedKey.toHex() == "cb0ae7b2b7fc969770a9bfc1eef3a9afd02d2b28d6d8e9cb324f41a31392a0f800ea7e2e43e847537ceb863a16a869d5e4dd6822cf3be0206440eff97dc2001c");
+    QVERIFY(result.password == "wLUwoQvKzBaYXbme");
+    CancellationToken token;
+    token.cancel();
+    const DerivationResult &aborted = Derivation::derive(DerivationRequest("foobar", ds), &token);
+    QVERIFY(aborted.aborted);
+    QCOMPARE(aborted.error, int(Password::AbortedError));
+    QVERIFY(aborted.password.isEmpty());
+  }
+
   void pwdgen_simple_password_1_tpl(void)
   {
     DomainSettings ds;
@@ -200,6 +553,41 @@ private slots:
     QVERIFY(pwd.password() == "626358a39dcc50d93a4347959a75");
   }
 
+  void pwdgen_batch(void)
+  {
+    DomainSettingsList domains;
+    for (int i = 0; i < 10; ++i) {
+      DomainSettings ds;
+      ds.domainName = QString("FooBar%1").arg(i);
+      ds.userName = "user";
+      ds.extraCharacters = "#!\"$%&/()[]{}=-_+*<>;:.";
+      ds.iterations = 512 + 64 * i;
+      ds.passwordTemplate = (i == 7) ? "nxq" : "xxoxAxxxxxxxxxaxx";
+      ds.salt_base64 = QString("blahfasel").toUtf8().toBase64();
+      domains.append(ds);
+    }
+    QVector<PasswordBatch::Result> results(domains.size());
+    int nResults = 0;
+    PasswordBatch::derive(domains, "test", [&](const PasswordBatch::Result &result) {
+      results[result.index] = result;
+      ++nResults;
+    }, Q_NULLPTR, 3);
+    QVERIFY(nResults == domains.size());
+    for (int i = 0; i < domains.size(); ++i) {
+      Password pwd(domains.at(i));
+      pwd.generate("test");
+      QVERIFY(results.at(i).error == pwd.error());
+      QVERIFY(results.at(i).password == pwd.password());
+    }
+    QVERIFY(results.at(7).error == Password::EmptyTemplateError);
+    CancellationToken token;
+    token.cancel();
+    PasswordBatch::derive(domains, "test", [&](const PasswordBatch::Result &result) {
+      results[result.index] = result;
+    }, &token);
+    QVERIFY(results.at(0).error == Password::AbortedError);
+  }
+
   void pwdgen_pin(void)
   {
     DomainSettings ds;
@@ -214,6 +602,179 @@ private slots:
     QVERIFY(pwd.password() == "7809");
   }
 
+  void password_dictionary(void)
+  {
+    QVector<QByteArray> keys;
+    QByteArray text;
+    for (int i = 0; i < 1000; ++i) {
+      const QString &word = QString("Passw0rd%1").arg(i * 7919 % 100000, 5, 10, QChar('0'));
+      keys.append(PasswordDictionary::key(word));
+      text.append(word.toLatin1()).append('\n');
+    }
+    std::sort(keys.begin(), keys.end());
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    PasswordDictionaryBuilder builder(&file, 16);
+    foreach (const QByteArray &key, keys) {
+      QVERIFY(builder.addKey(key));
+    }
+    QVERIFY(builder.addKey(keys.last()));
+    QVERIFY(!builder.addKey(keys.first()));
+    QVERIFY(builder.finish());
+    QVERIFY(builder.count() == 1000);
+    file.close();
+    QVERIFY(file.size() * 2 < text.size());
+
+    PasswordDictionary dict;
+    QVERIFY(PasswordDictionary::isDictionaryFile(file.fileName()));
+    QVERIFY(dict.open(file.fileName()));
+    QVERIFY(dict.count() == 1000);
+    QVERIFY(dict.blockSize() == 16);
+    for (int i = 0; i < keys.size(); ++i) {
+      QVERIFY(dict.find(QString::fromUtf8(keys.at(i))) == i);
+    }
+    QVERIFY(dict.contains("PASSW0RD07919"));
+    QVERIFY(!dict.contains("passw0rd"));
+    QVERIFY(!dict.contains("passw0rd079190"));
+    QVERIFY(!dict.contains("aaa"));
+    QVERIFY(!dict.contains("zzz"));
+  }
+
+  void breached_hash_list(void)
+  {
+    QVector<QByteArray> hashes;
+    for (int i = 0; i < 5000; ++i) {
+      hashes.append(BreachedHashList::hash(QString("secret%1").arg(i)));
+    }
+    std::sort(hashes.begin(), hashes.end());
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    BreachedHashListBuilder builder(&file);
+    for (int i = 0; i < hashes.size(); ++i) {
+      QVERIFY(builder.add(hashes.at(i), quint32(i + 1)));
+    }
+    QVERIFY(!builder.add(hashes.first(), 1));
+    QVERIFY(builder.finish());
+    file.close();
+
+    BreachedHashList list;
+    QVERIFY(BreachedHashList::isHashListFile(file.fileName()));
+    QVERIFY(!PasswordDictionary::isDictionaryFile(file.fileName()));
+    QVERIFY(list.open(file.fileName()));
+    QVERIFY(list.count() == 5000);
+    for (int i = 0; i < hashes.size(); ++i) {
+      quint32 breachCount = 0;
+      QVERIFY(list.findHash(hashes.at(i), &breachCount) == i);
+      QVERIFY(breachCount == quint32(i + 1));
+    }
+    quint32 breachCount = 0;
+    const qint64 idx = list.find("secret42", &breachCount);
+    QVERIFY(idx >= 0);
+    QVERIFY(breachCount == quint32(idx + 1));
+    QVERIFY(!list.contains("Secret42"));
+    QVERIFY(!list.contains("secret5000"));
+  }
+
+  void strength_estimator(void)
+  {
+    QVERIFY(StrengthEstimator::guessesLog10("password") < 3);
+    QVERIFY(StrengthEstimator::guessesLog10("P@ssw0rd") < 5);
+    QVERIFY(StrengthEstimator::guessesLog10("aaaaaaaaaaaa") < 3);
+    QVERIFY(StrengthEstimator::guessesLog10("abcdefghij") < 3);
+    QVERIFY(StrengthEstimator::guessesLog10("12.05.1987") < 6);
+    QVERIFY(StrengthEstimator::guessesLog10("xK9#mQ2$vL7!") > 10);
+
+    StrengthEstimator walk;
+    walk.setPassword("qayxsw");
+    QVERIFY(walk.guessesLog10() < 6);
+    QVERIFY(walk.sequence().size() == 1);
+    QVERIFY(walk.sequence().first().pattern == StrengthEstimator::Spatial);
+
+    StrengthEstimator estimator;
+    QVERIFY(estimator.score() == 0);
+    const QString password = "Tr0ub4dor&3";
+    for (int i = 1; i <= password.size(); ++i) {
+      estimator.setPassword(password.left(i));
+      QVERIFY(qFuzzyCompare(1 + estimator.guessesLog10(), 1 + StrengthEstimator::guessesLog10(password.left(i))));
+    }
+    estimator.setPassword("Tr0ubador&3");
+    QVERIFY(qFuzzyCompare(1 + estimator.guessesLog10(), 1 + StrengthEstimator::guessesLog10("Tr0ubador&3")));
+    estimator.chop(3);
+    QVERIFY(estimator.password() == "Tr0ubado");
+    QVERIFY(qFuzzyCompare(1 + estimator.guessesLog10(), 1 + StrengthEstimator::guessesLog10("Tr0ubado")));
+    QVERIFY(estimator.guessesLog10() > StrengthEstimator::guessesLog10("password"));
+    estimator.clear();
+    QVERIFY(estimator.password().isEmpty());
+    QVERIFY(estimator.sequence().isEmpty());
+  }
+
+  void vault_audit(void)
+  {
+    DomainSettingsList domains;
+    for (int i = 0; i < 7; ++i) {
+      DomainSettings ds;
+      ds.domainName = QString("FooBar%1").arg(i);
+      ds.userName = "user";
+      ds.extraCharacters = "#!\"$%&/()[]{}=-_+*<>;:.";
+      ds.iterations = 512;
+      ds.passwordTemplate = "xxoxAxxxxxxxxxaxx";
+      ds.salt_base64 = QString("blahfasel").toUtf8().toBase64();
+      domains.append(ds);
+    }
+    domains[1].legacyPassword = "password";
+    domains[2].legacyPassword = "password";
+    domains[3].iterations = 128;
+    domains[3].extraCharacters = "0123456789";
+    domains[3].passwordTemplate = "oxxx";
+    domains[4].deleted = true;
+    domains[5].legacyPassword = "xK9#mQ2$vL7!";
+    domains[5].expiryDate = QDateTime::currentDateTime().addDays(-1);
+    domains[6].passwordTemplate = "nxq";
+
+    VaultAudit::Options options;
+    options.minIterations = 256;
+    options.maxThreads = 3;
+    options.breachCheck = [](const SecureString &password, quint32 *breachCount) {
+      if (password != "password")
+        return false;
+      *breachCount = 42;
+      return true;
+    };
+    int lastDone = 0;
+    int lastTotal = 0;
+    QVector<VaultAudit::Finding> findings = VaultAudit::run(domains, "test", options, [&](int done, int total) {
+      lastDone = done;
+      lastTotal = total;
+    });
+    QVERIFY(findings.size() == 6);
+    QVERIFY(lastTotal == 9);
+    QVERIFY(lastDone == lastTotal);
+    QHash<int, VaultAudit::Finding> byIndex;
+    foreach (const VaultAudit::Finding &f, findings) {
+      byIndex.insert(f.index, f);
+    }
+    QVERIFY(!byIndex.contains(4));
+    QVERIFY(byIndex.value(0).issues == VaultAudit::NoIssue);
+    QVERIFY(byIndex.value(1).issues == (VaultAudit::Breached | VaultAudit::Reused | VaultAudit::WeakPassword));
+    QVERIFY(byIndex.value(1).breachCount == 42);
+    QVERIFY(byIndex.value(1).reuseCount == 2);
+    QVERIFY(byIndex.value(1).reuseGroup == byIndex.value(2).reuseGroup);
+    QVERIFY(byIndex.value(3).issues == (VaultAudit::WeakPassword | VaultAudit::LowIterations));
+    QVERIFY(byIndex.value(5).issues == VaultAudit::Expired);
+    QVERIFY(byIndex.value(6).issues == VaultAudit::InvalidTemplate);
+
+    VaultAudit::sort(findings, VaultAudit::BySeverity, Qt::DescendingOrder);
+    QVERIFY(findings.first().index == 1);
+    QVERIFY(findings.at(1).index == 2);
+    QVERIFY(findings.last().index == 0);
+    VaultAudit::sort(findings, VaultAudit::ByDomainName);
+    QVERIFY(findings.first().domainName == "FooBar0");
+
+    CancellationToken token;
+    token.cancel();
+    QVERIFY(VaultAudit::run(domains, "test", options, VaultAudit::ProgressCallback(), &token).isEmpty());
+  }
+
   void complexity(void)
   {
     for (int cv = 0; cv < Password::MaxComplexityValue; ++cv) {
@@ -288,6 +849,124 @@ private slots:
     QVERIFY(KGK == KGK2);
   }
 
+  void crypter_key_cache(void)
+  {
+    SecureByteArray masterPassword = QString("7h15p455w0rd15m0r37h4n53cr37").toUtf8();
+    QByteArray salt = Crypter::generateSalt();
+    SecureByteArray key;
+    SecureByteArray IV;
+    Crypter::clearKeyCache();
+    Crypter::makeKeyAndIVFromPassword(masterPassword, salt, key, IV);
+    SecureByteArray KGK = Crypter::generateKGK();
+    QByteArray data = Crypter::randomBytes(1024);
+    QByteArray cipher = Crypter::encode(key, IV, salt, KGK, data, true);
+
+    PBKDF2 pbkdf2;
+    QSignalSpy spy(&pbkdf2, SIGNAL(generationStarted()));
+    SecureByteArray KGK2;
+    QVERIFY(Crypter::decode(masterPassword, cipher, true, KGK2, &pbkdf2) == data);
+    QVERIFY(spy.count() == 0);
+    SecureByteArray otherKey;
+    SecureByteArray otherIV;
+    Crypter::makeKeyAndIVFromPassword("another password", salt, otherKey, otherIV, &pbkdf2);
+    QVERIFY(spy.count() == 1);
+    QVERIFY(otherKey != key);
+    spy.clear();
+    Crypter::clearKeyCache();
+    QVERIFY(Crypter::decode(masterPassword, cipher, true, KGK2, &pbkdf2) == data);
+    QVERIFY(spy.count() == 2);
+    QVERIFY(KGK == KGK2);
+    SecureByteArray key2;
+    SecureByteArray IV2;
+    Crypter::makeKeyAndIVFromPassword(masterPassword, salt, key2, IV2);
+    QVERIFY(key2 == key);
+    QVERIFY(IV2 == IV);
+  }
+
+  void crypter_key_cache_cleared_during_derivation(void)
+  {
+    const SecureByteArray masterPassword = QString("7h15p455w0rd15m0r37h4n53cr37").toUtf8();
+    const QByteArray &salt = Crypter::generateSalt();
+    Crypter::clearKeyCache();
+    PBKDF2 clearingPbkdf2;
+    QObject::connect(&clearingPbkdf2, &PBKDF2::generationStarted, []() {
+      Crypter::clearKeyCache();
+    });
+    const SecureByteArray &key = Crypter::makeKeyFromPassword(masterPassword, salt, &clearingPbkdf2);
+    PBKDF2 pbkdf2;
+    QSignalSpy spy(&pbkdf2, SIGNAL(generationStarted()));
+    QVERIFY(Crypter::makeKeyFromPassword(masterPassword, salt, &pbkdf2) == key);
+    QVERIFY(spy.count() == 1);
+    spy.clear();
+    QVERIFY(Crypter::makeKeyFromPassword(masterPassword, salt, &pbkdf2) == key);
+    QVERIFY(spy.count() == 0);
+  }
+
+  void salt_key_iv_pool(void)
+  {
+    SecureByteArray masterPassword = QString("7h15p455w0rd15m0r37h4n53cr37").toUtf8();
+    SaltKeyIVPool pool(2);
+    SaltKeyIVPool::Entry entry;
+    QVERIFY(!pool.tryTake(entry));
+    QVERIFY(!pool.take().isValid());
+    pool.setMasterPassword(masterPassword);
+    pool.waitForFinished();
+    QVERIFY(pool.count() == 2);
+    QVERIFY(pool.tryTake(entry));
+    QVERIFY(entry.salt.size() == Crypter::SaltSize);
+    SecureByteArray key;
+    SecureByteArray IV;
+    Crypter::makeKeyAndIVFromPassword(masterPassword, entry.salt, key, IV);
+    QVERIFY(entry.key == key);
+    QVERIFY(entry.IV == IV);
+    const SaltKeyIVPool::Entry &entry2 = pool.take();
+    QVERIFY(entry2.isValid());
+    QVERIFY(entry2.salt != entry.salt);
+    pool.clear();
+    pool.waitForFinished();
+    QVERIFY(pool.count() == 0);
+    QVERIFY(!pool.take().isValid());
+  }
+
+  void crypter_stream_encode_decode(void)
+  {
+    SecureByteArray masterPassword = QString("7h15p455w0rd15m0r37h4n53cr37").toUtf8();
+    QByteArray salt = Crypter::generateSalt();
+    SecureByteArray key;
+    SecureByteArray IV;
+    Crypter::makeKeyAndIVFromPassword(masterPassword, salt, key, IV);
+    SecureByteArray KGK = Crypter::generateKGK();
+    QByteArray data;
+    for (int i = 0; i < 50000; ++i) {
+      data.append(QByteArray::number(i * 7919)).append(i % 3 == 0 ? Crypter::randomBytes(8) : QByteArray(",\n"));
+    }
+
+    QBuffer in(&data);
+    QVERIFY(in.open(QIODevice::ReadOnly));
+    QTemporaryFile cipherFile;
+    QVERIFY(cipherFile.open());
+    QVERIFY(Crypter::encode(key, IV, salt, KGK, &in, &cipherFile, true));
+    QVERIFY(cipherFile.seek(0));
+    QByteArray plain;
+    QBuffer out(&plain);
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    SecureByteArray KGK2;
+    QVERIFY(Crypter::decode(masterPassword, &cipherFile, &out, true, KGK2));
+    QVERIFY(plain == data);
+    QVERIFY(KGK2 == KGK);
+
+    const QByteArray &cipher = Crypter::encode(key, IV, salt, KGK, data, true);
+    QVERIFY(qUncompress(Crypter::decode(masterPassword, cipher, false, KGK2)) == data);
+
+    const QByteArray salt2 = Crypter::generateSalt();
+    const SecureByteArray IV2 = Crypter::generateIV();
+    const QByteArray &legacyCipher = QByteArray(1, static_cast<char>(Crypter::AES256EncryptedMasterkeyFormat))
+        + salt
+        + Crypter::encrypt(key, IV, salt2 + IV2 + KGK, CryptoPP::StreamTransformationFilter::NO_PADDING)
+        + Crypter::encrypt(Crypter::makeKeyFromPassword(KGK, salt2), IV2, qCompress(data, 9), CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+    QVERIFY(Crypter::decode(masterPassword, legacyCipher, true, KGK2) == data);
+  }
+
   void export_import(void)
   {
     QString filename = QDir::tempPath() + "/qt-sesam-unit-test.pem";
@@ -1,5 +0,0 @@
-INCLUDEPATH += $$PWD
-
-SOURCES += $$PWD/bigInt.cpp
-
-HEADERS += $$PWD/bigInt.h
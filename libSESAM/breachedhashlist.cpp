@@ -0,0 +1,354 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "breachedhashlist.h"
+
+#include <QFile>
+#include <QVector>
+#include <QCryptographicHash>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+  /* File layout (all integers little endian):
+   *   header    magic[8], quint32 version, quint32 record size,
+   *             quint64 record count, quint64 reserved
+   *   fan-out   quint64[FanOutSize + 1], index of the first record per
+   *             two-byte hash prefix; the last entry equals the record count
+   *   records   SHA-1 hash[20], quint32 breach count
+   */
+  const char Magic[8] = { 'S', 'E', 'S', 'A', 'M', 'S', 'H', '1' };
+  const quint32 Version = 1;
+  const int HeaderSize = 32;
+  const int RecordSize = BreachedHashList::HashSize + 4;
+  const qint64 FanOutBytes = (BreachedHashList::FanOutSize + 1) * 8;
+  const qint64 RecordsOffset = HeaderSize + FanOutBytes;
+  // half the number of records probed around the interpolated position
+  const quint64 InterpolationWindow = 64;
+
+  inline int prefixOf(const uchar *hash)
+  {
+    return (int(hash[0]) << 8) | int(hash[1]);
+  }
+
+}
+
+
+class BreachedHashListPrivate
+{
+public:
+  BreachedHashListPrivate(void)
+    : records(Q_NULLPTR)
+    , count(0)
+  { /* ... */ }
+  ~BreachedHashListPrivate()
+  { /* ... */ }
+  inline const uchar *record(quint64 i) const
+  {
+    return records + i * RecordSize;
+  }
+  inline int compare(quint64 i, const uchar *hash) const
+  {
+    return memcmp(record(i), hash, BreachedHashList::HashSize);
+  }
+  QFile file;
+  const uchar *records;
+  quint64 count;
+  QVector<quint64> fanOut;
+  QString errorString;
+};
+
+
+BreachedHashList::BreachedHashList(void)
+  : d_ptr(new BreachedHashListPrivate)
+{ /* ... */ }
+
+
+BreachedHashList::~BreachedHashList()
+{
+  close();
+}
+
+
+QByteArray BreachedHashList::hash(const QString &password)
+{
+  return QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha1);
+}
+
+
+bool BreachedHashList::isHashListFile(const QString &filename)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  return file.read(sizeof(Magic)) == QByteArray(Magic, sizeof(Magic));
+}
+
+
+bool BreachedHashList::open(const QString &filename)
+{
+  Q_D(BreachedHashList);
+  close();
+  d->file.setFileName(filename);
+  if (!d->file.open(QIODevice::ReadOnly)) {
+    d->errorString = d->file.errorString();
+    return false;
+  }
+  const qint64 size = d->file.size();
+  const uchar *data = size >= RecordsOffset ? d->file.map(0, size) : Q_NULLPTR;
+  if (data == Q_NULLPTR || memcmp(data, Magic, sizeof(Magic)) != 0) {
+    d->errorString = "not a breached hash list";
+    close();
+    return false;
+  }
+  const quint32 version = qFromLittleEndian<quint32>(data + 8);
+  const quint32 recordSize = qFromLittleEndian<quint32>(data + 12);
+  const quint64 count = qFromLittleEndian<quint64>(data + 16);
+  bool valid = version == Version
+      && recordSize == quint32(RecordSize)
+      && count <= quint64(size - RecordsOffset) / RecordSize
+      && quint64(size) == quint64(RecordsOffset) + count * RecordSize;
+  d->fanOut.resize(FanOutSize + 1);
+  quint64 previous = 0;
+  for (int i = 0; valid && i <= FanOutSize; ++i) {
+    const quint64 first = qFromLittleEndian<quint64>(data + HeaderSize + i * 8);
+    valid = first >= previous && first <= count;
+    d->fanOut[i] = first;
+    previous = first;
+  }
+  if (!valid || d->fanOut.last() != count) {
+    d->errorString = "corrupt breached hash list";
+    close();
+    return false;
+  }
+  d->records = data + RecordsOffset;
+  d->count = count;
+  return true;
+}
+
+
+void BreachedHashList::close(void)
+{
+  Q_D(BreachedHashList);
+  d->file.close();
+  d->records = Q_NULLPTR;
+  d->count = 0;
+  d->fanOut.clear();
+}
+
+
+bool BreachedHashList::isOpen(void) const
+{
+  return d_ptr->records != Q_NULLPTR;
+}
+
+
+QString BreachedHashList::errorString(void) const
+{
+  return d_ptr->errorString;
+}
+
+
+quint64 BreachedHashList::count(void) const
+{
+  return d_ptr->count;
+}
+
+
+bool BreachedHashList::contains(const QString &password) const
+{
+  return find(password) >= 0;
+}
+
+
+/*!
+ * \brief BreachedHashList::find
+ *
+ * Looks up the SHA-1 hash of `password`. If it is listed and `breachCount`
+ * is not null, the number of breaches it has been seen in is stored there.
+ *
+ * \return Index of the record, or -1 if the password isn't listed.
+ */
+qint64 BreachedHashList::find(const QString &password, quint32 *breachCount) const
+{
+  return findHash(hash(password), breachCount);
+}
+
+
+qint64 BreachedHashList::findHash(const QByteArray &sha1, quint32 *breachCount) const
+{
+  Q_D(const BreachedHashList);
+  if (!isOpen() || sha1.size() != HashSize)
+    return -1;
+  const uchar *h = reinterpret_cast<const uchar *>(sha1.constData());
+  const int prefix = prefixOf(h);
+  quint64 lo = d->fanOut.at(prefix);
+  quint64 hi = d->fanOut.at(prefix + 1);
+  if (lo >= hi)
+    return -1;
+  // the bytes following the prefix are uniformly distributed, so they tell
+  // where in the bucket the hash should be
+  const quint64 n = hi - lo;
+  const quint64 guess = lo + ((n * quint64(qFromBigEndian<quint32>(h + 2))) >> 32);
+  quint64 wlo = guess > lo + InterpolationWindow ? guess - InterpolationWindow : lo;
+  quint64 whi = qMin(hi, guess + InterpolationWindow + 1);
+  if (wlo > lo && d->compare(wlo, h) > 0) {
+    whi = wlo;
+    wlo = lo;
+  }
+  else if (whi < hi && d->compare(whi - 1, h) < 0) {
+    wlo = whi;
+    whi = hi;
+  }
+  while (wlo < whi) {
+    const quint64 mid = wlo + (whi - wlo) / 2;
+    const int comparison = d->compare(mid, h);
+    if (comparison < 0) {
+      wlo = mid + 1;
+    }
+    else if (comparison > 0) {
+      whi = mid;
+    }
+    else {
+      if (breachCount != Q_NULLPTR) {
+        *breachCount = qFromLittleEndian<quint32>(d->record(mid) + HashSize);
+      }
+      return qint64(mid);
+    }
+  }
+  return -1;
+}
+
+
+class BreachedHashListBuilderPrivate
+{
+public:
+  BreachedHashListBuilderPrivate(QIODevice *device)
+    : device(device)
+    , headerPos(0)
+    , count(0)
+    , bucketSizes(BreachedHashList::FanOutSize, 0)
+    , ok(true)
+  { /* ... */ }
+  ~BreachedHashListBuilderPrivate()
+  { /* ... */ }
+  bool write(const char *data, qint64 size)
+  {
+    if (ok && device->write(data, size) != size) {
+      errorString = device->errorString();
+      ok = false;
+    }
+    return ok;
+  }
+  QIODevice *device;
+  qint64 headerPos;
+  quint64 count;
+  QVector<quint64> bucketSizes;
+  QByteArray previous;
+  QString errorString;
+  bool ok;
+};
+
+
+BreachedHashListBuilder::BreachedHashListBuilder(QIODevice *device)
+  : d_ptr(new BreachedHashListBuilderPrivate(device))
+{
+  Q_D(BreachedHashListBuilder);
+  d->headerPos = d->device->pos();
+  const QByteArray placeholder(int(RecordsOffset), '\0');
+  d->write(placeholder.constData(), placeholder.size());
+}
+
+
+BreachedHashListBuilder::~BreachedHashListBuilder()
+{ /* ... */ }
+
+
+/*!
+ * \brief BreachedHashListBuilder::add
+ *
+ * Appends the binary SHA-1 hash `sha1` seen in `breachCount` breaches.
+ *
+ * \return `false` if `sha1` isn't greater than the previous hash or the
+ * record couldn't be written.
+ */
+bool BreachedHashListBuilder::add(const QByteArray &sha1, quint32 breachCount)
+{
+  Q_D(BreachedHashListBuilder);
+  if (!d->ok)
+    return false;
+  if (sha1.size() != BreachedHashList::HashSize) {
+    d->errorString = "hash must be 20 bytes long";
+    return false;
+  }
+  if (d->count > 0 && memcmp(sha1.constData(), d->previous.constData(), BreachedHashList::HashSize) <= 0) {
+    d->errorString = "hashes are not in strictly ascending order";
+    return false;
+  }
+  uchar le[4];
+  qToLittleEndian<quint32>(breachCount, le);
+  if (!d->write(sha1.constData(), sha1.size()) || !d->write(reinterpret_cast<const char *>(le), sizeof(le)))
+    return false;
+  ++d->bucketSizes[prefixOf(reinterpret_cast<const uchar *>(sha1.constData()))];
+  d->previous = sha1;
+  ++d->count;
+  return true;
+}
+
+
+bool BreachedHashListBuilder::finish(void)
+{
+  Q_D(BreachedHashListBuilder);
+  if (!d->ok)
+    return false;
+  QByteArray head(int(RecordsOffset), '\0');
+  uchar *p = reinterpret_cast<uchar *>(head.data());
+  memcpy(p, Magic, sizeof(Magic));
+  qToLittleEndian<quint32>(Version, p + 8);
+  qToLittleEndian<quint32>(quint32(RecordSize), p + 12);
+  qToLittleEndian<quint64>(d->count, p + 16);
+  quint64 first = 0;
+  for (int i = 0; i < BreachedHashList::FanOutSize; ++i) {
+    qToLittleEndian<quint64>(first, p + HeaderSize + i * 8);
+    first += d->bucketSizes.at(i);
+  }
+  qToLittleEndian<quint64>(first, p + HeaderSize + BreachedHashList::FanOutSize * 8);
+  const qint64 endPos = d->device->pos();
+  if (!d->device->seek(d->headerPos) || !d->write(head.constData(), head.size()) || !d->device->seek(endPos)) {
+    if (d->ok) {
+      d->errorString = d->device->errorString();
+      d->ok = false;
+    }
+  }
+  return d->ok;
+}
+
+
+quint64 BreachedHashListBuilder::count(void) const
+{
+  return d_ptr->count;
+}
+
+
+QString BreachedHashListBuilder::errorString(void) const
+{
+  return d_ptr->errorString;
+}
@@ -0,0 +1,102 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __BREACHEDHASHLIST_H_
+#define __BREACHEDHASHLIST_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QIODevice>
+#include <QScopedPointer>
+
+class BreachedHashListPrivate;
+class BreachedHashListBuilderPrivate;
+
+/*!
+ * \brief The BreachedHashList class
+ *
+ * Read-only access to a packed list of SHA-1 hashes of breached passwords,
+ * e.g. a local mirror of the "Pwned Passwords" range dumps, as written by
+ * `BreachedHashListBuilder`.
+ *
+ * The file holds fixed-size records (hash and breach count) sorted by
+ * hash, preceded by a fan-out table with the index of the first record for
+ * each of the 2^16 possible two-byte hash prefixes. The table narrows a
+ * lookup down to one bucket. As SHA-1 hashes are uniformly distributed,
+ * an interpolation step then guesses the position within the bucket,
+ * so a lookup usually touches a single page of records.
+ *
+ * The hashes are calculated over the UTF-8 encoded password, so lookups
+ * are case-sensitive. `find()` may be called from several threads at once.
+ */
+class BreachedHashList
+{
+public:
+  BreachedHashList(void);
+  ~BreachedHashList();
+
+  static const int HashSize = 20;
+  static const int FanOutSize = 65536;
+
+  bool open(const QString &filename);
+  void close(void);
+  bool isOpen(void) const;
+  QString errorString(void) const;
+  quint64 count(void) const;
+
+  qint64 find(const QString &password, quint32 *breachCount = Q_NULLPTR) const;
+  qint64 findHash(const QByteArray &sha1, quint32 *breachCount = Q_NULLPTR) const;
+  bool contains(const QString &password) const;
+
+  static QByteArray hash(const QString &password);
+  static bool isHashListFile(const QString &filename);
+
+private:
+  QScopedPointer<BreachedHashListPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(BreachedHashList)
+  Q_DISABLE_COPY(BreachedHashList)
+};
+
+
+/*!
+ * \brief The BreachedHashListBuilder class
+ *
+ * Writes a `BreachedHashList` to a seekable `QIODevice`. Hashes must be
+ * added in ascending order; `finish()` fills in header and fan-out table.
+ */
+class BreachedHashListBuilder
+{
+public:
+  explicit BreachedHashListBuilder(QIODevice *device);
+  ~BreachedHashListBuilder();
+
+  bool add(const QByteArray &sha1, quint32 breachCount);
+  bool finish(void);
+  quint64 count(void) const;
+  QString errorString(void) const;
+
+private:
+  QScopedPointer<BreachedHashListBuilderPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(BreachedHashListBuilder)
+  Q_DISABLE_COPY(BreachedHashListBuilder)
+};
+
+
+#endif // __BREACHEDHASHLIST_H_
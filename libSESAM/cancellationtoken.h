@@ -0,0 +1,62 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CANCELLATIONTOKEN_H_
+#define __CANCELLATIONTOKEN_H_
+
+#include <QtGlobal>
+#include <QAtomicInt>
+
+
+/*!
+ * \brief The CancellationToken class
+ *
+ * A flag one thread raises to ask long-running work in another thread
+ * to stop. Reading it is a single atomic load, so workers can poll it
+ * from their inner loops without taking a lock.
+ */
+class CancellationToken
+{
+public:
+  CancellationToken(void)
+    : mCancelled(0)
+  { /* ... */ }
+
+  void cancel(void)
+  {
+    mCancelled.storeRelease(1);
+  }
+
+  void reset(void)
+  {
+    mCancelled.storeRelease(0);
+  }
+
+  bool isCancelled(void) const
+  {
+    return mCancelled.loadAcquire() != 0;
+  }
+
+private:
+  QAtomicInt mCancelled;
+  Q_DISABLE_COPY(CancellationToken)
+};
+
+
+#endif // __CANCELLATIONTOKEN_H_
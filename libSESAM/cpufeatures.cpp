@@ -0,0 +1,152 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "cpufeatures.h"
+
+#if defined(SESAM_X86_SIMD)
+#if defined(Q_CC_MSVC)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+#if defined(SESAM_X86_SIMD)
+static void cpuid(quint32 leaf, quint32 subleaf, quint32 reg[4])
+{
+#if defined(Q_CC_MSVC)
+  int r[4];
+  __cpuidex(r, int(leaf), int(subleaf));
+  for (int i = 0; i < 4; ++i)
+    reg[i] = quint32(r[i]);
+#else
+  __cpuid_count(leaf, subleaf, reg[0], reg[1], reg[2], reg[3]);
+#endif
+}
+
+
+static quint64 xgetbv(void)
+{
+#if defined(Q_CC_MSVC)
+  return _xgetbv(0);
+#else
+  quint32 eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (quint64(edx) << 32) | eax;
+#endif
+}
+
+
+static int detectFeatures(void)
+{
+  enum { EAX, EBX, ECX, EDX };
+  int features = 0;
+  quint32 reg[4];
+  cpuid(0, 0, reg);
+  const quint32 maxLeaf = reg[EAX];
+  if (maxLeaf < 1)
+    return features;
+  cpuid(1, 0, reg);
+  if (reg[EDX] & (1U << 26))
+    features |= CPUFeatures::SSE2;
+  if (reg[ECX] & (1U << 9))
+    features |= CPUFeatures::SSSE3;
+  if (reg[ECX] & (1U << 19))
+    features |= CPUFeatures::SSE41;
+  if (reg[ECX] & (1U << 20))
+    features |= CPUFeatures::SSE42;
+  if (reg[ECX] & (1U << 25))
+    features |= CPUFeatures::AESNI;
+  const bool osxsave = (reg[ECX] & (1U << 27)) != 0;
+  const bool avx = (reg[ECX] & (1U << 28)) != 0;
+  quint64 xcr0 = 0;
+  if (osxsave) {
+    xcr0 = xgetbv();
+  }
+  const bool ymmEnabled = (xcr0 & 0x06) == 0x06;
+  const bool zmmEnabled = (xcr0 & 0xe6) == 0xe6;
+  if (avx && ymmEnabled)
+    features |= CPUFeatures::AVX;
+  if (maxLeaf >= 7) {
+    cpuid(7, 0, reg);
+    if ((reg[EBX] & (1U << 5)) && ymmEnabled)
+      features |= CPUFeatures::AVX2;
+    if ((reg[EBX] & (1U << 16)) && zmmEnabled)
+      features |= CPUFeatures::AVX512F;
+    if (reg[EBX] & (1U << 29))
+      features |= CPUFeatures::SHA;
+  }
+  return features;
+}
+#else
+static int detectFeatures(void)
+{
+  return 0;
+}
+#endif
+
+
+/*!
+ * \brief CPUFeatures::flags
+ *
+ * \return Bitwise OR of the `CPUFeatures::Feature` values supported by this machine.
+ */
+int CPUFeatures::flags(void)
+{
+  static const int features = detectFeatures();
+  return features;
+}
+
+
+bool CPUFeatures::has(CPUFeatures::Feature feature)
+{
+  return (flags() & feature) == feature;
+}
+
+
+/*!
+ * \brief CPUFeatures::names
+ *
+ * \return Names of the detected features, e.g. for logging.
+ */
+QStringList CPUFeatures::names(void)
+{
+  static const struct {
+    Feature feature;
+    const char *name;
+  } Names[] = {
+    { SSE2, "SSE2" },
+    { SSSE3, "SSSE3" },
+    { SSE41, "SSE4.1" },
+    { SSE42, "SSE4.2" },
+    { AVX, "AVX" },
+    { AVX2, "AVX2" },
+    { AVX512F, "AVX-512F" },
+    { SHA, "SHA-NI" },
+    { AESNI, "AES-NI" }
+  };
+  QStringList result;
+  for (size_t i = 0; i < sizeof(Names) / sizeof(Names[0]); ++i) {
+    if (has(Names[i].feature)) {
+      result << Names[i].name;
+    }
+  }
+  return result;
+}
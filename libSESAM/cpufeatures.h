@@ -0,0 +1,65 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CPUFEATURES_H_
+#define __CPUFEATURES_H_
+
+#include <QtGlobal>
+#include <QStringList>
+
+#if defined(Q_PROCESSOR_X86) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG) || defined(Q_CC_MSVC))
+#define SESAM_X86_SIMD 1
+#endif
+
+#if defined(SESAM_X86_SIMD) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG))
+#define SESAM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SESAM_TARGET(isa)
+#endif
+
+
+/*!
+ * \brief The CPUFeatures class
+ *
+ * Runtime detection of the instruction set extensions the SIMD kernels in
+ * libSESAM depend on. AVX and AVX-512 are only reported if the operating
+ * system saves the respective register state on context switches.
+ */
+class CPUFeatures
+{
+public:
+  enum Feature {
+    SSE2 = 0x0001,
+    SSSE3 = 0x0002,
+    SSE41 = 0x0004,
+    SSE42 = 0x0008,
+    AVX = 0x0010,
+    AVX2 = 0x0020,
+    AVX512F = 0x0040,
+    SHA = 0x0080,
+    AESNI = 0x0100
+  };
+
+  static bool has(Feature feature);
+  static int flags(void);
+  static QStringList names(void);
+};
+
+
+#endif // __CPUFEATURES_H_
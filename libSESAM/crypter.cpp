@@ -18,11 +18,18 @@
 */
 
 #include <QDebug>
+#include <QBuffer>
+#include <QScopedPointer>
+#include <QMessageAuthenticationCode>
+#include <QMutex>
+#include <QMutexLocker>
 #include "sha.h"
 #include "ccm.h"
 #include "misc.h"
+#include "zlib.h"
 #include "securebytearray.h"
 #include "pbkdf2.h"
+#include "derivedkeycache.h"
 #include "crypter.h"
 #include "util.h"
 
@@ -34,6 +41,46 @@ const int Crypter::KGKIterations = 1024;
 const int Crypter::KGKSize = 64;
 const int Crypter::AESBlockSize = CryptoPP::AES::BLOCKSIZE;
 const int Crypter::CryptDataSize = Crypter::SaltSize + Crypter::AESBlockSize + Crypter::KGKSize;
+const int Crypter::KeyCacheCapacity = 16;
+const int Crypter::StreamBufferSize = 64 * 1024;
+const int Crypter::HeaderSize = 1 + Crypter::SaltSize + Crypter::CryptDataSize;
+
+
+namespace {
+
+  /*!
+   * \brief The IODeviceSink class
+   *
+   * Crypto++ sink that writes everything it receives to a `QIODevice`.
+   * After a failed write all further input is dropped and `ok()` returns `false`.
+   */
+  class IODeviceSink : public CryptoPP::Bufferless<CryptoPP::Sink>
+  {
+  public:
+    IODeviceSink(QIODevice *device)
+      : mDevice(device)
+      , mOk(true)
+    { /* ... */ }
+    size_t Put2(const byte *begin, size_t length, int messageEnd, bool blocking)
+    {
+      (void)messageEnd;
+      (void)blocking;
+      if (mOk && length > 0) {
+        mOk = mDevice->write(reinterpret_cast<const char*>(begin), qint64(length)) == qint64(length);
+      }
+      return 0;
+    }
+    bool ok(void) const
+    {
+      return mOk;
+    }
+
+  private:
+    QIODevice *mDevice;
+    bool mOk;
+  };
+
+}
 
 
 #ifdef Q_OS_WIN
@@ -116,46 +163,180 @@ QByteArray Crypter::encode(const SecureByteArray &key,
                            const SecureByteArray &KGK,
                            const QByteArray &data,
                            bool compress)
+{
+  QByteArray cipher;
+  if (!compress) {
+    cipher.reserve(HeaderSize + data.size() + AESBlockSize);
+  }
+  QBuffer in;
+  in.setData(data);
+  in.open(QIODevice::ReadOnly);
+  QBuffer out(&cipher);
+  out.open(QIODevice::WriteOnly);
+  encode(key, IV, salt, KGK, &in, &out, compress);
+  return cipher;
+}
+
+
+/*!
+ * \brief Crypter::encode
+ *
+ * Streaming variant of `encode()`: reads the data to be encrypted from `in`
+ * until its end and writes the result in the same format to `out`.
+ * Compression, encryption and output are chained Crypto++ filters, so
+ * only a buffer of `StreamBufferSize` bytes is held at a time.
+ *
+ * If `compress` is `true`, the plaintext is laid out like the output of
+ * `qCompress()`, i.e. prefixed with its uncompressed size. For sequential
+ * devices that size is unknown and 0 is written instead, which
+ * `qUncompress()` and `decode()` accept as well.
+ *
+ * \return `false` if reading from `in` or writing to `out` failed.
+ */
+bool Crypter::encode(const SecureByteArray &key,
+                     const SecureByteArray &IV,
+                     const QByteArray &salt,
+                     const SecureByteArray &KGK,
+                     QIODevice *in,
+                     QIODevice *out,
+                     bool compress)
 {
   const QByteArray &salt2 = generateSalt();
   const SecureByteArray &IV2 = generateIV();
   const SecureByteArray &KGK2 = salt2 + IV2 + KGK;
   const QByteArray &encryptedKGK = encrypt(key, IV, KGK2, CryptoPP::StreamTransformationFilter::NO_PADDING);
   const SecureByteArray &blobKey = Crypter::makeKeyFromPassword(KGK, salt2);
-  const SecureByteArray &baPlain = compress ? qCompress(data, 9) : data;
-  const QByteArray &baCipher = encrypt(blobKey, IV2, baPlain, CryptoPP::StreamTransformationFilter::PKCS_PADDING);
   const QByteArray formatFlag(int(1), static_cast<char>(AES256EncryptedMasterkeyFormat));
-  return formatFlag + salt + encryptedKGK + baCipher;
+  if (out->write(formatFlag + salt + encryptedKGK) != HeaderSize)
+    return false;
+
+  CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption enc;
+  enc.SetKeyWithIV(reinterpret_cast<const byte*>(blobKey.constData()), blobKey.size(), reinterpret_cast<const byte*>(IV2.constData()));
+  IODeviceSink *sink = new IODeviceSink(out);
+  CryptoPP::StreamTransformationFilter *encryptor =
+      new CryptoPP::StreamTransformationFilter(enc, sink, CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+  QScopedPointer<CryptoPP::BufferedTransformation> pipeline;
+  if (compress) {
+    const quint32 size = in->isSequential() ? 0 : quint32(in->size() - in->pos());
+    const byte sizeBigEndian[4] = { byte(size >> 24), byte(size >> 16), byte(size >> 8), byte(size) };
+    encryptor->Put(sizeBigEndian, sizeof(sizeBigEndian));
+    pipeline.reset(new CryptoPP::ZlibCompressor(encryptor, CryptoPP::Deflator::MAX_DEFLATE_LEVEL));
+  }
+  else {
+    pipeline.reset(encryptor);
+  }
+  const bool ok = pump(in, pipeline.data());
+  return ok && sink->ok();
 }
 
+
 /*!
  * \brief Crypter::decode
  * \param masterPassword The user's master password.
  * \param cipher The data to be decrypted.
  * \param uncompress If `true`, data will be uncompressed after encryption.
  * \param KGK Key generation key. A randomly generated byte sequence of `Crypter::AESKeySize` length.
+ * \param pbkdf2 Optional `PBKDF2` object to run the key derivations on, e.g. to receive progress or to be able to cancel them.
  * \return The decrypted payload (without format flag and other header data) contained in `cipher`.
  */
 QByteArray Crypter::decode(const SecureByteArray &masterPassword,
                            QByteArray cipher,
                            bool uncompress,
-                           SecureByteArray &KGK)
+                           SecureByteArray &KGK,
+                           PBKDF2 *pbkdf2)
 {
   Q_ASSERT_X(!masterPassword.isEmpty(), "Crypter::decode()", "masterPassword must not be empty");
-  FormatFlags formatFlag = static_cast<FormatFlags>(cipher.at(0));
-  if (formatFlag != AES256EncryptedMasterkeyFormat)
+  QBuffer in;
+  in.setData(cipher);
+  cipher.clear();
+  in.open(QIODevice::ReadOnly);
+  QByteArray plain;
+  QBuffer out(&plain);
+  out.open(QIODevice::WriteOnly);
+  if (!decode(masterPassword, &in, &out, uncompress, KGK, pbkdf2))
     return QByteArray();
-  const QByteArray &salt = QByteArray(cipher.constData() + sizeof(char), SaltSize);
-  const SecureByteArray &encryptedKGK = SecureByteArray(cipher.constData() + sizeof(char) + SaltSize, CryptDataSize);
-  SecureByteArray key, IV;
-  Crypter::makeKeyAndIVFromPassword(masterPassword, salt, key, IV);
+  return plain;
+}
+
+
+/*!
+ * \brief Crypter::decode
+ *
+ * Streaming variant of `decode()`: reads a block produced by `encode()`
+ * from `in` and writes the decrypted (and, if `uncompress` is `true`,
+ * uncompressed) payload to `out`, holding only a buffer of
+ * `StreamBufferSize` bytes at a time.
+ *
+ * \return `false` if `in` doesn't start with a valid header, if reading
+ * from `in` or writing to `out` failed or if the key derivation has been aborted.
+ * \throw CryptoPP::Exception if the data cannot be decrypted or uncompressed.
+ */
+bool Crypter::decode(const SecureByteArray &masterPassword,
+                     QIODevice *in,
+                     QIODevice *out,
+                     bool uncompress,
+                     SecureByteArray &KGK,
+                     PBKDF2 *pbkdf2)
+{
+  Q_ASSERT_X(!masterPassword.isEmpty(), "Crypter::decode()", "masterPassword must not be empty");
+  const QByteArray &header = in->read(HeaderSize);
+  if (header.size() != HeaderSize)
+    return false;
+  FormatFlags formatFlag = static_cast<FormatFlags>(header.at(0));
+  if (formatFlag != AES256EncryptedMasterkeyFormat)
+    return false;
+  const QByteArray &salt = header.mid(sizeof(char), SaltSize);
+  const SecureByteArray &encryptedKGK = header.mid(sizeof(char) + SaltSize, CryptDataSize);
+  SecureByteArray hash;
+  if (!deriveKey(masterPassword, salt, DomainIterations, QCryptographicHash::Sha384, hash, pbkdf2))
+    return false;
+  const SecureByteArray key = hash.mid(0, AESKeySize);
+  const SecureByteArray IV = hash.mid(AESKeySize, AESBlockSize);
   QByteArray baKGK = decrypt(key, IV, encryptedKGK, CryptoPP::StreamTransformationFilter::NO_PADDING);
   const QByteArray salt2(baKGK.constData(), SaltSize);
   const SecureByteArray IV2(baKGK.constData() + SaltSize, AESBlockSize);
   KGK = SecureByteArray(baKGK.constData() + SaltSize + AESBlockSize, KGKSize);
-  const SecureByteArray &blobKey = Crypter::makeKeyFromPassword(KGK, salt2);
-  const QByteArray &plain = decrypt(blobKey, IV2, cipher.mid(+ sizeof(char) + SaltSize + CryptDataSize), CryptoPP::StreamTransformationFilter::PKCS_PADDING);
-  return uncompress ? qUncompress(plain) : plain;
+  SecureByteArray blobKey;
+  if (!deriveKey(KGK, salt2, KGKIterations, QCryptographicHash::Sha256, blobKey, pbkdf2))
+    return false;
+  blobKey.resize(AESKeySize);
+
+  CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption dec;
+  dec.SetKeyWithIV(reinterpret_cast<const byte*>(blobKey.constData()), blobKey.size(), reinterpret_cast<const byte*>(IV2.constData()));
+  IODeviceSink *sink = new IODeviceSink(out);
+  CryptoPP::BufferedTransformation *plainSink = sink;
+  if (uncompress) {
+    CryptoPP::MeterFilter *sizeSkipper = new CryptoPP::MeterFilter(new CryptoPP::ZlibDecompressor(sink));
+    sizeSkipper->AddRangeToSkip(0, 0, 4, true);
+    plainSink = sizeSkipper;
+  }
+  CryptoPP::StreamTransformationFilter decryptor(dec, plainSink, CryptoPP::StreamTransformationFilter::PKCS_PADDING);
+  const bool ok = pump(in, &decryptor);
+  return ok && sink->ok();
+}
+
+
+/*!
+ * \brief Crypter::pump
+ *
+ * Feeds everything that can be read from `in` into `pipeline`
+ * in chunks of `StreamBufferSize` bytes and signals the end of the message.
+ *
+ * \return `false` if reading from `in` failed.
+ */
+bool Crypter::pump(QIODevice *in, CryptoPP::BufferedTransformation *pipeline)
+{
+  SecureByteArray buf(StreamBufferSize, static_cast<char>(0));
+  forever {
+    const qint64 n = in->read(buf.data(), buf.size());
+    if (n < 0)
+      return false;
+    if (n == 0)
+      break;
+    pipeline->Put(reinterpret_cast<const byte*>(buf.constData()), size_t(n));
+  }
+  pipeline->MessageEnd();
+  return true;
 }
 
 
@@ -326,12 +507,14 @@ SecureByteArray Crypter::generateIV(void)
  *
  * \param masterKey The master key from which PBKDF2 should generate the key.
  * \param salt A salt used for PBKDF2.
+ * \param pbkdf2 Optional `PBKDF2` object to run the derivation on. If `Q_NULLPTR`, a temporary one is used.
  * \return A `SecureByteArray` containing a `AESKeySize` long SHA-256 hash generated via PBKDF2 parametrized with `masterKey`, `salt` and `KGKIterations`.
  */
-SecureByteArray Crypter::makeKeyFromPassword(const SecureByteArray &masterKey, const QByteArray &salt)
+SecureByteArray Crypter::makeKeyFromPassword(const SecureByteArray &masterKey, const QByteArray &salt, PBKDF2 *pbkdf2)
 {
-  PBKDF2 pbkdf2(masterKey, salt, KGKIterations, QCryptographicHash::Sha256);
-  return pbkdf2.derivedKey(AESKeySize);
+  SecureByteArray derivedKey;
+  deriveKey(masterKey, salt, KGKIterations, QCryptographicHash::Sha256, derivedKey, pbkdf2);
+  return derivedKey.left(AESKeySize);
 }
 
 
@@ -345,13 +528,113 @@ SecureByteArray Crypter::makeKeyFromPassword(const SecureByteArray &masterKey, c
  * \param salt A salt used for PBKDF2.
  * \param key A reference to a `SecureByteArray` object to which the generated key should be assigned.
  * \param IV A reference to a `SecureByteArray` object to which the generated IV should be assigned.
+ * \param pbkdf2 Optional `PBKDF2` object to run the derivation on. If `Q_NULLPTR`, a temporary one is used.
  */
-void Crypter::makeKeyAndIVFromPassword(const SecureByteArray &masterPassword, const QByteArray &salt, SecureByteArray &key, SecureByteArray &IV)
+void Crypter::makeKeyAndIVFromPassword(const SecureByteArray &masterPassword, const QByteArray &salt, SecureByteArray &key, SecureByteArray &IV, PBKDF2 *pbkdf2)
 {
 //  qDebug() << "Crypter::makeKeyAndIVFromPassword(" << masterPassword << ")";
   Q_ASSERT_X(!masterPassword.isEmpty(), "Crypter::makeKeyAndIVFromPassword()", "masterPassword must not be empty");
-  PBKDF2 pbkdf2(masterPassword, salt, DomainIterations, QCryptographicHash::Sha384);
-  const SecureByteArray &hash = pbkdf2.derivedKey();
+  SecureByteArray hash;
+  deriveKey(masterPassword, salt, DomainIterations, QCryptographicHash::Sha384, hash, pbkdf2);
   key = hash.mid(0, AESKeySize);
   IV = hash.mid(AESKeySize, AESBlockSize);
 }
+
+
+/*!
+ * \brief The SessionKeyCache class
+ *
+ * Derived keys of the current session, looked up by an HMAC of the
+ * derivation inputs under a random key that is replaced on every
+ * `clear()`. Without that key a fingerprint is useless for testing
+ * password guesses.
+ */
+class SessionKeyCache
+{
+public:
+  SessionKeyCache(void)
+    : cache(Crypter::KeyCacheCapacity)
+    , macKey(Crypter::randomBytes(MacKeySize))
+  { /* ... */ }
+  QByteArray fingerprint(const SecureByteArray &pwd, const QByteArray &salt, int iterations, QCryptographicHash::Algorithm algorithm)
+  {
+    QMutexLocker locker(&mutex);
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, macKey);
+    mac.addData(QByteArray::number(iterations) + ':' + QByteArray::number(int(algorithm)) + ':');
+    mac.addData(QByteArray::number(pwd.size()) + ':');
+    mac.addData(pwd);
+    mac.addData(salt);
+    return mac.result();
+  }
+  void clear(void)
+  {
+    QMutexLocker locker(&mutex);
+    cache.clear();
+    macKey.invalidate();
+    macKey = Crypter::randomBytes(MacKeySize);
+  }
+  static const int MacKeySize = 32;
+  DerivedKeyCache cache;
+
+private:
+  SecureByteArray macKey;
+  QMutex mutex;
+};
+
+
+const int SessionKeyCache::MacKeySize;
+
+
+static SessionKeyCache &sessionKeyCache(void)
+{
+  static SessionKeyCache cache;
+  return cache;
+}
+
+
+/*!
+ * \brief Crypter::deriveKey
+ *
+ * Runs PBKDF2 over `pwd` and `salt`, unless the session key cache
+ * already holds the result for the very same inputs.
+ *
+ * \param derivedKey Receives the full-length derived key.
+ * \param pbkdf2 Optional `PBKDF2` object to run the derivation on. If `Q_NULLPTR`, a temporary one is used.
+ * \return `false` if the derivation has been aborted.
+ */
+bool Crypter::deriveKey(const SecureByteArray &pwd, const QByteArray &salt, int iterations, QCryptographicHash::Algorithm algorithm, SecureByteArray &derivedKey, PBKDF2 *pbkdf2)
+{
+  const quint64 generation = sessionKeyCache().cache.generation();
+  SecureByteArray fingerprint = sessionKeyCache().fingerprint(pwd, salt, iterations, algorithm);
+  if (sessionKeyCache().cache.lookup(fingerprint, derivedKey))
+    return true;
+  PBKDF2 localPbkdf2;
+  if (pbkdf2 == Q_NULLPTR) {
+    pbkdf2 = &localPbkdf2;
+  }
+  pbkdf2->generate(pwd, salt, iterations, algorithm);
+  if (pbkdf2->isAborted())
+    return false;
+  derivedKey = pbkdf2->derivedKey();
+  // Don't resurrect key material if clearKeyCache() ran during the derivation.
+  sessionKeyCache().cache.insert(fingerprint, derivedKey, generation);
+  return true;
+}
+
+
+/*!
+ * \brief Crypter::clearKeyCache
+ *
+ * Wipes all keys and IVs `Crypter` has derived in this session and
+ * replaces the key their fingerprints are computed with. Call it
+ * when the master password is invalidated or changed.
+ *
+ * Until then `decode()` and the `makeKey...()` functions look up their
+ * PBKDF2 results in a small cache kept in secure memory, so that
+ * decrypting another blob with an already seen salt skips the expensive
+ * key derivation.
+ */
+void Crypter::clearKeyCache(void)
+{
+  sessionKeyCache().clear();
+}
@@ -23,6 +23,8 @@
 
 #include <QByteArray>
 #include <QString>
+#include <QCryptographicHash>
+#include <QIODevice>
 
 #include "securebytearray.h"
 #include "util.h"
@@ -31,6 +33,8 @@
 
 #include <random>
 
+class PBKDF2;
+
 class Crypter
 {
 public:
@@ -38,14 +42,19 @@ public:
   static const int AESKeySize;
   static const int AESBlockSize;
   static const int SaltSize;
+  static const int KeyCacheCapacity;
+  static const int StreamBufferSize;
   enum FormatFlags {
     ObsoleteDefaultEncryptionFormat = 0x00,
     AES256EncryptedMasterkeyFormat = 0x01
   };
-  static SecureByteArray makeKeyFromPassword(const SecureByteArray &masterPassword, const QByteArray &salt);
-  static void makeKeyAndIVFromPassword(const SecureByteArray &masterPassword, const QByteArray &salt, SecureByteArray &key, SecureByteArray &IV);
+  static SecureByteArray makeKeyFromPassword(const SecureByteArray &masterPassword, const QByteArray &salt, PBKDF2 *pbkdf2 = Q_NULLPTR);
+  static void makeKeyAndIVFromPassword(const SecureByteArray &masterPassword, const QByteArray &salt, SecureByteArray &key, SecureByteArray &IV, PBKDF2 *pbkdf2 = Q_NULLPTR);
   static QByteArray encode(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &salt, const SecureByteArray &KGK, const QByteArray &data, bool compress);
-  static QByteArray decode(const SecureByteArray &masterPassword, QByteArray cipher, bool uncompress, SecureByteArray &KGK);
+  static QByteArray decode(const SecureByteArray &masterPassword, QByteArray cipher, bool uncompress, SecureByteArray &KGK, PBKDF2 *pbkdf2 = Q_NULLPTR);
+  static bool encode(const SecureByteArray &key, const SecureByteArray &IV, const QByteArray &salt, const SecureByteArray &KGK, QIODevice *in, QIODevice *out, bool compress);
+  static bool decode(const SecureByteArray &masterPassword, QIODevice *in, QIODevice *out, bool uncompress, SecureByteArray &KGK, PBKDF2 *pbkdf2 = Q_NULLPTR);
+  static void clearKeyCache(void);
   static QByteArray randomBytes(const int size);
   static SecureByteArray generateKGK(void);
   static SecureByteArray generateIV(void);
@@ -58,6 +67,10 @@ private:
   static const int KGKIterations;
   static const int DomainIterations;
   static const int CryptDataSize;
+  static const int HeaderSize;
+
+  static bool pump(QIODevice *in, CryptoPP::BufferedTransformation *pipeline);
+  static bool deriveKey(const SecureByteArray &pwd, const QByteArray &salt, int iterations, QCryptographicHash::Algorithm algorithm, SecureByteArray &derivedKey, PBKDF2 *pbkdf2);
 
 };
 
@@ -0,0 +1,287 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "cryptoexecutor.h"
+
+#include <QDebug>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+
+struct CryptoExecutorTask {
+  QString tag;
+  CryptoExecutor::Task task;
+  QFutureInterface<void> future;
+};
+
+
+class CryptoExecutorPrivate {
+public:
+  CryptoExecutorPrivate(void)
+    : dispatchers(0)
+    , maxThreads(QThread::idealThreadCount())
+  {
+    for (int i = 0; i < CryptoExecutor::PriorityCount; ++i) {
+      active[i] = 0;
+      completed[i] = 0;
+    }
+    setMaxThreadCount(maxThreads);
+    pool.setExpiryTimeout(5000);
+  }
+  ~CryptoExecutorPrivate()
+  { /* ... */ }
+  void setMaxThreadCount(int n)
+  {
+    maxThreads = qMax(1, n);
+    // With a single thread a running Background task would block everything
+    // else, so the pool gets an extra thread that only Background work uses.
+    pool.setMaxThreadCount(maxThreads == 1 ? 2 : maxThreads);
+  }
+  bool takeNext(CryptoExecutor::Priority &priority, CryptoExecutorTask &task);
+  static QThread::Priority threadPriority(CryptoExecutor::Priority priority);
+  QQueue<CryptoExecutorTask> queues[CryptoExecutor::PriorityCount];
+  int active[CryptoExecutor::PriorityCount];
+  quint64 completed[CryptoExecutor::PriorityCount];
+  int dispatchers;
+  int maxThreads;
+  mutable QMutex mutex;
+  QThreadPool pool;
+};
+
+
+/*!
+ * \brief CryptoExecutorPrivate::takeNext
+ *
+ * Dequeues the oldest task of the most urgent class. Must be called with `mutex` held.
+ *
+ * \return `false` if no task may run now.
+ */
+bool CryptoExecutorPrivate::takeNext(CryptoExecutor::Priority &priority, CryptoExecutorTask &task)
+{
+  const int backgroundLimit = qMax(1, maxThreads - 1);
+  const int foregroundActive = active[CryptoExecutor::Interactive] + active[CryptoExecutor::Normal];
+  for (int i = 0; i < CryptoExecutor::PriorityCount; ++i) {
+    if (queues[i].isEmpty())
+      continue;
+    if (i == CryptoExecutor::Background ? active[i] >= backgroundLimit : foregroundActive >= maxThreads)
+      continue;
+    priority = CryptoExecutor::Priority(i);
+    task = queues[i].dequeue();
+    ++active[i];
+    return true;
+  }
+  return false;
+}
+
+
+QThread::Priority CryptoExecutorPrivate::threadPriority(CryptoExecutor::Priority priority)
+{
+  switch (priority) {
+  case CryptoExecutor::Interactive:
+    return QThread::HighPriority;
+  case CryptoExecutor::Background:
+    return QThread::LowPriority;
+  default:
+    break;
+  }
+  return QThread::NormalPriority;
+}
+
+
+class CryptoExecutorDispatcher : public QRunnable {
+public:
+  CryptoExecutorDispatcher(CryptoExecutor *executor)
+    : executor(executor)
+  { /* ... */ }
+  void run(void)
+  {
+    executor->dispatch();
+  }
+  CryptoExecutor *executor;
+};
+
+
+CryptoExecutor::CryptoExecutor(void)
+  : d_ptr(new CryptoExecutorPrivate)
+{ /* ... */ }
+
+
+CryptoExecutor::~CryptoExecutor()
+{
+  Q_D(CryptoExecutor);
+  cancel(QString());
+  d->pool.waitForDone();
+}
+
+
+CryptoExecutor &CryptoExecutor::instance(void)
+{
+  static CryptoExecutor executor;
+  return executor;
+}
+
+
+/*!
+ * \brief CryptoExecutor::setMaxThreadCount
+ *
+ * Sets the number of worker threads. Defaults to `QThread::idealThreadCount()`.
+ */
+void CryptoExecutor::setMaxThreadCount(int n)
+{
+  Q_D(CryptoExecutor);
+  QMutexLocker locker(&d->mutex);
+  d->setMaxThreadCount(n);
+}
+
+
+int CryptoExecutor::maxThreadCount(void) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->maxThreads;
+}
+
+
+/*!
+ * \brief CryptoExecutor::run
+ *
+ * Queues `task` in the class `priority`.
+ *
+ * \return A future that finishes when `task` has run or has been canceled.
+ */
+QFuture<void> CryptoExecutor::run(Priority priority, const QString &tag, const Task &task)
+{
+  Q_D(CryptoExecutor);
+  CryptoExecutorTask t;
+  t.tag = tag;
+  t.task = task;
+  t.future.reportStarted();
+  const QFuture<void> &future = t.future.future();
+  QMutexLocker locker(&d->mutex);
+  d->queues[priority].enqueue(t);
+  if (d->dispatchers < d->pool.maxThreadCount()) {
+    ++d->dispatchers;
+    d->pool.start(new CryptoExecutorDispatcher(this));
+  }
+  return future;
+}
+
+
+/*!
+ * \brief CryptoExecutor::cancel
+ *
+ * Removes all queued tasks tagged `tag`, or all queued tasks if `tag` is empty.
+ *
+ * \return The number of tasks removed.
+ */
+int CryptoExecutor::cancel(const QString &tag)
+{
+  Q_D(CryptoExecutor);
+  QList<CryptoExecutorTask> canceled;
+  {
+    QMutexLocker locker(&d->mutex);
+    for (int i = 0; i < PriorityCount; ++i) {
+      QQueue<CryptoExecutorTask> &queue = d->queues[i];
+      for (QQueue<CryptoExecutorTask>::iterator t = queue.begin(); t != queue.end(); ) {
+        if (tag.isEmpty() || t->tag == tag) {
+          canceled.append(*t);
+          t = queue.erase(t);
+        }
+        else {
+          ++t;
+        }
+      }
+    }
+  }
+  for (QList<CryptoExecutorTask>::iterator t = canceled.begin(); t != canceled.end(); ++t) {
+    t->future.reportCanceled();
+    t->future.reportFinished();
+  }
+  return canceled.size();
+}
+
+
+/*!
+ * \brief CryptoExecutor::waitForDone
+ *
+ * Blocks until all queued and running tasks have finished.
+ */
+void CryptoExecutor::waitForDone(void)
+{
+  d_ptr->pool.waitForDone();
+}
+
+
+int CryptoExecutor::queueDepth(Priority priority) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->queues[priority].size();
+}
+
+
+int CryptoExecutor::activeCount(Priority priority) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->active[priority];
+}
+
+
+quint64 CryptoExecutor::completedCount(Priority priority) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->completed[priority];
+}
+
+
+/*!
+ * \brief CryptoExecutor::dispatch
+ *
+ * Body of a worker thread: runs eligible tasks until there are none left.
+ * A task that throws doesn't take the worker down: its future is reported
+ * as canceled and finished, and the bookkeeping is updated as usual.
+ */
+void CryptoExecutor::dispatch(void)
+{
+  Q_D(CryptoExecutor);
+  Priority priority;
+  CryptoExecutorTask t;
+  d->mutex.lock();
+  while (d->takeNext(priority, t)) {
+    d->mutex.unlock();
+    QThread::currentThread()->setPriority(CryptoExecutorPrivate::threadPriority(priority));
+    try {
+      t.task();
+    }
+    catch (...) {
+      qWarning() << "CryptoExecutor: task" << t.tag << "threw an exception";
+      t.future.reportCanceled();
+    }
+    t.future.reportFinished();
+    t = CryptoExecutorTask();
+    d->mutex.lock();
+    --d->active[priority];
+    ++d->completed[priority];
+  }
+  --d->dispatchers;
+  d->mutex.unlock();
+}
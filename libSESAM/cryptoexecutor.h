@@ -0,0 +1,84 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __CRYPTOEXECUTOR_H_
+#define __CRYPTOEXECUTOR_H_
+
+#include <QString>
+#include <QFuture>
+#include <QScopedPointer>
+
+#include <functional>
+
+class CryptoExecutorPrivate;
+
+/*!
+ * \brief The CryptoExecutor class
+ *
+ * `CryptoExecutor` runs CPU-heavy work of libSESAM and Qt-SESAM on its
+ * own threads instead of `QThreadPool::globalInstance()`.
+ *
+ * Every task belongs to a priority class. Idle threads always pick the
+ * oldest task of the most urgent class. `Background` tasks never occupy
+ * all threads, so an `Interactive` task doesn't have to wait for a long
+ * background job to finish. With a single thread, `Background` work runs
+ * on an extra thread of its own for that reason. Worker threads run at an OS priority that
+ * matches the class of the task at hand.
+ *
+ * Tasks carry a tag. `cancel()` drops all queued tasks with a given tag;
+ * their futures are reported as canceled. Tasks that have already started
+ * are not interrupted, they have to poll their own `CancellationToken`.
+ */
+class CryptoExecutor
+{
+public:
+  enum Priority {
+    Interactive,
+    Normal,
+    Background,
+    PriorityCount
+  };
+
+  typedef std::function<void(void)> Task;
+
+  static CryptoExecutor &instance(void);
+
+  void setMaxThreadCount(int n);
+  int maxThreadCount(void) const;
+
+  QFuture<void> run(Priority priority, const QString &tag, const Task &task);
+  int cancel(const QString &tag);
+  void waitForDone(void);
+
+  int queueDepth(Priority priority) const;
+  int activeCount(Priority priority) const;
+  quint64 completedCount(Priority priority) const;
+
+private:
+  CryptoExecutor(void);
+  ~CryptoExecutor();
+  void dispatch(void);
+
+  QScopedPointer<CryptoExecutorPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(CryptoExecutor)
+  Q_DISABLE_COPY(CryptoExecutor)
+};
+
+
+#endif // __CRYPTOEXECUTOR_H_
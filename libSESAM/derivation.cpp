@@ -0,0 +1,127 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "derivation.h"
+#include "domainsettings.h"
+#include "cancellationtoken.h"
+#include "hashbackend.h"
+#include "password.h"
+#include "passwordtemplateplan.h"
+#include "uint512.h"
+
+#include <QElapsedTimer>
+#include <QScopedPointer>
+
+
+const int Derivation::CancellationCheckInterval = 1024;
+const int Derivation::ProgressIntervalMSecs = 100;
+
+
+DerivationRequest::DerivationRequest(void)
+  : iterations(1)
+  , algorithm(QCryptographicHash::Sha512)
+{ /* ... */ }
+
+
+DerivationRequest::DerivationRequest(const SecureByteArray &key, const DomainSettings &ds)
+  : pwd(ds.domainName.toUtf8() + ds.userName.toUtf8() + key)
+  , salt(QByteArray::fromBase64(ds.salt_base64.toUtf8()))
+  , iterations(ds.iterations)
+  , algorithm(QCryptographicHash::Sha512)
+  , passwordTemplate(ds.passwordTemplate)
+  , extraCharacters(ds.extraCharacters)
+{ /* ... */ }
+
+
+DerivationResult::DerivationResult(void)
+  : error(Password::NoError)
+  , elapsedSeconds(0)
+  , aborted(false)
+{ /* ... */ }
+
+
+/*!
+ * \brief Derivation::derive
+ *
+ * Runs PBKDF2 over `request` in chunks of `CancellationCheckInterval`
+ * iterations. Between two chunks it polls `token` and, at most every
+ * `ProgressIntervalMSecs` milliseconds, reports to `progress`.
+ * Then shapes the password according to `request.passwordTemplate`.
+ *
+ * \return The result. If `token` was cancelled, `aborted` is set, `error`
+ * is `Password::AbortedError` and `derivedKey` holds the intermediate key.
+ */
+DerivationResult Derivation::derive(const DerivationRequest &request, const CancellationToken *token, DerivationProgress *progress)
+{
+  DerivationResult result;
+  QElapsedTimer elapsedTimer;
+  elapsedTimer.start();
+
+  const HashBackend *backend = HashBackendRegistry::instance().backend(request.algorithm);
+  QScopedPointer<HashBackend::PBKDF2Chain> chain(backend->beginPBKDF2(request.algorithm, request.pwd, request.salt));
+  qint64 lastProgressMSecs = 0;
+  int done = 1;
+  while (done < request.iterations) {
+    if (token != Q_NULLPTR && token->isCancelled()) {
+      result.aborted = true;
+      break;
+    }
+    const int rounds = qMin(CancellationCheckInterval, request.iterations - done);
+    chain->iterate(rounds);
+    done += rounds;
+    if (progress != Q_NULLPTR) {
+      const qint64 elapsedMSecs = elapsedTimer.elapsed();
+      if (elapsedMSecs - lastProgressMSecs >= ProgressIntervalMSecs) {
+        lastProgressMSecs = elapsedMSecs;
+        const qreal iterationsPerSecond = 1e3 * qreal(done) / qreal(elapsedMSecs);
+        progress->progress(done, request.iterations, iterationsPerSecond, qreal(request.iterations - done) / iterationsPerSecond);
+      }
+    }
+  }
+  result.derivedKey = chain->derivedKey();
+
+  if (result.aborted) {
+    result.error = Password::AbortedError;
+    result.errorString = "derivation cancelled";
+  }
+  else if (!request.passwordTemplate.isEmpty()) {
+    const QSharedPointer<const PasswordTemplatePlan> &plan = PasswordTemplatePlan::get(request.passwordTemplate, request.extraCharacters);
+    result.error = plan->error();
+    result.errorString = plan->errorString();
+    result.password = shape(*plan, result.derivedKey);
+  }
+  result.elapsedSeconds = 1e-9 * elapsedTimer.nsecsElapsed();
+  return result;
+}
+
+
+/*!
+ * \brief Derivation::shape
+ *
+ * \return The password `plan` makes of `derivedKey`, or an empty string if the plan is erroneous.
+ */
+SecureString Derivation::shape(const PasswordTemplatePlan &plan, const SecureByteArray &derivedKey)
+{
+  SecureString password;
+  if (plan.error() == Password::NoError) {
+    UInt512 v(reinterpret_cast<const uchar*>(derivedKey.constData()), derivedKey.size());
+    plan.apply(v, password);
+  }
+  return password;
+}
@@ -0,0 +1,103 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __DERIVATION_H_
+#define __DERIVATION_H_
+
+#include <QString>
+#include <QByteArray>
+#include <QCryptographicHash>
+
+#include "securebytearray.h"
+#include "securestring.h"
+
+class DomainSettings;
+class CancellationToken;
+class PasswordTemplatePlan;
+
+
+/*!
+ * \brief The DerivationRequest struct
+ *
+ * All inputs of a password derivation. Construct it from a key and a set
+ * of domain settings to get the same inputs `Password` uses. If
+ * `passwordTemplate` is empty, only the key is derived.
+ */
+struct DerivationRequest
+{
+  DerivationRequest(void);
+  DerivationRequest(const SecureByteArray &key, const DomainSettings &ds);
+  SecureByteArray pwd;
+  QByteArray salt;
+  int iterations;
+  QCryptographicHash::Algorithm algorithm;
+  QString passwordTemplate;
+  QString extraCharacters;
+};
+
+
+/*!
+ * \brief The DerivationResult struct
+ *
+ * `error` is one of `Password::PasswordError`.
+ */
+struct DerivationResult
+{
+  DerivationResult(void);
+  SecureByteArray derivedKey;
+  SecureString password;
+  int error;
+  QString errorString;
+  qreal elapsedSeconds;
+  bool aborted;
+};
+
+
+/*!
+ * \brief The DerivationProgress class
+ *
+ * Optional observer `Derivation::derive()` reports its progress to.
+ */
+class DerivationProgress
+{
+public:
+  virtual ~DerivationProgress() { /* ... */ }
+  virtual void progress(int iterationsDone, int iterations, qreal iterationsPerSecond, qreal secondsRemaining) = 0;
+};
+
+
+/*!
+ * \brief The Derivation class
+ *
+ * The synchronous derivation core of libSESAM: no `QObject`, no signals,
+ * no threads. `PBKDF2` and `Password` are adapters around it; bulk callers
+ * and worker threads can call it directly.
+ */
+class Derivation
+{
+public:
+  static const int CancellationCheckInterval;
+  static const int ProgressIntervalMSecs;
+
+  static DerivationResult derive(const DerivationRequest &request, const CancellationToken *token = Q_NULLPTR, DerivationProgress *progress = Q_NULLPTR);
+  static SecureString shape(const PasswordTemplatePlan &plan, const SecureByteArray &derivedKey);
+};
+
+
+#endif // __DERIVATION_H_
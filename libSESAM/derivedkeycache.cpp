@@ -0,0 +1,353 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "derivedkeycache.h"
+#include "util.h"
+
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+const int DerivedKeyCache::DefaultCapacity;
+
+
+/*!
+ * \brief The LockedKeyArena class
+ *
+ * Hands out fixed-size slots for keys from pages that are allocated
+ * page-aligned and locked once. A page is unlocked and released only when
+ * its last slot has been freed, so unlocking never affects memory that
+ * belongs to other keys or to other allocations.
+ */
+class LockedKeyArena {
+public:
+  static const int SlotSize = 64;
+
+  LockedKeyArena(void)
+    : pageSize(systemPageSize())
+    , slotsPerPage(qMin(64, pageSize / SlotSize))
+  { /* ... */ }
+  ~LockedKeyArena()
+  {
+    for (int i = 0; i < pages.size(); ++i) {
+      unmap(pages.at(i));
+    }
+  }
+  char *allocate(void)
+  {
+    for (int i = 0; i < pages.size(); ++i) {
+      Page &page = pages[i];
+      for (int k = 0; k < slotsPerPage; ++k) {
+        if ((page.used & (Q_UINT64_C(1) << k)) == 0) {
+          page.used |= Q_UINT64_C(1) << k;
+          return page.base + k * SlotSize;
+        }
+      }
+    }
+    Page page;
+    if (!map(page))
+      return Q_NULLPTR;
+    page.used = 1;
+    pages.append(page);
+    return page.base;
+  }
+  void release(char *slot)
+  {
+    SecureErase(slot, SlotSize);
+    for (int i = 0; i < pages.size(); ++i) {
+      const Page &page = pages.at(i);
+      if (slot >= page.base && slot < page.base + pageSize) {
+        pages[i].used &= ~(Q_UINT64_C(1) << ((slot - page.base) / SlotSize));
+        if (pages.at(i).used == 0) {
+          unmap(pages.takeAt(i));
+        }
+        return;
+      }
+    }
+  }
+
+private:
+  struct Page {
+    char *base;
+    quint64 used;
+    bool locked;
+  };
+  static int systemPageSize(void)
+  {
+#if defined(Q_OS_WIN)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return int(info.dwPageSize);
+#else
+    return int(sysconf(_SC_PAGESIZE));
+#endif
+  }
+  bool map(Page &page) const
+  {
+#if defined(Q_OS_WIN)
+    page.base = reinterpret_cast<char*>(VirtualAlloc(Q_NULLPTR, SIZE_T(pageSize), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+    if (page.base == Q_NULLPTR)
+      return false;
+    page.locked = VirtualLock(page.base, SIZE_T(pageSize)) != 0;
+#else
+    void *base = mmap(Q_NULLPTR, size_t(pageSize), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+      return false;
+    page.base = reinterpret_cast<char*>(base);
+    page.locked = mlock(page.base, size_t(pageSize)) == 0;
+#endif
+    return true;
+  }
+  void unmap(const Page &page) const
+  {
+    SecureErase(page.base, size_t(pageSize));
+#if defined(Q_OS_WIN)
+    if (page.locked) {
+      VirtualUnlock(page.base, SIZE_T(pageSize));
+    }
+    VirtualFree(page.base, 0, MEM_RELEASE);
+#else
+    if (page.locked) {
+      munlock(page.base, size_t(pageSize));
+    }
+    munmap(page.base, size_t(pageSize));
+#endif
+  }
+  const int pageSize;
+  const int slotsPerPage;
+  QList<Page> pages;
+  Q_DISABLE_COPY(LockedKeyArena)
+};
+
+const int LockedKeyArena::SlotSize;
+
+
+/*!
+ * \brief The DerivedKeyCacheEntry class
+ *
+ * Keeps a key in a slot of a `LockedKeyArena`. Keys larger than a slot, or
+ * keys for which no slot could be mapped, are kept in a `SecureByteArray`.
+ */
+class DerivedKeyCacheEntry {
+public:
+  DerivedKeyCacheEntry(LockedKeyArena &arena, const QByteArray &fingerprint, const SecureByteArray &key)
+    : fingerprint(fingerprint.constData(), fingerprint.size())
+    , arena(arena)
+    , slot(key.size() <= LockedKeyArena::SlotSize ? arena.allocate() : Q_NULLPTR)
+    , size(key.size())
+  {
+    if (slot != Q_NULLPTR) {
+      memcpy(slot, key.constData(), size_t(size));
+    }
+    else {
+      unlockedKey = SecureByteArray(key.constData(), key.size());
+    }
+  }
+  ~DerivedKeyCacheEntry()
+  {
+    SecureErase(fingerprint.data(), size_t(fingerprint.size()));
+    if (slot != Q_NULLPTR) {
+      arena.release(slot);
+    }
+  }
+  SecureByteArray key(void) const
+  {
+    return slot != Q_NULLPTR
+        ? SecureByteArray(slot, size)
+        : SecureByteArray(unlockedKey.constData(), unlockedKey.size());
+  }
+  QByteArray fingerprint;
+
+private:
+  LockedKeyArena &arena;
+  char *slot;
+  int size;
+  SecureByteArray unlockedKey;
+  Q_DISABLE_COPY(DerivedKeyCacheEntry)
+};
+
+
+class DerivedKeyCachePrivate {
+public:
+  DerivedKeyCachePrivate(int capacity)
+    : capacity(qMax(1, capacity))
+    , generation(0)
+  { /* ... */ }
+  ~DerivedKeyCachePrivate()
+  {
+    qDeleteAll(entries);
+  }
+  int indexOf(const QByteArray &fingerprint) const
+  {
+    for (int i = 0; i < entries.size(); ++i) {
+      if (entries.at(i)->fingerprint == fingerprint)
+        return i;
+    }
+    return -1;
+  }
+  void insert(const QByteArray &fingerprint, const SecureByteArray &key)
+  {
+    const int idx = indexOf(fingerprint);
+    if (idx >= 0) {
+      delete entries.takeAt(idx);
+    }
+    shrinkTo(capacity - 1);
+    entries.prepend(new DerivedKeyCacheEntry(arena, fingerprint, key));
+  }
+  void shrinkTo(int n)
+  {
+    while (entries.size() > n) {
+      delete entries.takeLast();
+    }
+  }
+  int capacity;
+  quint64 generation;
+  LockedKeyArena arena;
+  QList<DerivedKeyCacheEntry*> entries; // most recently used first
+  mutable QMutex mutex;
+};
+
+
+DerivedKeyCache::DerivedKeyCache(int capacity)
+  : d_ptr(new DerivedKeyCachePrivate(capacity))
+{ /* ... */ }
+
+
+DerivedKeyCache::~DerivedKeyCache()
+{ /* ... */ }
+
+
+int DerivedKeyCache::capacity(void) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->capacity;
+}
+
+
+void DerivedKeyCache::setCapacity(int capacity)
+{
+  Q_D(DerivedKeyCache);
+  QMutexLocker locker(&d->mutex);
+  d->capacity = qMax(1, capacity);
+  d->shrinkTo(d->capacity);
+}
+
+
+int DerivedKeyCache::count(void) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->entries.size();
+}
+
+
+/*!
+ * \brief DerivedKeyCache::lookup
+ *
+ * Copies the key stored for `fingerprint` to `key` and marks the entry as most recently used.
+ *
+ * \return `true` if an entry was found.
+ */
+bool DerivedKeyCache::lookup(const QByteArray &fingerprint, SecureByteArray &key)
+{
+  Q_D(DerivedKeyCache);
+  QMutexLocker locker(&d->mutex);
+  const int idx = d->indexOf(fingerprint);
+  if (idx < 0)
+    return false;
+  d->entries.move(idx, 0);
+  key = d->entries.first()->key();
+  return true;
+}
+
+
+bool DerivedKeyCache::contains(const QByteArray &fingerprint) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->indexOf(fingerprint) >= 0;
+}
+
+
+/*!
+ * \brief DerivedKeyCache::insert
+ *
+ * Stores a copy of `key` under `fingerprint`, evicting the least recently used entry if the cache is full.
+ */
+void DerivedKeyCache::insert(const QByteArray &fingerprint, const SecureByteArray &key)
+{
+  Q_D(DerivedKeyCache);
+  QMutexLocker locker(&d->mutex);
+  d->insert(fingerprint, key);
+}
+
+
+/*!
+ * \brief DerivedKeyCache::insert
+ *
+ * Like `insert(fingerprint, key)`, but drops `key` if `clear()` has been
+ * called since `generation()` returned `generation`. Take the generation
+ * before a derivation starts so that a key derived from invalidated inputs
+ * doesn't end up in the cache after it has been flushed.
+ *
+ * \return `true` if `key` has been stored.
+ */
+bool DerivedKeyCache::insert(const QByteArray &fingerprint, const SecureByteArray &key, quint64 generation)
+{
+  Q_D(DerivedKeyCache);
+  QMutexLocker locker(&d->mutex);
+  if (generation != d->generation)
+    return false;
+  d->insert(fingerprint, key);
+  return true;
+}
+
+
+/*!
+ * \brief DerivedKeyCache::generation
+ *
+ * \return The number of times `clear()` has been called.
+ */
+quint64 DerivedKeyCache::generation(void) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->generation;
+}
+
+
+/*!
+ * \brief DerivedKeyCache::clear
+ *
+ * Wipes and removes all entries.
+ */
+void DerivedKeyCache::clear(void)
+{
+  Q_D(DerivedKeyCache);
+  QMutexLocker locker(&d->mutex);
+  ++d->generation;
+  d->shrinkTo(0);
+}
@@ -0,0 +1,70 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __DERIVEDKEYCACHE_H_
+#define __DERIVEDKEYCACHE_H_
+
+#include <QByteArray>
+#include <QScopedPointer>
+
+#include "securebytearray.h"
+
+class DerivedKeyCachePrivate;
+
+/*!
+ * \brief The DerivedKeyCache class
+ *
+ * `DerivedKeyCache` keeps the most recently derived password keys so that
+ * revisiting a domain does not run PBKDF2 again.
+ *
+ * Entries are looked up by a fingerprint of all key derivation inputs
+ * (see `Password::needsKeyDerivation()`). At most `capacity()` entries are
+ * kept; the least recently used one is evicted first. The keys are stored
+ * in page-locked memory where the platform permits and are overwritten
+ * with zeros when evicted or when the cache is cleared.
+ *
+ * All methods are thread-safe.
+ */
+class DerivedKeyCache
+{
+public:
+  explicit DerivedKeyCache(int capacity = DefaultCapacity);
+  ~DerivedKeyCache();
+
+  static const int DefaultCapacity = 32;
+
+  int capacity(void) const;
+  void setCapacity(int capacity);
+  int count(void) const;
+
+  bool lookup(const QByteArray &fingerprint, SecureByteArray &key);
+  bool contains(const QByteArray &fingerprint) const;
+  void insert(const QByteArray &fingerprint, const SecureByteArray &key);
+  bool insert(const QByteArray &fingerprint, const SecureByteArray &key, quint64 generation);
+  quint64 generation(void) const;
+  void clear(void);
+
+private:
+  QScopedPointer<DerivedKeyCachePrivate> d_ptr;
+  Q_DECLARE_PRIVATE(DerivedKeyCache)
+  Q_DISABLE_COPY(DerivedKeyCache)
+};
+
+
+#endif // __DERIVEDKEYCACHE_H_
@@ -0,0 +1,519 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstring>
+
+#include "hashbackend.h"
+#include "hmacengine.h"
+#include "cpufeatures.h"
+#include "sha512multibuffer.h"
+#include "util.h"
+
+#include "config.h"
+#include "sha.h"
+#include "hmac.h"
+
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QMessageAuthenticationCode>
+#include <QtDebug>
+
+
+static const char INT_32_BE1[4] = { 0, 0, 0, 1 };
+
+
+/*!
+ * \brief The QtPBKDF2Chain class
+ *
+ * PBKDF2 on top of `QMessageAuthenticationCode`. Works with every algorithm
+ * Qt knows and serves as the reference for all other backends.
+ */
+class QtPBKDF2Chain : public HashBackend::PBKDF2Chain
+{
+public:
+  QtPBKDF2Chain(QCryptographicHash::Algorithm algorithm, const SecureByteArray &pwd, const QByteArray &salt)
+    : mHMAC(algorithm)
+  {
+    mHMAC.setKey(pwd);
+    mHMAC.addData(salt);
+    mHMAC.addData(INT_32_BE1, sizeof(INT_32_BE1));
+    mU = mHMAC.result();
+    mAcc = mU;
+  }
+  void iterate(int rounds)
+  {
+    while (rounds-- > 0) {
+      mHMAC.reset();
+      mHMAC.addData(mU);
+      mU = mHMAC.result();
+      for (int i = 0; i < mAcc.size(); ++i) {
+        mAcc[i] = mAcc.at(i) ^ mU.at(i);
+      }
+    }
+  }
+  SecureByteArray derivedKey(void) const
+  {
+    return mAcc;
+  }
+
+private:
+  QMessageAuthenticationCode mHMAC;
+  SecureByteArray mU;
+  SecureByteArray mAcc;
+};
+
+
+class QtHashBackend : public HashBackend
+{
+public:
+  QString name(void) const
+  {
+    return QString("Qt");
+  }
+  bool supports(QCryptographicHash::Algorithm) const
+  {
+    return true;
+  }
+  PBKDF2Chain *beginPBKDF2(QCryptographicHash::Algorithm algorithm, const SecureByteArray &pwd, const QByteArray &salt) const
+  {
+    return new QtPBKDF2Chain(algorithm, pwd, salt);
+  }
+};
+
+
+/*!
+ * \brief The NativePBKDF2Chain class
+ *
+ * PBKDF2 with `HMACEngine`, i.e. two compressions per iteration.
+ */
+template <class Hash>
+class NativePBKDF2Chain : public HashBackend::PBKDF2Chain
+{
+public:
+  NativePBKDF2Chain(const SecureByteArray &pwd, const QByteArray &salt)
+    : mHMAC(pwd.constData(), pwd.size())
+  {
+    mHMAC.beginPBKDF2(salt.constData(), salt.size(), mChain);
+  }
+  void iterate(int rounds)
+  {
+    mHMAC.iteratePBKDF2(mChain, rounds);
+  }
+  SecureByteArray derivedKey(void) const
+  {
+    SecureByteArray key(Hash::DigestSize, static_cast<char>(0));
+    HMACEngine<Hash>::finishPBKDF2(mChain, reinterpret_cast<uchar*>(key.data()));
+    return key;
+  }
+
+private:
+  HMACEngine<Hash> mHMAC;
+  typename HMACEngine<Hash>::PBKDF2Chain mChain;
+};
+
+
+class NativeHashBackend : public HashBackend
+{
+public:
+  QString name(void) const
+  {
+    return QString("native");
+  }
+  bool supports(QCryptographicHash::Algorithm algorithm) const
+  {
+    return algorithm == QCryptographicHash::Sha256
+        || algorithm == QCryptographicHash::Sha384
+        || algorithm == QCryptographicHash::Sha512;
+  }
+  PBKDF2Chain *beginPBKDF2(QCryptographicHash::Algorithm algorithm, const SecureByteArray &pwd, const QByteArray &salt) const
+  {
+    switch (algorithm) {
+    case QCryptographicHash::Sha256:
+      return new NativePBKDF2Chain<Sha256>(pwd, salt);
+    case QCryptographicHash::Sha384:
+      return new NativePBKDF2Chain<Sha384>(pwd, salt);
+    case QCryptographicHash::Sha512:
+      return new NativePBKDF2Chain<Sha512>(pwd, salt);
+    default:
+      break;
+    }
+    return Q_NULLPTR;
+  }
+};
+
+
+/*!
+ * \brief The ShaNIHashBackend class
+ *
+ * Like `NativeHashBackend`, but with the SHA-256 compression function
+ * running on the x86 SHA extensions. Only offers SHA-256, and only if
+ * the CPU supports it.
+ */
+class ShaNIHashBackend : public HashBackend
+{
+public:
+  QString name(void) const
+  {
+    return QString("SHA-NI");
+  }
+  bool supports(QCryptographicHash::Algorithm algorithm) const
+  {
+    return algorithm == QCryptographicHash::Sha256 && Sha256NI::isSupported();
+  }
+  PBKDF2Chain *beginPBKDF2(QCryptographicHash::Algorithm algorithm, const SecureByteArray &pwd, const QByteArray &salt) const
+  {
+    return supports(algorithm)
+        ? new NativePBKDF2Chain<Sha256NI>(pwd, salt)
+        : Q_NULLPTR;
+  }
+};
+
+
+/*!
+ * \brief The CryptoPPPBKDF2Chain class
+ *
+ * PBKDF2 with the HMAC implementation of the bundled Crypto++ library.
+ */
+template <class T>
+class CryptoPPPBKDF2Chain : public HashBackend::PBKDF2Chain
+{
+public:
+  CryptoPPPBKDF2Chain(const SecureByteArray &pwd, const QByteArray &salt)
+    : mHMAC(reinterpret_cast<const uchar*>(pwd.constData()), size_t(pwd.size()))
+  {
+    mHMAC.Update(reinterpret_cast<const uchar*>(salt.constData()), size_t(salt.size()));
+    mHMAC.Update(reinterpret_cast<const uchar*>(INT_32_BE1), sizeof(INT_32_BE1));
+    mHMAC.Final(mU);
+    memcpy(mAcc, mU, sizeof(mAcc));
+  }
+  ~CryptoPPPBKDF2Chain()
+  {
+    SecureErase(mU, sizeof(mU));
+    SecureErase(mAcc, sizeof(mAcc));
+  }
+  void iterate(int rounds)
+  {
+    while (rounds-- > 0) {
+      mHMAC.Update(mU, sizeof(mU));
+      mHMAC.Final(mU);
+      for (int i = 0; i < int(T::DIGESTSIZE); ++i) {
+        mAcc[i] ^= mU[i];
+      }
+    }
+  }
+  SecureByteArray derivedKey(void) const
+  {
+    return SecureByteArray(reinterpret_cast<const char*>(mAcc), int(T::DIGESTSIZE));
+  }
+
+private:
+  CryptoPP::HMAC<T> mHMAC;
+  uchar mU[T::DIGESTSIZE];
+  uchar mAcc[T::DIGESTSIZE];
+};
+
+
+class CryptoPPHashBackend : public HashBackend
+{
+public:
+  QString name(void) const
+  {
+    return QString("Crypto++");
+  }
+  bool supports(QCryptographicHash::Algorithm algorithm) const
+  {
+    return algorithm == QCryptographicHash::Sha256
+        || algorithm == QCryptographicHash::Sha384
+        || algorithm == QCryptographicHash::Sha512;
+  }
+  PBKDF2Chain *beginPBKDF2(QCryptographicHash::Algorithm algorithm, const SecureByteArray &pwd, const QByteArray &salt) const
+  {
+    switch (algorithm) {
+    case QCryptographicHash::Sha256:
+      return new CryptoPPPBKDF2Chain<CryptoPP::SHA256>(pwd, salt);
+    case QCryptographicHash::Sha384:
+      return new CryptoPPPBKDF2Chain<CryptoPP::SHA384>(pwd, salt);
+    case QCryptographicHash::Sha512:
+      return new CryptoPPPBKDF2Chain<CryptoPP::SHA512>(pwd, salt);
+    default:
+      break;
+    }
+    return Q_NULLPTR;
+  }
+};
+
+
+class HashBackendRegistryPrivate
+{
+public:
+  HashBackendRegistryPrivate(void)
+    : reference(new QtHashBackend)
+  {
+    backends << reference << new NativeHashBackend << new ShaNIHashBackend << new CryptoPPHashBackend;
+  }
+  ~HashBackendRegistryPrivate()
+  {
+    qDeleteAll(backends);
+  }
+  void select(QCryptographicHash::Algorithm algorithm);
+  qreal measure(const HashBackend *backend, QCryptographicHash::Algorithm algorithm) const;
+
+  static const int SelfTestIterations = 3;
+  static const qint64 BenchmarkNSecs = 25 * 1000 * 1000;
+  static const QCryptographicHash::Algorithm BenchmarkedAlgorithms[3];
+
+  const HashBackend *reference;
+  QList<HashBackend*> backends;
+  QMap<int, const HashBackend*> selected;
+  QList<HashBackendMeasurement> measurements;
+  mutable QMutex mutex;
+};
+
+
+const QCryptographicHash::Algorithm HashBackendRegistryPrivate::BenchmarkedAlgorithms[3] = {
+  QCryptographicHash::Sha256, QCryptographicHash::Sha384, QCryptographicHash::Sha512
+};
+
+
+/*!
+ * \brief HashBackendRegistryPrivate::measure
+ *
+ * Runs PBKDF2 iterations with `backend` for about `BenchmarkNSecs` nanoseconds.
+ *
+ * \return Iterations per second.
+ */
+qreal HashBackendRegistryPrivate::measure(const HashBackend *backend, QCryptographicHash::Algorithm algorithm) const
+{
+  static const int Rounds = 256;
+  const SecureByteArray pwd("benchmark");
+  const QByteArray salt("benchmark salt");
+  QScopedPointer<HashBackend::PBKDF2Chain> chain(backend->beginPBKDF2(algorithm, pwd, salt));
+  QElapsedTimer timer;
+  timer.start();
+  qint64 iterations = 0;
+  qint64 elapsed;
+  do {
+    chain->iterate(Rounds);
+    iterations += Rounds;
+    elapsed = timer.nsecsElapsed();
+  } while (elapsed < BenchmarkNSecs);
+  return 1e9 * qreal(iterations) / qreal(elapsed);
+}
+
+
+/*!
+ * \brief HashBackendRegistryPrivate::select
+ *
+ * Checks every backend supporting `algorithm` against the reference
+ * implementation, measures its throughput and remembers the fastest one.
+ * Must be called with `mutex` locked.
+ */
+void HashBackendRegistryPrivate::select(QCryptographicHash::Algorithm algorithm)
+{
+  const SecureByteArray pwd("self test");
+  const QByteArray salt("self test salt");
+  QScopedPointer<HashBackend::PBKDF2Chain> refChain(reference->beginPBKDF2(algorithm, pwd, salt));
+  refChain->iterate(SelfTestIterations - 1);
+  const SecureByteArray &expected = refChain->derivedKey();
+
+  for (int i = measurements.size() - 1; i >= 0; --i) {
+    if (measurements.at(i).algorithm == algorithm) {
+      measurements.removeAt(i);
+    }
+  }
+  const HashBackend *best = reference;
+  int bestIdx = -1;
+  qreal bestRate = 0;
+  foreach (const HashBackend *backend, backends) {
+    if (!backend->supports(algorithm))
+      continue;
+    QScopedPointer<HashBackend::PBKDF2Chain> chain(backend->beginPBKDF2(algorithm, pwd, salt));
+    if (chain.isNull())
+      continue;
+    chain->iterate(SelfTestIterations - 1);
+    if (chain->derivedKey() != expected) {
+      qWarning() << "Hash backend" << backend->name() << "failed self test for" << HashBackendRegistry::algorithmName(algorithm);
+      continue;
+    }
+    HashBackendMeasurement m;
+    m.backend = backend->name();
+    m.algorithm = algorithm;
+    m.iterationsPerSecond = measure(backend, algorithm);
+    m.selected = false;
+    if (m.iterationsPerSecond > bestRate) {
+      best = backend;
+      bestRate = m.iterationsPerSecond;
+      bestIdx = measurements.size();
+    }
+    measurements.append(m);
+  }
+  if (bestIdx >= 0) {
+    measurements[bestIdx].selected = true;
+  }
+  selected[algorithm] = best;
+}
+
+
+HashBackendRegistry::HashBackendRegistry(void)
+  : d_ptr(new HashBackendRegistryPrivate)
+{ /* ... */ }
+
+
+HashBackendRegistry::~HashBackendRegistry()
+{ /* ... */ }
+
+
+HashBackendRegistry &HashBackendRegistry::instance(void)
+{
+  static HashBackendRegistry registry;
+  return registry;
+}
+
+
+/*!
+ * \brief HashBackendRegistry::registerBackend
+ *
+ * Adds `backend` to the list of candidates. The registry takes ownership.
+ * Previous benchmark results for the algorithms `backend` supports are dropped.
+ */
+void HashBackendRegistry::registerBackend(HashBackend *backend)
+{
+  Q_D(HashBackendRegistry);
+  QMutexLocker locker(&d->mutex);
+  d->backends.append(backend);
+  foreach (int algorithm, d->selected.keys()) {
+    if (backend->supports(QCryptographicHash::Algorithm(algorithm))) {
+      d->selected.remove(algorithm);
+    }
+  }
+}
+
+
+/*!
+ * \brief HashBackendRegistry::backend
+ *
+ * \return The fastest backend for `algorithm`. Benchmarks the candidates if that hasn't happened yet.
+ */
+const HashBackend *HashBackendRegistry::backend(QCryptographicHash::Algorithm algorithm)
+{
+  Q_D(HashBackendRegistry);
+  QMutexLocker locker(&d->mutex);
+  if (!d->selected.contains(algorithm)) {
+    d->select(algorithm);
+  }
+  return d->selected.value(algorithm);
+}
+
+
+/*!
+ * \brief HashBackendRegistry::benchmark
+ *
+ * Benchmarks the backends for all SHA-2 variants used by the application.
+ * Takes about 25 ms per candidate and algorithm, so better call it from a worker thread.
+ */
+void HashBackendRegistry::benchmark(void)
+{
+  Q_D(HashBackendRegistry);
+  QMutexLocker locker(&d->mutex);
+  for (int i = 0; i < 3; ++i) {
+    d->select(HashBackendRegistryPrivate::BenchmarkedAlgorithms[i]);
+  }
+}
+
+
+bool HashBackendRegistry::isBenchmarked(void) const
+{
+  Q_D(const HashBackendRegistry);
+  QMutexLocker locker(&d->mutex);
+  for (int i = 0; i < 3; ++i) {
+    if (!d->selected.contains(HashBackendRegistryPrivate::BenchmarkedAlgorithms[i]))
+      return false;
+  }
+  return true;
+}
+
+
+QList<HashBackendMeasurement> HashBackendRegistry::measurements(void) const
+{
+  Q_D(const HashBackendRegistry);
+  QMutexLocker locker(&d->mutex);
+  return d->measurements;
+}
+
+
+/*!
+ * \brief HashBackendRegistry::report
+ *
+ * \return Human readable lines describing the CPU features found and the
+ * measured throughput of each backend, with the selected one marked by an asterisk.
+ */
+QStringList HashBackendRegistry::report(void) const
+{
+  Q_D(const HashBackendRegistry);
+  QStringList lines;
+  const QStringList &features = CPUFeatures::names();
+  lines << QString("CPU features: %1").arg(features.isEmpty() ? QString("none detected") : features.join(' '));
+  QMutexLocker locker(&d->mutex);
+  for (int i = 0; i < 3; ++i) {
+    const QCryptographicHash::Algorithm algorithm = HashBackendRegistryPrivate::BenchmarkedAlgorithms[i];
+    QStringList results;
+    foreach (HashBackendMeasurement m, d->measurements) {
+      if (m.algorithm == algorithm) {
+        results << QString("%1%2 %3 kIt/s")
+                   .arg(m.backend)
+                   .arg(m.selected ? "*" : "")
+                   .arg(1e-3 * m.iterationsPerSecond, 0, 'f', 0);
+      }
+    }
+    if (!results.isEmpty()) {
+      lines << QString("PBKDF2-HMAC-%1: %2").arg(algorithmName(algorithm)).arg(results.join(", "));
+    }
+  }
+  locker.unlock();
+  const Sha512MultiBuffer::Kernel &kernel = Sha512MultiBuffer::bestKernel();
+  lines << QString("Batch PBKDF2-HMAC-SHA512: %1 (%2 lanes)").arg(kernel.name).arg(kernel.lanes);
+#if CRYPTOPP_BOOL_AESNI_INTRINSICS_AVAILABLE
+  lines << QString("AES: Crypto++ %1").arg(CPUFeatures::has(CPUFeatures::AESNI) ? "with AES-NI" : "portable");
+#else
+  lines << QString("AES: Crypto++ portable%1").arg(CPUFeatures::has(CPUFeatures::AESNI) ? " (AES-NI present, disabled at build time)" : "");
+#endif
+  return lines;
+}
+
+
+QString HashBackendRegistry::algorithmName(QCryptographicHash::Algorithm algorithm)
+{
+  switch (algorithm) {
+  case QCryptographicHash::Sha1:
+    return QString("SHA1");
+  case QCryptographicHash::Sha224:
+    return QString("SHA224");
+  case QCryptographicHash::Sha256:
+    return QString("SHA256");
+  case QCryptographicHash::Sha384:
+    return QString("SHA384");
+  case QCryptographicHash::Sha512:
+    return QString("SHA512");
+  default:
+    break;
+  }
+  return QString("#%1").arg(int(algorithm));
+}
@@ -0,0 +1,112 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __HASHBACKEND_H_
+#define __HASHBACKEND_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QByteArray>
+#include <QScopedPointer>
+#include <QCryptographicHash>
+
+#include "securebytearray.h"
+
+
+/*!
+ * \brief The HashBackend class
+ *
+ * A `HashBackend` provides the PBKDF2-HMAC primitive for one or more
+ * hash algorithms. Backends differ only in speed, never in their output.
+ */
+class HashBackend
+{
+public:
+  /*!
+   * \brief The PBKDF2Chain class
+   *
+   * State of a single PBKDF2 block derivation. `HashBackend::beginPBKDF2()`
+   * computes U1; each call to `iterate()` adds `rounds` more iterations.
+   */
+  class PBKDF2Chain
+  {
+  public:
+    virtual ~PBKDF2Chain() { /* ... */ }
+    virtual void iterate(int rounds) = 0;
+    virtual SecureByteArray derivedKey(void) const = 0;
+  };
+
+  virtual ~HashBackend() { /* ... */ }
+  virtual QString name(void) const = 0;
+  virtual bool supports(QCryptographicHash::Algorithm algorithm) const = 0;
+  virtual PBKDF2Chain *beginPBKDF2(QCryptographicHash::Algorithm algorithm, const SecureByteArray &pwd, const QByteArray &salt) const = 0;
+};
+
+
+struct HashBackendMeasurement
+{
+  QString backend;
+  QCryptographicHash::Algorithm algorithm;
+  qreal iterationsPerSecond;
+  bool selected;
+};
+
+
+class HashBackendRegistryPrivate;
+
+/*!
+ * \brief The HashBackendRegistry class
+ *
+ * Keeps the available `HashBackend`s and knows which one is the
+ * fastest for a given algorithm on this machine.
+ *
+ * The registry benchmarks all candidates for an algorithm once, either
+ * explicitly via `benchmark()` or lazily on the first call to `backend()`.
+ * Candidates whose output differs from the Qt reference implementation
+ * are discarded.
+ */
+class HashBackendRegistry
+{
+public:
+  static HashBackendRegistry &instance(void);
+
+  void registerBackend(HashBackend *backend);
+  const HashBackend *backend(QCryptographicHash::Algorithm algorithm);
+  void benchmark(void);
+  bool isBenchmarked(void) const;
+  QList<HashBackendMeasurement> measurements(void) const;
+  QStringList report(void) const;
+
+  static QString algorithmName(QCryptographicHash::Algorithm algorithm);
+
+  HashBackendRegistry(const HashBackendRegistry &) = delete;
+  void operator=(HashBackendRegistry const &) = delete;
+
+private:
+  HashBackendRegistry(void);
+  ~HashBackendRegistry();
+
+  QScopedPointer<HashBackendRegistryPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(HashBackendRegistry)
+};
+
+
+#endif // __HASHBACKEND_H_
@@ -0,0 +1,299 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __HMACENGINE_H_
+#define __HMACENGINE_H_
+
+#include <cstring>
+
+#include "sha2.h"
+#include "util.h"
+
+
+/*!
+ * \brief The HashContext class
+ *
+ * Incremental Merkle-Damgård hashing on top of one of the `Sha256`, `Sha384`
+ * or `Sha512` compression functions. All buffers live inside the object,
+ * so a `HashContext` on the stack never touches the heap.
+ */
+template <class Hash>
+class HashContext
+{
+public:
+  typedef typename Hash::Word Word;
+
+  HashContext(void)
+  {
+    init(Hash::InitialState, 0);
+  }
+  ~HashContext()
+  {
+    SecureErase(mState, sizeof(mState));
+    SecureErase(mBlock, sizeof(mBlock));
+    SecureErase(mBuf, sizeof(mBuf));
+  }
+
+  void init(const Word *state, quint64 bytesProcessed)
+  {
+    memcpy(mState, state, sizeof(mState));
+    mTotal = bytesProcessed;
+    mBufLen = 0;
+  }
+
+  void update(const uchar *data, size_t size)
+  {
+    mTotal += size;
+    if (mBufLen > 0) {
+      const size_t n = qMin<size_t>(size, Hash::BlockSize - mBufLen);
+      memcpy(mBuf + mBufLen, data, n);
+      mBufLen += int(n);
+      data += n;
+      size -= n;
+      if (mBufLen < Hash::BlockSize)
+        return;
+      compressBuffer();
+    }
+    while (size >= size_t(Hash::BlockSize)) {
+      loadBigEndian(mBlock, data, Hash::BlockWords);
+      Hash::transform(mState, mBlock);
+      data += Hash::BlockSize;
+      size -= Hash::BlockSize;
+    }
+    memcpy(mBuf, data, size);
+    mBufLen = int(size);
+  }
+
+  /*!
+   * Appends the padding and writes the first `Hash::DigestWords` words
+   * of the final state into `digest` (in host byte order).
+   */
+  void finalize(Word *digest)
+  {
+    static const int LengthFieldSize = 2 * sizeof(Word);
+    const quint64 bitCount = mTotal * 8;
+    mBuf[mBufLen++] = 0x80;
+    if (mBufLen > Hash::BlockSize - LengthFieldSize) {
+      memset(mBuf + mBufLen, 0, Hash::BlockSize - mBufLen);
+      compressBuffer();
+    }
+    memset(mBuf + mBufLen, 0, Hash::BlockSize - 8 - mBufLen);
+    qToBigEndian<quint64>(bitCount, mBuf + Hash::BlockSize - 8);
+    compressBuffer();
+    memcpy(digest, mState, Hash::DigestWords * sizeof(Word));
+  }
+
+private:
+  void compressBuffer(void)
+  {
+    loadBigEndian(mBlock, mBuf, Hash::BlockWords);
+    Hash::transform(mState, mBlock);
+    mBufLen = 0;
+  }
+
+  Word mState[Hash::StateWords];
+  Word mBlock[Hash::BlockWords];
+  uchar mBuf[Hash::BlockSize];
+  quint64 mTotal;
+  int mBufLen;
+};
+
+
+/*!
+ * \brief The HMACEngine class
+ *
+ * HMAC (RFC 2104) for the SHA-2 family with precomputed pad states.
+ *
+ * `setKey()` compresses the ipad and opad blocks once. Every MAC computed
+ * afterwards starts from copies of these two midstates, which saves two
+ * compression function calls per MAC compared to `QMessageAuthenticationCode`.
+ *
+ * The PBKDF2 helpers exploit the fact that every iteration after the first one
+ * MACs a message exactly one digest long. Inner and outer hash then consist of
+ * a single, identically padded block each, so the padding is written only once
+ * and each iteration is exactly two compression function calls with all state
+ * held in fixed-size buffers.
+ */
+template <class Hash>
+class HMACEngine
+{
+public:
+  typedef typename Hash::Word Word;
+
+  struct PBKDF2Chain {
+    Word block[Hash::BlockWords];
+    Word acc[Hash::DigestWords];
+    ~PBKDF2Chain()
+    {
+      SecureErase(block, sizeof(block));
+      SecureErase(acc, sizeof(acc));
+    }
+  };
+
+  HMACEngine(void)
+  {
+    setKey(Q_NULLPTR, 0);
+  }
+  HMACEngine(const char *key, int keySize)
+  {
+    setKey(key, keySize);
+  }
+  ~HMACEngine()
+  {
+    SecureErase(mInner, sizeof(mInner));
+    SecureErase(mOuter, sizeof(mOuter));
+  }
+
+  void setKey(const char *key, int keySize)
+  {
+    uchar k0[Hash::BlockSize];
+    memset(k0, 0, sizeof(k0));
+    if (keySize > Hash::BlockSize) {
+      HashContext<Hash> ctx;
+      Word digest[Hash::DigestWords];
+      ctx.update(reinterpret_cast<const uchar*>(key), size_t(keySize));
+      ctx.finalize(digest);
+      storeBigEndian(k0, digest, Hash::DigestWords);
+      SecureErase(digest, sizeof(digest));
+    }
+    else if (keySize > 0) {
+      memcpy(k0, key, size_t(keySize));
+    }
+    Word pad[Hash::BlockWords];
+    loadBigEndian(pad, k0, Hash::BlockWords);
+    SecureErase(k0, sizeof(k0));
+    const Word ipad = repeatedByte(0x36);
+    const Word opad = repeatedByte(0x5c);
+    for (int i = 0; i < Hash::BlockWords; ++i) {
+      pad[i] ^= ipad;
+    }
+    memcpy(mInner, Hash::InitialState, sizeof(mInner));
+    Hash::transform(mInner, pad);
+    for (int i = 0; i < Hash::BlockWords; ++i) {
+      pad[i] ^= ipad ^ opad;
+    }
+    memcpy(mOuter, Hash::InitialState, sizeof(mOuter));
+    Hash::transform(mOuter, pad);
+    SecureErase(pad, sizeof(pad));
+  }
+
+  const Word *innerState(void) const
+  {
+    return mInner;
+  }
+
+  const Word *outerState(void) const
+  {
+    return mOuter;
+  }
+
+  /*!
+   * Computes HMAC(key, `msg1` || `msg2`) and writes `Hash::DigestSize` bytes to `out`.
+   */
+  void mac(const char *msg1, int size1, const char *msg2, int size2, uchar *out) const
+  {
+    Word digest[Hash::DigestWords];
+    macWords(msg1, size1, msg2, size2, digest);
+    storeBigEndian(out, digest, Hash::DigestWords);
+    SecureErase(digest, sizeof(digest));
+  }
+
+  /*!
+   * Computes U1 = HMAC(key, `salt` || INT_32_BE(1)) and prepares `chain`
+   * for subsequent calls to `iteratePBKDF2()`.
+   */
+  void beginPBKDF2(const char *salt, int saltSize, PBKDF2Chain &chain) const
+  {
+    static const char INT_32_BE1[4] = { 0, 0, 0, 1 };
+    memset(chain.block, 0, sizeof(chain.block));
+    macWords(salt, saltSize, INT_32_BE1, sizeof(INT_32_BE1), chain.block);
+    memcpy(chain.acc, chain.block, sizeof(chain.acc));
+    chain.block[Hash::DigestWords] = Word(0x80) << (8 * sizeof(Word) - 8);
+    chain.block[Hash::BlockWords - 1] = Word(8 * (Hash::BlockSize + Hash::DigestSize));
+  }
+
+  /*!
+   * Computes U(i+1) = HMAC(key, U(i)) and XORs it into the accumulator,
+   * `rounds` times in a row.
+   */
+  void iteratePBKDF2(PBKDF2Chain &chain, int rounds) const
+  {
+    Word state[Hash::StateWords];
+    while (rounds-- > 0) {
+      memcpy(state, mInner, sizeof(state));
+      Hash::transform(state, chain.block);
+      memcpy(chain.block, state, Hash::DigestSize);
+      memcpy(state, mOuter, sizeof(state));
+      Hash::transform(state, chain.block);
+      for (int i = 0; i < Hash::DigestWords; ++i) {
+        chain.block[i] = state[i];
+        chain.acc[i] ^= state[i];
+      }
+    }
+    SecureErase(state, sizeof(state));
+  }
+
+  /*!
+   * Writes the accumulated PBKDF2 block (`Hash::DigestSize` bytes) to `out`.
+   */
+  static void finishPBKDF2(const PBKDF2Chain &chain, uchar *out)
+  {
+    storeBigEndian(out, chain.acc, Hash::DigestWords);
+  }
+
+private:
+  static Word repeatedByte(uchar b)
+  {
+    Word w = 0;
+    for (size_t i = 0; i < sizeof(Word); ++i) {
+      w = (w << 8) | b;
+    }
+    return w;
+  }
+
+  void macWords(const char *msg1, int size1, const char *msg2, int size2, Word *digest) const
+  {
+    HashContext<Hash> ctx;
+    ctx.init(mInner, Hash::BlockSize);
+    if (size1 > 0) {
+      ctx.update(reinterpret_cast<const uchar*>(msg1), size_t(size1));
+    }
+    if (size2 > 0) {
+      ctx.update(reinterpret_cast<const uchar*>(msg2), size_t(size2));
+    }
+    ctx.finalize(digest);
+    Word block[Hash::BlockWords];
+    memset(block, 0, sizeof(block));
+    memcpy(block, digest, Hash::DigestSize);
+    block[Hash::DigestWords] = Word(0x80) << (8 * sizeof(Word) - 8);
+    block[Hash::BlockWords - 1] = Word(8 * (Hash::BlockSize + Hash::DigestSize));
+    Word state[Hash::StateWords];
+    memcpy(state, mOuter, sizeof(state));
+    Hash::transform(state, block);
+    memcpy(digest, state, Hash::DigestSize);
+    SecureErase(block, sizeof(block));
+    SecureErase(state, sizeof(state));
+  }
+
+  Word mInner[Hash::StateWords];
+  Word mOuter[Hash::StateWords];
+};
+
+
+#endif // __HMACENGINE_H_
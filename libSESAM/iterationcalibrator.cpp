@@ -0,0 +1,129 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "iterationcalibrator.h"
+#include "hashbackend.h"
+#include "cpufeatures.h"
+#include "cryptoexecutor.h"
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QSysInfo>
+#include <QThread>
+#include <QVector>
+
+
+const int IterationCalibrator::DefaultTargetMSecs = 250;
+const int IterationCalibrator::MinIterations = 1024;
+const int IterationCalibrator::MaxIterations = 16777216;
+const int IterationCalibrator::IterationStep = 1024;
+
+static const qint64 MeasureNSecs = 200 * 1000 * 1000;
+
+
+static qreal measureChain(void)
+{
+  static const int Rounds = 256;
+  const HashBackend *backend = HashBackendRegistry::instance().backend(QCryptographicHash::Sha512);
+  QScopedPointer<HashBackend::PBKDF2Chain> chain(backend->beginPBKDF2(QCryptographicHash::Sha512, SecureByteArray("calibration"), QByteArray("calibration salt")));
+  QElapsedTimer timer;
+  timer.start();
+  qint64 iterations = 0;
+  qint64 elapsed;
+  do {
+    chain->iterate(Rounds);
+    iterations += Rounds;
+    elapsed = timer.nsecsElapsed();
+  } while (elapsed < MeasureNSecs);
+  return 1e9 * qreal(iterations) / qreal(elapsed);
+}
+
+
+/*!
+ * \brief IterationCalibrator::measure
+ *
+ * Measures how many PBKDF2-HMAC-SHA512 iterations per second a single
+ * derivation achieves with the fastest hash backend.
+ *
+ * \param allCores If `true`, one derivation runs on the calling thread and
+ * one on each free `CryptoExecutor` thread at the same time, and the slowest
+ * one counts. This accounts for lower clock rates under full load and gives a
+ * conservative estimate. Helpers that haven't started by the time the calling
+ * thread is done are dropped, so this is safe to call from a `CryptoExecutor` task.
+ * \return Iterations per second.
+ */
+qreal IterationCalibrator::measure(bool allCores)
+{
+  HashBackendRegistry::instance().backend(QCryptographicHash::Sha512);
+  if (!allCores)
+    return measureChain();
+  QVector<qreal> rates(qMax(1, QThread::idealThreadCount()) - 1, 0);
+  qreal *rate = rates.data();
+  const QString tag = QString("calibration:%1").arg(quintptr(rate), 0, 16);
+  QVector<QFuture<void> > helpers;
+  for (int i = 0; i < rates.size(); ++i) {
+    helpers.append(CryptoExecutor::instance().run(CryptoExecutor::Normal, tag, [rate, i]() {
+      rate[i] = measureChain();
+    }));
+  }
+  qreal slowest = measureChain();
+  CryptoExecutor::instance().cancel(tag);
+  foreach (QFuture<void> helper, helpers) {
+    helper.waitForFinished();
+  }
+  foreach (qreal r, rates) {
+    if (r > 0) {
+      slowest = qMin(slowest, r);
+    }
+  }
+  return slowest;
+}
+
+
+/*!
+ * \brief IterationCalibrator::iterationsFor
+ *
+ * \param targetMSecs The desired derivation time in milliseconds.
+ * \param iterationsPerSecond The throughput as returned by `measure()`.
+ * \return The iteration count that meets `targetMSecs`, rounded to a multiple
+ * of `IterationStep` and clamped to [`MinIterations`, `MaxIterations`].
+ */
+int IterationCalibrator::iterationsFor(int targetMSecs, qreal iterationsPerSecond)
+{
+  const qreal iterations = 1e-3 * qreal(targetMSecs) * iterationsPerSecond;
+  const qint64 rounded = qRound64(iterations / IterationStep) * IterationStep;
+  return int(qBound(qint64(MinIterations), rounded, qint64(MaxIterations)));
+}
+
+
+/*!
+ * \brief IterationCalibrator::cacheKey
+ *
+ * \return A string identifying this machine and build. A stored measurement
+ * is only valid as long as the key stays the same.
+ */
+QString IterationCalibrator::cacheKey(void)
+{
+  return QString("%1/%2 %3/%4/%5/%6")
+      .arg(QTSESAM_VERSION)
+      .arg(__DATE__).arg(__TIME__)
+      .arg(QSysInfo::machineHostName())
+      .arg(QSysInfo::currentCpuArchitecture())
+      .arg(CPUFeatures::flags(), 0, 16);
+}
@@ -0,0 +1,51 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __ITERATIONCALIBRATOR_H_
+#define __ITERATIONCALIBRATOR_H_
+
+#include <QtGlobal>
+#include <QString>
+
+
+/*!
+ * \brief The IterationCalibrator class
+ *
+ * Finds the PBKDF2-HMAC-SHA512 iteration count that makes a password
+ * derivation on this machine take about a given time.
+ *
+ * Measuring takes a fraction of a second. Callers should store the
+ * result of `measure()` together with `cacheKey()` and only measure
+ * again when the key changes, i.e. on another machine or build.
+ */
+class IterationCalibrator
+{
+public:
+  static const int DefaultTargetMSecs;
+  static const int MinIterations;
+  static const int MaxIterations;
+  static const int IterationStep;
+
+  static qreal measure(bool allCores = false);
+  static int iterationsFor(int targetMSecs, qreal iterationsPerSecond);
+  static QString cacheKey(void);
+};
+
+
+#endif // __ITERATIONCALIBRATOR_H_
@@ -36,7 +36,6 @@ win32-msvc* {
     DEFINES -= UNICODE
 }
 
-include(3rdparty/bigint/bigint.pri)
 include(3rdparty/cryptopp/cryptopp.pri)
 
 SOURCES += \
@@ -44,8 +43,25 @@ SOURCES += \
     crypter.cpp \
     domainsettings.cpp \
     domainsettingslist.cpp \
+    derivation.cpp \
     password.cpp \
+    passwordtemplateplan.cpp \
+    passwordbatch.cpp \
+    passwordscheduler.cpp \
+    derivedkeycache.cpp \
+    saltkeyivpool.cpp \
+    speculativederiver.cpp \
+    passworddictionary.cpp \
+    breachedhashlist.cpp \
+    strengthestimator.cpp \
+    vaultaudit.cpp \
     pbkdf2.cpp \
+    sha2.cpp \
+    sha512multibuffer.cpp \
+    cpufeatures.cpp \
+    hashbackend.cpp \
+    iterationcalibrator.cpp \
+    cryptoexecutor.cpp \
     securebytearray.cpp \
     securestring.cpp \
     exporter.cpp
@@ -55,8 +71,28 @@ HEADERS +=\
     crypter.h \
     domainsettings.h \
     domainsettingslist.h \
+    derivation.h \
     password.h \
+    passwordtemplateplan.h \
+    passwordbatch.h \
+    passwordscheduler.h \
+    derivedkeycache.h \
+    saltkeyivpool.h \
+    speculativederiver.h \
+    passworddictionary.h \
+    breachedhashlist.h \
+    strengthestimator.h \
+    vaultaudit.h \
+    uint512.h \
     pbkdf2.h \
+    cancellationtoken.h \
+    sha2.h \
+    hmacengine.h \
+    sha512multibuffer.h \
+    cpufeatures.h \
+    hashbackend.h \
+    iterationcalibrator.h \
+    cryptoexecutor.h \
     securebytearray.h \
     securestring.h \
     exporter.h
@@ -20,17 +20,22 @@
 #include <QDebug>
 #include <QtConcurrent>
 #include <QFuture>
-#include <string>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
 
 #include "domainsettings.h"
 #include "securebytearray.h"
 #include "securestring.h"
 #include "password.h"
 #include "pbkdf2.h"
+#include "passwordtemplateplan.h"
+#include "derivedkeycache.h"
+#include "derivation.h"
+#include "cryptoexecutor.h"
 #include "util.h"
 
-#include "3rdparty/bigint/bigInt.h"
-
 Password::Complexity::Complexity(void)
   : digits(false)
   , lowercase(true)
@@ -118,18 +123,70 @@ class PasswordPrivate {
 public:
   PasswordPrivate(void)
     : error(Password::NoError)
+    , elapsed(0)
+    , aborted(false)
+    , keyCache(Q_NULLPTR)
+    , settingsGeneration(0)
+    , settingsSettled(false)
   { /* ... */ }
   ~PasswordPrivate()
   { /* ... */ }
+  bool setDomainSettings(const DomainSettings &newDs, bool onlyIfUnsettled)
+  {
+    const QSharedPointer<const PasswordTemplatePlan> &newPlan = PasswordTemplatePlan::get(newDs.passwordTemplate, newDs.extraCharacters);
+    QMutexLocker locker(&settingsMutex);
+    if (onlyIfUnsettled && settingsSettled)
+      return false;
+    ds = newDs;
+    plan = newPlan;
+    ds.usedCharacters = newPlan->usedCharacters();
+    ++settingsGeneration;
+    return true;
+  }
   DomainSettings ds;
+  QSharedPointer<const PasswordTemplatePlan> plan;
+  QMutex settingsMutex;
+  quint64 settingsGeneration;
+  bool settingsSettled;
   PBKDF2 pbkdf2;
+  SecureByteArray derivedKey;
+  SecureString hexKey;
   SecureString password;
   int error;
   QString errorString;
+  qreal elapsed;
+  bool aborted;
+  DerivedKeyCache *keyCache;
+  QByteArray keyFingerprint;
+  QByteArray pendingKeyFingerprint;
   QFuture<void> future;
 };
 
 
+/*!
+ * \brief Password::keyFingerprint
+ *
+ * \return A SHA-256 hash over all inputs the derived key depends on,
+ * i.e. domain name, user name, key, salt and iterations.
+ */
+QByteArray Password::keyFingerprint(const SecureByteArray &key, const DomainSettings &ds)
+{
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  const QByteArray fields[] = {
+    ds.domainName.toUtf8(),
+    ds.userName.toUtf8(),
+    key,
+    ds.salt_base64.toUtf8(),
+    QByteArray::number(ds.iterations)
+  };
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+    hash.addData(QByteArray::number(fields[i].size()) + ':');
+    hash.addData(fields[i]);
+  }
+  return hash.result();
+}
+
+
 const QString Password::Digits = "0123456789";
 const QString Password::LowerChars = "abcdefghijklmnopqrstuvwxyz";
 const QString Password::UpperChars = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
@@ -141,19 +198,13 @@ const int Password::DefaultComplexityValue = 5;
 const int Password::NoComplexityValue = 0;
 
 
-const Password::TemplateCharacterMap Password::TemplateCharacters = {
-  std::pair<char, QString>('n', Password::Digits),
-  std::pair<char, QString>('a', Password::LowerChars),
-  std::pair<char, QString>('A', Password::UpperChars)
-};
-
-
 Password::Password(const DomainSettings &ds, QObject *parent)
   : QObject(parent)
   , d_ptr(new PasswordPrivate)
 {
   QObject::connect(&d_ptr->pbkdf2, SIGNAL(generationStarted()), SIGNAL(generationStarted()));
   QObject::connect(&d_ptr->pbkdf2, SIGNAL(generationAborted()), SIGNAL(generationAborted()));
+  QObject::connect(&d_ptr->pbkdf2, SIGNAL(generationProgress(int, int, qreal, qreal)), SIGNAL(generationProgress(int, int, qreal, qreal)));
   setDomainSettings(ds);
 }
 
@@ -167,70 +218,20 @@ Password::~Password()
 void Password::setDomainSettings(const DomainSettings &ds)
 {
   Q_D(Password);
-  d->ds = ds;
-  d->ds.usedCharacters.clear();
-  if (d->ds.passwordTemplate.contains('n')) {
-    d->ds.usedCharacters.append(Password::Digits);
-  }
-  if (d->ds.passwordTemplate.contains('a')) {
-    d->ds.usedCharacters.append(Password::LowerChars);
-  }
-  if (d->ds.passwordTemplate.contains('A')) {
-    d->ds.usedCharacters.append(Password::UpperChars);
-  }
-  if (d->ds.passwordTemplate.contains('o')) {
-    d->ds.usedCharacters.append(d_ptr->ds.extraCharacters);
-  }
+  d->setDomainSettings(ds, false);
 }
 
 
 SecureString Password::remix(void)
 {
   Q_D(Password);
+  QMutexLocker locker(&d->settingsMutex);
   d->password.clear();
-  if (d->ds.usedCharacters.isEmpty()) {
-    d->error = EmptyCharacterSetError;
-    d->errorString = "used character set must not be empty";
+  d->error = d->plan->error();
+  d->errorString = d->plan->errorString();
+  if (d->error != NoError)
     return SecureString();
-  }
-  if (d->ds.passwordTemplate.isEmpty()) {
-    d->error = EmptyTemplateError;
-    d->errorString = "password template is empty";
-    return SecureString();
-  }
-  d->error = NoError;
-  d->errorString.clear();
-  BigInt::Rossi v(d->pbkdf2.hexKey().toStdString(), BigInt::HEX_DIGIT);
-  foreach (QChar c, d->ds.passwordTemplate) {
-    QString charSet;
-    const char m = c.toLatin1();
-    switch (m) {
-    case 'x':
-      charSet = d->ds.usedCharacters;
-      break;
-    case 'o':
-      charSet = d->ds.extraCharacters;
-      break;
-    case 'a': // fall-through
-    case 'A': // fall-through
-    case 'n':
-      charSet = TemplateCharacters[m];
-      break;
-    default:
-      d->error = EmptyTemplateError;
-      d->errorString = QString("invalid template character: %1").arg(m);
-      return SecureString();
-    }
-    if (charSet.isEmpty()) {
-      d->error = EmptyCharacterSetError;
-      d->errorString = QString("character set for template character %1 must not be empty").arg(m);
-      return SecureString();
-    }
-    const BigInt::Rossi Modulus(QString("%1").arg(charSet.size()).toStdString(), BigInt::DEC_DIGIT);
-    const BigInt::Rossi &mod = v % Modulus;
-    d->password.append(charSet.at(int(mod.toUlong())));
-    v = v / Modulus;
-  }
+  d->password = Derivation::shape(*d->plan, d->derivedKey);
   return d->password;
 }
 
@@ -238,15 +239,53 @@ SecureString Password::remix(void)
 void Password::generate(const SecureByteArray &key)
 {
   Q_D(Password);
-  const SecureByteArray &pwd =
-      d->ds.domainName.toUtf8() +
-      d->ds.userName.toUtf8() +
-      key;
-  d->pbkdf2.generate(pwd,
-                     QByteArray::fromBase64(d->ds.salt_base64.toUtf8()),
-                     d->ds.iterations,
-                     QCryptographicHash::Sha512);
-  remix();
+  d->pbkdf2.cancellationToken()->reset();
+  derive(key);
+}
+
+
+/*!
+ * \brief Password::derive
+ *
+ * Runs the key derivation and remixes the result. Doesn't reset the
+ * cancellation token; `generate()` and `generateAsync()` do that before.
+ */
+void Password::derive(const SecureByteArray &key)
+{
+  Q_D(Password);
+  d->settingsMutex.lock();
+  const DomainSettings ds = d->ds;
+  d->settingsSettled = false;
+  d->settingsMutex.unlock();
+  d->keyFingerprint.clear();
+  const quint64 cacheGeneration = d->keyCache != Q_NULLPTR ? d->keyCache->generation() : 0;
+  const DerivationRequest request(key, ds);
+  d->pbkdf2.generate(request.pwd, request.salt, request.iterations, request.algorithm);
+  d->aborted = d->pbkdf2.isAborted();
+  d->derivedKey = d->pbkdf2.derivedKey();
+  d->hexKey = d->pbkdf2.hexKey();
+  if (!d->aborted) {
+    d->keyFingerprint = Password::keyFingerprint(key, ds);
+    if (d->keyCache != Q_NULLPTR) {
+      d->keyCache->insert(d->keyFingerprint, d->derivedKey, cacheGeneration);
+    }
+  }
+  QElapsedTimer remixTimer;
+  remixTimer.start();
+  // update() may change the settings while remix() runs; remix again
+  // until they're stable, then refuse further changes to this run.
+  forever {
+    d->settingsMutex.lock();
+    const quint64 generation = d->settingsGeneration;
+    d->settingsMutex.unlock();
+    remix();
+    QMutexLocker locker(&d->settingsMutex);
+    if (generation == d->settingsGeneration) {
+      d->settingsSettled = true;
+      break;
+    }
+  }
+  d->elapsed = d->pbkdf2.elapsedSeconds() + 1e-9 * remixTimer.nsecsElapsed();
   emit generated();
 }
 
@@ -254,8 +293,104 @@ void Password::generate(const SecureByteArray &key)
 void Password::generateAsync(const SecureByteArray &key, const DomainSettings &domainSettings)
 {
   Q_D(Password);
+  d->settingsMutex.lock();
+  d->settingsSettled = false;
+  d->settingsMutex.unlock();
   setDomainSettings(domainSettings);
-  d->future = QtConcurrent::run(this, &Password::generate, key);
+  d->pendingKeyFingerprint = Password::keyFingerprint(key, domainSettings);
+  d->pbkdf2.cancellationToken()->reset();
+  d->future = CryptoExecutor::instance().run(CryptoExecutor::Interactive, "password", [this, key]() {
+    derive(key);
+  });
+}
+
+
+/*!
+ * \brief Password::needsKeyDerivation
+ *
+ * \return `true` if the password for `domainSettings` cannot be obtained by
+ * remixing the current (or currently computed) derived key, because at least
+ * one of the inputs of the key derivation (domain name, user name, `key`,
+ * salt, iterations) differs.
+ */
+bool Password::needsKeyDerivation(const SecureByteArray &key, const DomainSettings &domainSettings) const
+{
+  const QByteArray &fingerprint = Password::keyFingerprint(key, domainSettings);
+  if (isRunning() && fingerprint == d_ptr->pendingKeyFingerprint)
+    return false;
+  if (!isRunning() && !d_ptr->keyFingerprint.isEmpty() && fingerprint == d_ptr->keyFingerprint)
+    return false;
+  return d_ptr->keyCache == Q_NULLPTR || !d_ptr->keyCache->contains(fingerprint);
+}
+
+
+/*!
+ * \brief Password::setKeyCache
+ *
+ * Lets `update()` take derived keys from `cache` instead of running PBKDF2
+ * and adds every completed derivation to it. `cache` is not owned.
+ */
+void Password::setKeyCache(DerivedKeyCache *cache)
+{
+  d_ptr->keyCache = cache;
+}
+
+
+DerivedKeyCache *Password::keyCache(void) const
+{
+  return d_ptr->keyCache;
+}
+
+
+/*!
+ * \brief Password::update
+ *
+ * Brings the password up to date with `domainSettings`.
+ *
+ * If only output-shaping parameters (template, extra characters) changed,
+ * the current derived key is remixed immediately and `generated()` is
+ * emitted before this function returns. The same applies if the key cache
+ * holds a key for the new inputs. If a derivation with the same key
+ * inputs is already running, it picks up the new settings when it finishes;
+ * if it has already shaped its final password, it is waited for and its key
+ * is remixed here. Otherwise a running derivation is aborted and a new one
+ * is started.
+ *
+ * \return `true` if a key derivation has been started.
+ */
+bool Password::update(const SecureByteArray &key, const DomainSettings &domainSettings)
+{
+  Q_D(Password);
+  const QByteArray &fingerprint = Password::keyFingerprint(key, domainSettings);
+  if (isRunning()) {
+    if (fingerprint == d->pendingKeyFingerprint) {
+      if (d->setDomainSettings(domainSettings, true))
+        return false;
+    }
+    else {
+      abortGeneration();
+    }
+    waitForFinished();
+  }
+  SecureByteArray cachedKey;
+  const bool current = !d->keyFingerprint.isEmpty() && fingerprint == d->keyFingerprint;
+  if (current || (d->keyCache != Q_NULLPTR && d->keyCache->lookup(fingerprint, cachedKey))) {
+    setDomainSettings(domainSettings);
+    if (!current) {
+      d->derivedKey = cachedKey;
+      d->hexKey = SecureString(cachedKey.toHex());
+      d->keyFingerprint = fingerprint;
+    }
+    d->aborted = false;
+    QElapsedTimer remixTimer;
+    remixTimer.start();
+    remix();
+    d->elapsed = 1e-9 * remixTimer.nsecsElapsed();
+    emit generated();
+    return false;
+  }
+  generateAsync(key, domainSettings);
+  return true;
 }
 
 
@@ -267,13 +402,13 @@ bool Password::isRunning(void) const
 
 bool Password::isAborted(void) const
 {
-  return d_ptr->pbkdf2.isAborted();
+  return isRunning() ? d_ptr->pbkdf2.isAborted() : d_ptr->aborted;
 }
 
 
 qreal Password::elapsedSeconds(void) const
 {
-  return d_ptr->pbkdf2.elapsedSeconds();
+  return d_ptr->elapsed;
 }
 
 
@@ -291,7 +426,7 @@ const SecureString &Password::password(void) const
 
 const SecureString &Password::hexKey(void) const
 {
-  return d_ptr->pbkdf2.hexKey();
+  return d_ptr->hexKey;
 }
 
 
@@ -34,6 +34,7 @@
 #include "domainsettings.h"
 
 class PasswordPrivate;
+class DerivedKeyCache;
 
 
 class Password : public QObject
@@ -70,7 +71,8 @@ public:
     NoError,
     EmptyCharacterSetError,
     EmptyTemplateError,
-    InvalidTemplateError
+    InvalidTemplateError,
+    AbortedError
   };
 
   static const QString Digits;
@@ -93,6 +95,11 @@ public:
 
   void generate(const SecureByteArray &key);
   void generateAsync(const SecureByteArray &key, const DomainSettings &domainSettings = DomainSettings());
+  static QByteArray keyFingerprint(const SecureByteArray &key, const DomainSettings &domainSettings);
+  bool needsKeyDerivation(const SecureByteArray &key, const DomainSettings &domainSettings) const;
+  bool update(const SecureByteArray &key, const DomainSettings &domainSettings);
+  void setKeyCache(DerivedKeyCache *cache);
+  DerivedKeyCache *keyCache(void) const;
 
   bool isRunning(void) const;
   bool isAborted(void) const;
@@ -103,13 +110,14 @@ signals:
   void generated(void);
   void generationStarted(void);
   void generationAborted(void);
+  void generationProgress(int iterationsDone, int iterations, qreal iterationsPerSecond, qreal secondsRemaining);
 
 private:
+  void derive(const SecureByteArray &key);
+
   QScopedPointer<PasswordPrivate> d_ptr;
   Q_DECLARE_PRIVATE(Password)
   Q_DISABLE_COPY(Password)
-
-  static const TemplateCharacterMap TemplateCharacters;
 };
 
 
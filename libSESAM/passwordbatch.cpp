@@ -0,0 +1,129 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "passwordbatch.h"
+#include "password.h"
+#include "passwordtemplateplan.h"
+#include "pbkdf2.h"
+#include "derivation.h"
+#include "sha512multibuffer.h"
+#include "cryptoexecutor.h"
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QThread>
+#include <QVector>
+
+
+/*!
+ * \brief PasswordBatch::derive
+ *
+ * Derives the passwords for all `domains` from `key`. Blocks until all
+ * passwords have been derived or the derivation has been cancelled,
+ * so better call it from a worker thread. The groups are shared between
+ * the calling thread and `CryptoExecutor::Normal` helpers; helpers that
+ * haven't started when the calling thread runs out of work are dropped,
+ * so this is safe to call from a `CryptoExecutor` task.
+ *
+ * \param domains The domains to derive the passwords for. Legacy passwords, deletion and expiry are not taken into account.
+ * \param key The key generation key.
+ * \param callback Called once per domain with `Result::index` being the index in `domains`.
+ * Calls are serialized, but may come from any thread. `Result::error` is one of `Password::PasswordError`;
+ * `Password::AbortedError` means that the domain was skipped because `token` had been cancelled.
+ * \param token If not `Q_NULLPTR`, checked before each group of derivations is started.
+ * \param maxThreads Maximum number of threads, including the calling one. `QThread::idealThreadCount()` if <= 0.
+ */
+void PasswordBatch::derive(const DomainSettingsList &domains, const SecureByteArray &key, const Callback &callback, const CancellationToken *token, int maxThreads)
+{
+  QMutex callbackMutex;
+  auto report = [&callback, &callbackMutex](const Result &result) {
+    QMutexLocker locker(&callbackMutex);
+    callback(result);
+  };
+
+  QVector<QSharedPointer<const PasswordTemplatePlan> > plans(domains.size());
+  QVector<int> pending;
+  pending.reserve(domains.size());
+  for (int i = 0; i < domains.size(); ++i) {
+    const DomainSettings &ds = domains.at(i);
+    plans[i] = PasswordTemplatePlan::get(ds.passwordTemplate, ds.extraCharacters);
+    if (plans.at(i)->error() != Password::NoError) {
+      Result result;
+      result.index = i;
+      result.error = plans.at(i)->error();
+      result.errorString = plans.at(i)->errorString();
+      report(result);
+    }
+    else {
+      pending.append(i);
+    }
+  }
+
+  auto deriveGroup = [&](const QVector<int> &group) {
+    if (token != Q_NULLPTR && token->isCancelled()) {
+      foreach (int i, group) {
+        Result result;
+        result.index = i;
+        result.error = Password::AbortedError;
+        result.errorString = "derivation cancelled";
+        report(result);
+      }
+      return;
+    }
+    QVector<PBKDF2Job> jobs;
+    jobs.reserve(group.size());
+    foreach (int i, group) {
+      const DerivationRequest request(key, domains.at(i));
+      jobs.append(PBKDF2Job(request.pwd, request.salt, request.iterations));
+    }
+    const QVector<SecureByteArray> &keys = PBKDF2::generateBatch(jobs);
+    for (int j = 0; j < group.size(); ++j) {
+      Result result;
+      result.index = group.at(j);
+      result.password = Derivation::shape(*plans.at(group.at(j)), keys.at(j));
+      report(result);
+    }
+  };
+
+  const int lanes = Sha512MultiBuffer::bestKernel().lanes;
+  const int groupCount = (pending.size() + lanes - 1) / lanes;
+  QAtomicInt nextGroup(0);
+  auto work = [&](void) {
+    forever {
+      const int g = nextGroup.fetchAndAddOrdered(1);
+      if (g >= groupCount)
+        return;
+      deriveGroup(pending.mid(g * lanes, lanes));
+    }
+  };
+  const QString tag = QString("passwordbatch:%1").arg(quintptr(&nextGroup), 0, 16);
+  const int helperCount = qMin(groupCount, maxThreads > 0 ? maxThreads : QThread::idealThreadCount()) - 1;
+  QVector<QFuture<void> > helpers;
+  for (int h = 0; h < helperCount; ++h) {
+    helpers.append(CryptoExecutor::instance().run(CryptoExecutor::Normal, tag, work));
+  }
+  work();
+  CryptoExecutor::instance().cancel(tag);
+  foreach (QFuture<void> helper, helpers) {
+    helper.waitForFinished();
+  }
+}
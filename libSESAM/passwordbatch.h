@@ -0,0 +1,65 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PASSWORDBATCH_H_
+#define __PASSWORDBATCH_H_
+
+#include <QString>
+
+#include <functional>
+
+#include "securebytearray.h"
+#include "securestring.h"
+#include "domainsettingslist.h"
+#include "cancellationtoken.h"
+
+
+/*!
+ * \brief The PasswordBatch class
+ *
+ * Derives the passwords of many domains at once without creating a
+ * `Password` object per domain.
+ *
+ * The domains are grouped by the number of lanes of the fastest
+ * `Sha512MultiBuffer` kernel; the groups are derived on the calling thread
+ * and on `CryptoExecutor` helpers, so `CryptoExecutor::cancel()` and its
+ * priority classes apply to them. Every result is handed to a single callback as soon as
+ * its group is finished, i.e. in completion order, not in list order.
+ */
+class PasswordBatch
+{
+public:
+  struct Result {
+    Result(void)
+      : index(-1)
+      , error(0)
+    { /* ... */ }
+    int index;
+    int error;
+    QString errorString;
+    SecureString password;
+  };
+
+  typedef std::function<void(const Result &)> Callback;
+
+  static void derive(const DomainSettingsList &domains, const SecureByteArray &key, const Callback &callback, const CancellationToken *token = Q_NULLPTR, int maxThreads = -1);
+};
+
+
+#endif // __PASSWORDBATCH_H_
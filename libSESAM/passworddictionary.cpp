@@ -0,0 +1,453 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "passworddictionary.h"
+
+#include <QFile>
+#include <QVector>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+  /* File layout (all integers little endian):
+   *   header    magic[8], quint32 version, quint32 blockSize,
+   *             quint64 wordCount, quint64 directoryOffset, quint64 blockCount
+   *   blocks    first entry:  varint length, bytes
+   *             other entries: varint shared prefix length, varint suffix length, suffix bytes
+   *   directory per block: quint64 block offset, varint length of first entry, bytes
+   */
+  const char Magic[8] = { 'S', 'E', 'S', 'A', 'M', 'D', 'I', 'C' };
+  const quint32 Version = 1;
+  const int HeaderSize = 40;
+  const int MaxKeyLength = 1024;
+
+  void appendVarint(QByteArray &buf, quint64 v)
+  {
+    while (v >= 0x80) {
+      buf.append(char(v | 0x80));
+      v >>= 7;
+    }
+    buf.append(char(v));
+  }
+
+  bool readVarint(const uchar *&p, const uchar *end, quint64 &v)
+  {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+      const uchar b = *p++;
+      v |= quint64(b & 0x7f) << shift;
+      if ((b & 0x80) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  int compareKeys(const uchar *a, int aLen, const uchar *b, int bLen)
+  {
+    const int rc = memcmp(a, b, size_t(qMin(aLen, bLen)));
+    if (rc != 0)
+      return rc;
+    return aLen - bLen;
+  }
+
+  int compareKeys(const QByteArray &a, const QByteArray &b)
+  {
+    return compareKeys(reinterpret_cast<const uchar *>(a.constData()), a.size(),
+                       reinterpret_cast<const uchar *>(b.constData()), b.size());
+  }
+
+}
+
+
+class PasswordDictionaryPrivate
+{
+public:
+  PasswordDictionaryPrivate(void)
+    : data(Q_NULLPTR)
+    , size(0)
+    , count(0)
+    , blockSize(0)
+    , directoryOffset(0)
+  { /* ... */ }
+  ~PasswordDictionaryPrivate()
+  { /* ... */ }
+  struct Block {
+    quint64 offset;
+    quint64 keyPos;
+    int keyLen;
+  };
+  QFile file;
+  const uchar *data;
+  qint64 size;
+  quint64 count;
+  int blockSize;
+  quint64 directoryOffset;
+  QVector<Block> blocks;
+  QString errorString;
+};
+
+
+const int PasswordDictionary::DefaultBlockSize = 64;
+
+
+PasswordDictionary::PasswordDictionary(void)
+  : d_ptr(new PasswordDictionaryPrivate)
+{ /* ... */ }
+
+
+PasswordDictionary::~PasswordDictionary()
+{
+  close();
+}
+
+
+/*!
+ * \brief PasswordDictionary::key
+ *
+ * \return The representation of `word` stored in a dictionary.
+ */
+QByteArray PasswordDictionary::key(const QString &word)
+{
+  return word.toCaseFolded().toUtf8();
+}
+
+
+bool PasswordDictionary::isDictionaryFile(const QString &filename)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  return file.read(sizeof(Magic)) == QByteArray(Magic, sizeof(Magic));
+}
+
+
+bool PasswordDictionary::open(const QString &filename)
+{
+  Q_D(PasswordDictionary);
+  close();
+  d->file.setFileName(filename);
+  if (!d->file.open(QIODevice::ReadOnly)) {
+    d->errorString = d->file.errorString();
+    return false;
+  }
+  d->size = d->file.size();
+  if (d->size >= HeaderSize) {
+    d->data = d->file.map(0, d->size);
+  }
+  if (d->data == Q_NULLPTR || memcmp(d->data, Magic, sizeof(Magic)) != 0) {
+    d->errorString = "not a password dictionary";
+    close();
+    return false;
+  }
+  const quint32 version = qFromLittleEndian<quint32>(d->data + 8);
+  const quint32 blockSize = qFromLittleEndian<quint32>(d->data + 12);
+  d->count = qFromLittleEndian<quint64>(d->data + 16);
+  d->directoryOffset = qFromLittleEndian<quint64>(d->data + 24);
+  const quint64 blockCount = qFromLittleEndian<quint64>(d->data + 32);
+  if (version != Version || blockSize == 0 || blockSize > 0x10000
+      || d->directoryOffset < quint64(HeaderSize) || d->directoryOffset > quint64(d->size)
+      || blockCount != (d->count + blockSize - 1) / blockSize) {
+    d->errorString = "corrupt password dictionary header";
+    close();
+    return false;
+  }
+  d->blockSize = int(blockSize);
+  d->blocks.reserve(int(blockCount));
+  const uchar *p = d->data + d->directoryOffset;
+  const uchar *end = d->data + d->size;
+  quint64 previousOffset = 0;
+  for (quint64 i = 0; i < blockCount; ++i) {
+    PasswordDictionaryPrivate::Block block;
+    quint64 keyLen = 0;
+    if (end - p < 8) {
+      break;
+    }
+    block.offset = qFromLittleEndian<quint64>(p);
+    p += 8;
+    if (!readVarint(p, end, keyLen) || keyLen == 0 || keyLen > quint64(MaxKeyLength) || quint64(end - p) < keyLen
+        || block.offset < quint64(HeaderSize) || block.offset >= d->directoryOffset || block.offset <= previousOffset) {
+      break;
+    }
+    block.keyPos = quint64(p - d->data);
+    block.keyLen = int(keyLen);
+    p += keyLen;
+    previousOffset = block.offset;
+    d->blocks.append(block);
+  }
+  if (quint64(d->blocks.size()) != blockCount) {
+    d->errorString = "corrupt password dictionary directory";
+    close();
+    return false;
+  }
+  return true;
+}
+
+
+void PasswordDictionary::close(void)
+{
+  Q_D(PasswordDictionary);
+  d->file.close();
+  d->data = Q_NULLPTR;
+  d->size = 0;
+  d->count = 0;
+  d->blockSize = 0;
+  d->directoryOffset = 0;
+  d->blocks.clear();
+}
+
+
+bool PasswordDictionary::isOpen(void) const
+{
+  return d_ptr->data != Q_NULLPTR;
+}
+
+
+QString PasswordDictionary::errorString(void) const
+{
+  return d_ptr->errorString;
+}
+
+
+quint64 PasswordDictionary::count(void) const
+{
+  return d_ptr->count;
+}
+
+
+int PasswordDictionary::blockSize(void) const
+{
+  return d_ptr->blockSize;
+}
+
+
+bool PasswordDictionary::contains(const QString &word) const
+{
+  return find(word) >= 0;
+}
+
+
+/*!
+ * \brief PasswordDictionary::find
+ *
+ * \return The index of `word` in the dictionary, or -1 if it isn't listed.
+ */
+qint64 PasswordDictionary::find(const QString &word) const
+{
+  Q_D(const PasswordDictionary);
+  const QByteArray &k = key(word);
+  if (!isOpen() || k.isEmpty() || d->blocks.isEmpty())
+    return -1;
+  const uchar *kData = reinterpret_cast<const uchar *>(k.constData());
+  int lo = 0;
+  int hi = d->blocks.size();
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    const PasswordDictionaryPrivate::Block &block = d->blocks.at(mid);
+    if (compareKeys(d->data + block.keyPos, block.keyLen, kData, k.size()) <= 0) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  if (lo == 0)
+    return -1;
+  const int b = lo - 1;
+  const uchar *p = d->data + d->blocks.at(b).offset;
+  const uchar *end = d->data + (b + 1 < d->blocks.size() ? d->blocks.at(b + 1).offset : d->directoryOffset);
+  qint64 index = qint64(b) * d->blockSize;
+  QByteArray current;
+  quint64 len = 0;
+  if (!readVarint(p, end, len) || len > quint64(end - p))
+    return -1;
+  current.append(reinterpret_cast<const char *>(p), int(len));
+  p += len;
+  forever {
+    const int comparison = compareKeys(current, k);
+    if (comparison == 0)
+      return index;
+    if (comparison > 0 || p >= end)
+      return -1;
+    quint64 shared = 0;
+    if (!readVarint(p, end, shared) || !readVarint(p, end, len) || shared > quint64(current.size()) || len > quint64(end - p))
+      return -1;
+    current.truncate(int(shared));
+    current.append(reinterpret_cast<const char *>(p), int(len));
+    p += len;
+    ++index;
+  }
+}
+
+
+class PasswordDictionaryBuilderPrivate
+{
+public:
+  PasswordDictionaryBuilderPrivate(QIODevice *device, int blockSize)
+    : device(device)
+    , blockSize(qBound(1, blockSize, 0x10000))
+    , headerPos(0)
+    , written(0)
+    , count(0)
+    , blockCount(0)
+    , ok(true)
+  { /* ... */ }
+  ~PasswordDictionaryBuilderPrivate()
+  { /* ... */ }
+  bool write(const QByteArray &data)
+  {
+    if (ok && device->write(data) != data.size()) {
+      errorString = device->errorString();
+      ok = false;
+    }
+    written += quint64(data.size());
+    return ok;
+  }
+  QIODevice *device;
+  int blockSize;
+  qint64 headerPos;
+  quint64 written;
+  quint64 count;
+  quint64 blockCount;
+  QByteArray previous;
+  QByteArray directory;
+  QByteArray entry;
+  QString errorString;
+  bool ok;
+};
+
+
+PasswordDictionaryBuilder::PasswordDictionaryBuilder(QIODevice *device, int blockSize)
+  : d_ptr(new PasswordDictionaryBuilderPrivate(device, blockSize))
+{
+  Q_D(PasswordDictionaryBuilder);
+  d->headerPos = d->device->pos();
+  d->write(QByteArray(HeaderSize, '\0'));
+}
+
+
+PasswordDictionaryBuilder::~PasswordDictionaryBuilder()
+{ /* ... */ }
+
+
+bool PasswordDictionaryBuilder::add(const QString &word)
+{
+  return addKey(PasswordDictionary::key(word));
+}
+
+
+/*!
+ * \brief PasswordDictionaryBuilder::addKey
+ *
+ * Appends an already case-folded, UTF-8 encoded entry.
+ *
+ * \return `false` if `key` sorts before the previous entry or the entry
+ * couldn't be written.
+ */
+bool PasswordDictionaryBuilder::addKey(const QByteArray &key)
+{
+  Q_D(PasswordDictionaryBuilder);
+  if (!d->ok)
+    return false;
+  if (key.isEmpty())
+    return true;
+  if (key.size() > MaxKeyLength) {
+    d->errorString = QString("entry exceeds %1 bytes").arg(MaxKeyLength);
+    return false;
+  }
+  if (d->count > 0) {
+    const int comparison = compareKeys(key, d->previous);
+    if (comparison == 0)
+      return true;
+    if (comparison < 0) {
+      d->errorString = "entries are not in ascending order";
+      return false;
+    }
+  }
+  d->entry.clear();
+  if (d->count % quint64(d->blockSize) == 0) {
+    const quint64 offset = d->written;
+    uchar le[8];
+    qToLittleEndian<quint64>(offset, le);
+    d->directory.append(reinterpret_cast<const char *>(le), sizeof(le));
+    appendVarint(d->directory, quint64(key.size()));
+    d->directory.append(key);
+    appendVarint(d->entry, quint64(key.size()));
+    d->entry.append(key);
+    ++d->blockCount;
+  }
+  else {
+    const int maxShared = qMin(key.size(), d->previous.size());
+    int shared = 0;
+    while (shared < maxShared && key.at(shared) == d->previous.at(shared)) {
+      ++shared;
+    }
+    appendVarint(d->entry, quint64(shared));
+    appendVarint(d->entry, quint64(key.size() - shared));
+    d->entry.append(key.constData() + shared, key.size() - shared);
+  }
+  if (!d->write(d->entry))
+    return false;
+  d->previous = key;
+  ++d->count;
+  return true;
+}
+
+
+/*!
+ * \brief PasswordDictionaryBuilder::finish
+ *
+ * Writes the block directory and the header. No words can be added afterwards.
+ */
+bool PasswordDictionaryBuilder::finish(void)
+{
+  Q_D(PasswordDictionaryBuilder);
+  const quint64 directoryOffset = d->written;
+  if (!d->write(d->directory))
+    return false;
+  uchar header[HeaderSize];
+  memcpy(header, Magic, sizeof(Magic));
+  qToLittleEndian<quint32>(Version, header + 8);
+  qToLittleEndian<quint32>(quint32(d->blockSize), header + 12);
+  qToLittleEndian<quint64>(d->count, header + 16);
+  qToLittleEndian<quint64>(directoryOffset, header + 24);
+  qToLittleEndian<quint64>(d->blockCount, header + 32);
+  const qint64 endPos = d->device->pos();
+  if (!d->device->seek(d->headerPos)
+      || d->device->write(reinterpret_cast<const char *>(header), HeaderSize) != HeaderSize
+      || !d->device->seek(endPos)) {
+    d->errorString = d->device->errorString();
+    d->ok = false;
+  }
+  d->directory.clear();
+  return d->ok;
+}
+
+
+quint64 PasswordDictionaryBuilder::count(void) const
+{
+  return d_ptr->count;
+}
+
+
+QString PasswordDictionaryBuilder::errorString(void) const
+{
+  return d_ptr->errorString;
+}
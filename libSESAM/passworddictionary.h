@@ -0,0 +1,108 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PASSWORDDICTIONARY_H_
+#define __PASSWORDDICTIONARY_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+#include <QIODevice>
+#include <QScopedPointer>
+
+class PasswordDictionaryPrivate;
+class PasswordDictionaryBuilderPrivate;
+
+/*!
+ * \brief The PasswordDictionary class
+ *
+ * Read-only access to a binary password dictionary as written by
+ * `PasswordDictionaryBuilder`.
+ *
+ * A dictionary stores case-folded passwords in ascending byte order.
+ * They are grouped into blocks of `blockSize()` entries. Within a block,
+ * every entry after the first one only stores the length of the prefix
+ * it shares with its predecessor plus the remaining suffix (front coding).
+ * A directory at the end of the file holds the offset and first entry of
+ * every block.
+ *
+ * `open()` maps the file and keeps only the block directory in memory.
+ * A lookup does a binary search over the directory and then decodes a
+ * single block, so it touches one block of the file.
+ *
+ * Lookups are case-insensitive. `find()` may be called from several
+ * threads at once.
+ */
+class PasswordDictionary
+{
+public:
+  PasswordDictionary(void);
+  ~PasswordDictionary();
+
+  static const int DefaultBlockSize;
+
+  bool open(const QString &filename);
+  void close(void);
+  bool isOpen(void) const;
+  QString errorString(void) const;
+
+  qint64 find(const QString &word) const;
+  bool contains(const QString &word) const;
+  quint64 count(void) const;
+  int blockSize(void) const;
+
+  static QByteArray key(const QString &word);
+  static bool isDictionaryFile(const QString &filename);
+
+private:
+  QScopedPointer<PasswordDictionaryPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(PasswordDictionary)
+  Q_DISABLE_COPY(PasswordDictionary)
+};
+
+
+/*!
+ * \brief The PasswordDictionaryBuilder class
+ *
+ * Writes a `PasswordDictionary` to a seekable `QIODevice`.
+ *
+ * Words must be added in ascending order of their `PasswordDictionary::key()`.
+ * Duplicates (after case folding) are skipped. `finish()` appends the block
+ * directory and fills in the file header.
+ */
+class PasswordDictionaryBuilder
+{
+public:
+  explicit PasswordDictionaryBuilder(QIODevice *device, int blockSize = PasswordDictionary::DefaultBlockSize);
+  ~PasswordDictionaryBuilder();
+
+  bool add(const QString &word);
+  bool addKey(const QByteArray &key);
+  bool finish(void);
+  quint64 count(void) const;
+  QString errorString(void) const;
+
+private:
+  QScopedPointer<PasswordDictionaryBuilderPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(PasswordDictionaryBuilder)
+  Q_DISABLE_COPY(PasswordDictionaryBuilder)
+};
+
+
+#endif // __PASSWORDDICTIONARY_H_
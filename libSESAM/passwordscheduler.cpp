@@ -0,0 +1,154 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "passwordscheduler.h"
+#include "password.h"
+#include "util.h"
+
+#include <QTimer>
+
+
+const int PasswordScheduler::DefaultDebounceMSecs = 150;
+
+
+class PasswordSchedulerPrivate {
+public:
+  PasswordSchedulerPrivate(Password *password)
+    : password(password)
+    , pending(false)
+  {
+    timer.setSingleShot(true);
+    timer.setInterval(PasswordScheduler::DefaultDebounceMSecs);
+  }
+  ~PasswordSchedulerPrivate()
+  {
+    SecureErase(key);
+  }
+  void clearPending(void)
+  {
+    timer.stop();
+    SecureErase(key);
+    domainSettings = DomainSettings();
+    pending = false;
+  }
+  Password *password;
+  QTimer timer;
+  SecureByteArray key;
+  DomainSettings domainSettings;
+  bool pending;
+};
+
+
+PasswordScheduler::PasswordScheduler(Password *password, QObject *parent)
+  : QObject(parent)
+  , d_ptr(new PasswordSchedulerPrivate(password))
+{
+  Q_D(PasswordScheduler);
+  QObject::connect(&d->timer, SIGNAL(timeout()), SLOT(dispatch()));
+}
+
+
+PasswordScheduler::~PasswordScheduler()
+{ /* ... */ }
+
+
+void PasswordScheduler::setDebounceInterval(int msecs)
+{
+  d_ptr->timer.setInterval(msecs);
+}
+
+
+int PasswordScheduler::debounceInterval(void) const
+{
+  return d_ptr->timer.interval();
+}
+
+
+bool PasswordScheduler::hasPendingRequest(void) const
+{
+  return d_ptr->pending;
+}
+
+
+/*!
+ * \brief PasswordScheduler::request
+ *
+ * Asks for the password for `domainSettings` derived from `key`.
+ *
+ * If no key derivation is needed the request is served immediately and a
+ * pending derivation is dropped. Otherwise the request replaces the pending
+ * one and the debounce window is restarted.
+ */
+void PasswordScheduler::request(const SecureByteArray &key, const DomainSettings &domainSettings)
+{
+  Q_D(PasswordScheduler);
+  if (!d->password->needsKeyDerivation(key, domainSettings)) {
+    d->clearPending();
+    d->password->update(key, domainSettings);
+    return;
+  }
+  d->key = key;
+  d->domainSettings = domainSettings;
+  d->pending = true;
+  d->timer.start();
+  emit derivationScheduled();
+}
+
+
+/*!
+ * \brief PasswordScheduler::flush
+ *
+ * Dispatches the pending request without waiting for the debounce window to elapse.
+ */
+void PasswordScheduler::flush(void)
+{
+  Q_D(PasswordScheduler);
+  if (d->pending) {
+    dispatch();
+  }
+}
+
+
+/*!
+ * \brief PasswordScheduler::cancel
+ *
+ * Drops the pending request and aborts a running derivation.
+ */
+void PasswordScheduler::cancel(void)
+{
+  Q_D(PasswordScheduler);
+  d->clearPending();
+  if (d->password->isRunning()) {
+    d->password->abortGeneration();
+    d->password->waitForFinished();
+  }
+}
+
+
+void PasswordScheduler::dispatch(void)
+{
+  Q_D(PasswordScheduler);
+  if (!d->pending)
+    return;
+  const SecureByteArray key = d->key;
+  const DomainSettings ds = d->domainSettings;
+  d->clearPending();
+  d->password->update(key, ds);
+  emit derivationDispatched();
+}
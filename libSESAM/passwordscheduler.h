@@ -0,0 +1,76 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PASSWORDSCHEDULER_H_
+#define __PASSWORDSCHEDULER_H_
+
+#include <QObject>
+#include <QScopedPointer>
+
+#include "domainsettings.h"
+#include "securebytearray.h"
+
+class Password;
+class PasswordSchedulerPrivate;
+
+/*!
+ * \brief The PasswordScheduler class
+ *
+ * `PasswordScheduler` sits in front of a `Password` and coalesces
+ * interactive update requests.
+ *
+ * Requests that can be served by remixing the current derived key are
+ * forwarded at once. Requests that need a new key derivation are held
+ * back for `debounceInterval()` milliseconds; every further request
+ * within that window replaces the pending one (latest wins), so at most
+ * one derivation is started per window. Starting a derivation aborts
+ * and joins a running one first.
+ */
+class PasswordScheduler : public QObject
+{
+  Q_OBJECT
+public:
+  explicit PasswordScheduler(Password *password, QObject *parent = Q_NULLPTR);
+  ~PasswordScheduler();
+
+  static const int DefaultDebounceMSecs;
+
+  void setDebounceInterval(int msecs);
+  int debounceInterval(void) const;
+  bool hasPendingRequest(void) const;
+
+  void request(const SecureByteArray &key, const DomainSettings &domainSettings);
+  void flush(void);
+  void cancel(void);
+
+signals:
+  void derivationScheduled(void);
+  void derivationDispatched(void);
+
+private slots:
+  void dispatch(void);
+
+private:
+  QScopedPointer<PasswordSchedulerPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(PasswordScheduler)
+  Q_DISABLE_COPY(PasswordScheduler)
+};
+
+
+#endif // __PASSWORDSCHEDULER_H_
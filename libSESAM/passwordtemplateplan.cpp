@@ -0,0 +1,161 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "passwordtemplateplan.h"
+#include "password.h"
+#include "uint512.h"
+
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cmath>
+
+
+const int PasswordTemplatePlan::MaxCachedPlans = 256;
+
+
+PasswordTemplatePlan::PasswordTemplatePlan(const QString &passwordTemplate, const QString &extraCharacters)
+  : mError(Password::NoError)
+{
+  if (passwordTemplate.contains('n')) {
+    mUsedCharacters.append(Password::Digits);
+  }
+  if (passwordTemplate.contains('a')) {
+    mUsedCharacters.append(Password::LowerChars);
+  }
+  if (passwordTemplate.contains('A')) {
+    mUsedCharacters.append(Password::UpperChars);
+  }
+  if (passwordTemplate.contains('o')) {
+    mUsedCharacters.append(extraCharacters);
+  }
+  if (mUsedCharacters.isEmpty()) {
+    fail(Password::EmptyCharacterSetError, "used character set must not be empty");
+    return;
+  }
+  if (passwordTemplate.isEmpty()) {
+    fail(Password::EmptyTemplateError, "password template is empty");
+    return;
+  }
+  const QString charSets[] = { mUsedCharacters, extraCharacters, Password::LowerChars, Password::UpperChars, Password::Digits };
+  int offsets[] = { -1, -1, -1, -1, -1 };
+  mPositions.reserve(passwordTemplate.size());
+  foreach (QChar c, passwordTemplate) {
+    int idx;
+    const char m = c.toLatin1();
+    switch (m) {
+    case 'x':
+      idx = 0;
+      break;
+    case 'o':
+      idx = 1;
+      break;
+    case 'a':
+      idx = 2;
+      break;
+    case 'A':
+      idx = 3;
+      break;
+    case 'n':
+      idx = 4;
+      break;
+    default:
+      fail(Password::EmptyTemplateError, QString("invalid template character: %1").arg(m));
+      return;
+    }
+    if (charSets[idx].isEmpty()) {
+      fail(Password::EmptyCharacterSetError, QString("character set for template character %1 must not be empty").arg(m));
+      return;
+    }
+    if (offsets[idx] < 0) {
+      offsets[idx] = mCharacters.size();
+      mCharacters.append(charSets[idx]);
+    }
+    const Position pos = { quint32(charSets[idx].size()), offsets[idx] };
+    mPositions.append(pos);
+  }
+}
+
+
+void PasswordTemplatePlan::fail(int error, const QString &errorString)
+{
+  mError = error;
+  mErrorString = errorString;
+  mCharacters.clear();
+  mPositions.clear();
+}
+
+
+/*!
+ * \brief PasswordTemplatePlan::apply
+ *
+ * Appends one character per template position to `password`, consuming
+ * the derived key `v` digit by digit.
+ */
+void PasswordTemplatePlan::apply(UInt512 &v, SecureString &password) const
+{
+  password.reserve(password.size() + mPositions.size());
+  const QChar *const chars = mCharacters.constData();
+  foreach (const Position &pos, mPositions) {
+    password.append(chars[pos.offset + int(v.divMod(pos.radix))]);
+  }
+}
+
+
+/*!
+ * \brief PasswordTemplatePlan::guessesLog10
+ *
+ * \return The decimal logarithm of the number of passwords the plan can
+ * produce, i.e. of the guesses needed to find one by brute force.
+ */
+qreal PasswordTemplatePlan::guessesLog10(void) const
+{
+  qreal guesses = 0;
+  foreach (const Position &pos, mPositions) {
+    guesses += std::log10(qreal(pos.radix));
+  }
+  return guesses;
+}
+
+
+/*!
+ * \brief PasswordTemplatePlan::get
+ *
+ * \return The compiled plan for `passwordTemplate` and `extraCharacters`.
+ * Plans are cached, so repeated calls with the same arguments return the same plan.
+ */
+QSharedPointer<const PasswordTemplatePlan> PasswordTemplatePlan::get(const QString &passwordTemplate, const QString &extraCharacters)
+{
+  typedef QPair<QString, QString> Key;
+  static QHash<Key, QSharedPointer<const PasswordTemplatePlan> > cache;
+  static QMutex cacheMutex;
+  const Key key(passwordTemplate, extraCharacters);
+  QMutexLocker locker(&cacheMutex);
+  QSharedPointer<const PasswordTemplatePlan> plan = cache.value(key);
+  if (plan.isNull()) {
+    if (cache.size() >= MaxCachedPlans) {
+      cache.clear();
+    }
+    plan = QSharedPointer<const PasswordTemplatePlan>(new PasswordTemplatePlan(passwordTemplate, extraCharacters));
+    cache.insert(key, plan);
+  }
+  return plan;
+}
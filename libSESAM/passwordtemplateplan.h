@@ -0,0 +1,89 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PASSWORDTEMPLATEPLAN_H_
+#define __PASSWORDTEMPLATEPLAN_H_
+
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "securestring.h"
+
+class UInt512;
+
+
+/*!
+ * \brief The PasswordTemplatePlan class
+ *
+ * A password template compiled against a set of extra characters.
+ *
+ * All character sets the template refers to are stored back to back in
+ * one string. Every template position is reduced to the size of its
+ * character set (the radix) and the offset of that set in the string,
+ * so that `apply()` only has to extract one digit per position from the
+ * derived key.
+ *
+ * Plans are immutable. `PasswordTemplatePlan::get()` returns a shared,
+ * cached plan for a given template and set of extra characters.
+ */
+class PasswordTemplatePlan
+{
+public:
+  struct Position {
+    quint32 radix;
+    int offset;
+  };
+
+  static QSharedPointer<const PasswordTemplatePlan> get(const QString &passwordTemplate, const QString &extraCharacters);
+
+  int error(void) const
+  {
+    return mError;
+  }
+  const QString &errorString(void) const
+  {
+    return mErrorString;
+  }
+  const QString &usedCharacters(void) const
+  {
+    return mUsedCharacters;
+  }
+  int length(void) const
+  {
+    return mPositions.size();
+  }
+  void apply(UInt512 &v, SecureString &password) const;
+  qreal guessesLog10(void) const;
+
+private:
+  PasswordTemplatePlan(const QString &passwordTemplate, const QString &extraCharacters);
+  void fail(int error, const QString &errorString);
+
+  static const int MaxCachedPlans;
+
+  QString mUsedCharacters;
+  QString mCharacters;
+  QVector<Position> mPositions;
+  int mError;
+  QString mErrorString;
+};
+
+
+#endif // __PASSWORDTEMPLATEPLAN_H_
@@ -20,11 +20,12 @@
 #include <cstring>
 
 #include "pbkdf2.h"
+#include "derivation.h"
+#include "cryptoexecutor.h"
+#include "sha2.h"
+#include "sha512multibuffer.h"
 #include "util.h"
 
-#include <QElapsedTimer>
-#include <QMessageAuthenticationCode>
-#include <QMutexLocker>
 #include <QtConcurrent>
 #include <QtDebug>
 #include <QChar>
@@ -34,7 +35,7 @@ class PBKDF2Private {
 public:
   PBKDF2Private(void)
     : elapsed(0)
-    , abort(false)
+    , token(&ownToken)
   { /* ... */ }
   ~PBKDF2Private()
   { /* ... */ }
@@ -42,12 +43,24 @@ public:
   SecureByteArray derivedKey;
   SecureString hexKey;
   qreal elapsed;
-  bool abort;
-  QMutex abortMutex;
+  CancellationToken ownToken;
+  CancellationToken *token;
   QFuture<void> future;
 };
 
 
+class PBKDF2Progress : public DerivationProgress {
+public:
+  PBKDF2Progress(PBKDF2 *pbkdf2)
+    : pbkdf2(pbkdf2)
+  { /* ... */ }
+  void progress(int iterationsDone, int iterations, qreal iterationsPerSecond, qreal secondsRemaining)
+  {
+    emit pbkdf2->generationProgress(iterationsDone, iterations, iterationsPerSecond, secondsRemaining);
+  }
+  PBKDF2 *pbkdf2;
+};
+
 
 PBKDF2::PBKDF2(QObject *parent)
   : QObject(parent)
@@ -66,66 +79,103 @@ PBKDF2::~PBKDF2()
 { /* ... */ }
 
 
-auto xorbuf = [](QByteArray &dst, const QByteArray &src) {
-  Q_ASSERT_X(dst.size() == src.size(), "xorbuf()", "size of source and destination buffers must be equal");
-  for (int i = 0; i < dst.size(); ++i) {
-    dst[i] = dst.at(i) ^ src.at(i);
-  }
-};
-
-
+/*!
+ * \brief PBKDF2::generate
+ *
+ * Derives the key on the calling thread. The cancellation token is not
+ * reset here, so an `abortGeneration()` issued while a `generateAsync()`
+ * task is still queued makes the task return at once. To reuse an aborted
+ * object synchronously, reset `cancellationToken()` first.
+ */
 void PBKDF2::generate(const SecureByteArray &pwd, const QByteArray &salt, int iterations, QCryptographicHash::Algorithm algorithm)
 {
   Q_D(PBKDF2);
 
-  d->abortMutex.lock();
-  d->abort = false;
-  d->abortMutex.unlock();
-
-  QElapsedTimer elapsedTimer;
-  elapsedTimer.start();
-
   emit generationStarted();
 
-  static const char INT_32_BE1[4] = { 0, 0, 0, 1 };
-  QMessageAuthenticationCode hmac(algorithm);
-  hmac.setKey(pwd);
-  hmac.addData(salt + QByteArray(INT_32_BE1, 4));
-
-  QByteArray buffer = hmac.result();
-  d->derivedKey = buffer;
-
-  for (int j = 1; j < iterations; ++j) {
-    QMutexLocker locker(&d->abortMutex);
-    if (d->abort) {
-      emit generationAborted();
-      break;
-    }
-    hmac.reset();
-    hmac.addData(buffer);
-    buffer = hmac.result();
-    xorbuf(d->derivedKey, buffer);
+  DerivationRequest request;
+  request.pwd = pwd;
+  request.salt = salt;
+  request.iterations = iterations;
+  request.algorithm = algorithm;
+  PBKDF2Progress progress(this);
+  const DerivationResult &result = Derivation::derive(request, d->token, &progress);
+  d->derivedKey = result.derivedKey;
+  if (result.aborted) {
+    emit generationAborted();
   }
 
   d->hexKey = d->derivedKey.toHex();
-  d->elapsed = 1e-9 * elapsedTimer.nsecsElapsed();
+  d->elapsed = result.elapsedSeconds;
 }
 
 
 void PBKDF2::generateAsync(const SecureByteArray &pwd, const QByteArray &salt, int iterations, QCryptographicHash::Algorithm algorithm)
 {
   Q_D(PBKDF2);
-  d->abort = false;
-  d->future = QtConcurrent::run(this, &PBKDF2::generate, pwd, salt, iterations, algorithm);
+  d->ownToken.reset();
+  d->future = CryptoExecutor::instance().run(CryptoExecutor::Interactive, "pbkdf2", [this, pwd, salt, iterations, algorithm]() {
+    generate(pwd, salt, iterations, algorithm);
+  });
 }
 
 
 void PBKDF2::abortGeneration(void)
 {
   Q_D(PBKDF2);
-  d->abortMutex.lock();
-  d->abort = true;
-  d->abortMutex.unlock();
+  d->token->cancel();
+}
+
+
+/*!
+ * \brief PBKDF2::setCancellationToken
+ *
+ * Makes `generate()` poll `token` instead of the internal one, so that one
+ * token can cancel several derivations at once. The caller keeps ownership
+ * and is responsible for resetting it. Pass `Q_NULLPTR` to revert to the
+ * internal token.
+ */
+void PBKDF2::setCancellationToken(CancellationToken *token)
+{
+  Q_D(PBKDF2);
+  d->token = (token != Q_NULLPTR) ? token : &d->ownToken;
+}
+
+
+CancellationToken *PBKDF2::cancellationToken(void) const
+{
+  return d_ptr->token;
+}
+
+
+/*!
+ * \brief PBKDF2::generateBatch
+ *
+ * Derives PBKDF2-HMAC-SHA512 keys for many independent inputs at once.
+ *
+ * The jobs are spread over the lanes of the widest SIMD kernel
+ * available (see `Sha512MultiBuffer`), so on CPUs with AVX2 or AVX-512
+ * a group of 4 or 8 derivations takes about as long as a single one.
+ *
+ * \param jobs Password, salt and iteration count of each derivation.
+ * \return The derived keys in the same order as `jobs`.
+ */
+QVector<SecureByteArray> PBKDF2::generateBatch(const QVector<PBKDF2Job> &jobs)
+{
+  QVector<SecureByteArray> keys(jobs.size(), SecureByteArray(Sha512::DigestSize, static_cast<char>(0)));
+  QVector<Sha512MultiBuffer::Job> mbJobs(jobs.size());
+  for (int i = 0; i < jobs.size(); ++i) {
+    const PBKDF2Job &job = jobs.at(i);
+    Sha512MultiBuffer::Job &mbJob = mbJobs[i];
+    mbJob.pwd = job.pwd.constData();
+    mbJob.pwdSize = job.pwd.size();
+    mbJob.salt = job.salt.constData();
+    mbJob.saltSize = job.salt.size();
+    mbJob.iterations = job.iterations;
+    mbJob.derivedKey = reinterpret_cast<uchar*>(keys[i].data());
+  }
+  Sha512MultiBuffer::pbkdf2(mbJobs.constData(), mbJobs.size());
+  return keys;
 }
 
 
@@ -159,5 +209,5 @@ bool PBKDF2::isRunning(void) const
 
 bool PBKDF2::isAborted(void) const
 {
-  return d_ptr->abort;
+  return d_ptr->token->isCancelled();
 }
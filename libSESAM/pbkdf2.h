@@ -24,17 +24,38 @@
 #include <QString>
 #include <QScopedPointer>
 #include <QCryptographicHash>
+#include <QVector>
 
 #include "securebytearray.h"
 #include "securestring.h"
+#include "cancellationtoken.h"
 
 class PBKDF2Private;
 
+
+struct PBKDF2Job
+{
+  PBKDF2Job(void)
+    : iterations(1)
+  { /* ... */ }
+  PBKDF2Job(const SecureByteArray &pwd, const QByteArray &salt, int iterations)
+    : pwd(pwd)
+    , salt(salt)
+    , iterations(iterations)
+  { /* ... */ }
+  SecureByteArray pwd;
+  QByteArray salt;
+  int iterations;
+};
+
 /*!
  * \brief The PBKDF2 class
  *
  * `PBKDF2` implements the Password-Based Key Derivation Function 2.
  *
+ * `generate()` is a `QObject` adapter around `Derivation::derive()`:
+ * it polls its `CancellationToken` every `Derivation::CancellationCheckInterval`
+ * iterations and turns the progress reports into `generationProgress()` signals.
  */
 class PBKDF2 : public QObject
 {
@@ -45,6 +66,8 @@ public:
   ~PBKDF2();
 
   void abortGeneration(void);
+  void setCancellationToken(CancellationToken *token);
+  CancellationToken *cancellationToken(void) const;
   void generate(const SecureByteArray &pwd, const QByteArray &salt, int iterations, QCryptographicHash::Algorithm algorithm);
   void generateAsync(const SecureByteArray &pwd, const QByteArray &salt, int iterations, QCryptographicHash::Algorithm algorithm);
 
@@ -54,9 +77,12 @@ public:
   bool isRunning(void) const;
   bool isAborted(void) const;
 
+  static QVector<SecureByteArray> generateBatch(const QVector<PBKDF2Job> &jobs);
+
 signals:
   void generationStarted(void);
   void generationAborted(void);
+  void generationProgress(int iterationsDone, int iterations, qreal iterationsPerSecond, qreal secondsRemaining);
 
 private:
   QScopedPointer<PBKDF2Private> d_ptr;
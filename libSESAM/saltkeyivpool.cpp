@@ -0,0 +1,218 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "saltkeyivpool.h"
+#include "crypter.h"
+#include "cryptoexecutor.h"
+
+#include <QFuture>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QString>
+
+
+const int SaltKeyIVPool::DefaultCapacity;
+
+
+class SaltKeyIVPoolPrivate {
+public:
+  SaltKeyIVPoolPrivate(int capacity)
+    : capacity(qMax(1, capacity))
+    , refilling(false)
+  { /* ... */ }
+  const int capacity;
+  mutable QMutex mutex;
+  SecureByteArray masterPassword;
+  QQueue<SaltKeyIVPool::Entry> entries;
+  bool refilling;
+  QString tag;
+  QFuture<void> future;
+};
+
+
+static SaltKeyIVPool::Entry makeEntry(const SecureByteArray &masterPassword)
+{
+  SaltKeyIVPool::Entry entry;
+  entry.salt = Crypter::generateSalt();
+  Crypter::makeKeyAndIVFromPassword(masterPassword, entry.salt, entry.key, entry.IV);
+  return entry;
+}
+
+
+SaltKeyIVPool::SaltKeyIVPool(int capacity)
+  : d_ptr(new SaltKeyIVPoolPrivate(capacity))
+{
+  d_ptr->tag = QString("saltKeyIVPool:%1").arg(quintptr(this), 0, 16);
+}
+
+
+SaltKeyIVPool::~SaltKeyIVPool()
+{
+  clear();
+  waitForFinished();
+}
+
+
+int SaltKeyIVPool::capacity(void) const
+{
+  return d_ptr->capacity;
+}
+
+
+/*!
+ * \brief SaltKeyIVPool::count
+ *
+ * \return The number of triples that can be taken without waiting.
+ */
+int SaltKeyIVPool::count(void) const
+{
+  QMutexLocker locker(&d_ptr->mutex);
+  return d_ptr->entries.size();
+}
+
+
+/*!
+ * \brief SaltKeyIVPool::setMasterPassword
+ *
+ * Discards all triples derived from a previous master password and starts
+ * filling the pool with triples derived from `masterPassword`.
+ */
+void SaltKeyIVPool::setMasterPassword(const SecureByteArray &masterPassword)
+{
+  Q_D(SaltKeyIVPool);
+  {
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+    d->masterPassword = masterPassword;
+  }
+  refill();
+}
+
+
+/*!
+ * \brief SaltKeyIVPool::tryTake
+ *
+ * Removes the oldest triple from the pool and stores it in `entry`.
+ *
+ * \return `false` if the pool is empty; `entry` is left untouched then.
+ */
+bool SaltKeyIVPool::tryTake(Entry &entry)
+{
+  Q_D(SaltKeyIVPool);
+  {
+    QMutexLocker locker(&d->mutex);
+    if (d->entries.isEmpty())
+      return false;
+    entry = d->entries.dequeue();
+  }
+  refill();
+  return true;
+}
+
+
+/*!
+ * \brief SaltKeyIVPool::take
+ *
+ * Like `tryTake()`, but if the pool is drained, a triple is derived in
+ * the calling thread.
+ *
+ * \return A triple derived from the current master password; invalid if
+ * no master password has been set.
+ */
+SaltKeyIVPool::Entry SaltKeyIVPool::take(void)
+{
+  Q_D(SaltKeyIVPool);
+  Entry entry;
+  if (tryTake(entry))
+    return entry;
+  d->mutex.lock();
+  const SecureByteArray masterPassword = d->masterPassword;
+  d->mutex.unlock();
+  if (!masterPassword.isEmpty()) {
+    entry = makeEntry(masterPassword);
+  }
+  return entry;
+}
+
+
+/*!
+ * \brief SaltKeyIVPool::clear
+ *
+ * Forgets the master password and wipes all triples. A queued refill is
+ * dropped; a derivation that is already running is waited for and its
+ * result discarded, so that no key derived from the old master password
+ * is produced after this function has returned.
+ */
+void SaltKeyIVPool::clear(void)
+{
+  Q_D(SaltKeyIVPool);
+  QFuture<void> future;
+  {
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+    d->masterPassword.invalidate();
+    if (CryptoExecutor::instance().cancel(d->tag) > 0) {
+      d->refilling = false;
+    }
+    future = d->future;
+  }
+  future.waitForFinished();
+}
+
+
+void SaltKeyIVPool::waitForFinished(void)
+{
+  d_ptr->future.waitForFinished();
+}
+
+
+void SaltKeyIVPool::refill(void)
+{
+  Q_D(SaltKeyIVPool);
+  QMutexLocker locker(&d->mutex);
+  if (d->refilling || d->masterPassword.isEmpty() || d->entries.size() >= d->capacity)
+    return;
+  d->refilling = true;
+  d->future = CryptoExecutor::instance().run(CryptoExecutor::Background, d->tag, [this]() {
+    fill();
+  });
+}
+
+
+void SaltKeyIVPool::fill(void)
+{
+  Q_D(SaltKeyIVPool);
+  forever {
+    SecureByteArray masterPassword;
+    {
+      QMutexLocker locker(&d->mutex);
+      if (d->masterPassword.isEmpty() || d->entries.size() >= d->capacity) {
+        d->refilling = false;
+        return;
+      }
+      masterPassword = d->masterPassword;
+    }
+    const Entry &entry = makeEntry(masterPassword);
+    QMutexLocker locker(&d->mutex);
+    if (d->masterPassword == masterPassword && d->entries.size() < d->capacity) {
+      d->entries.enqueue(entry);
+    }
+  }
+}
@@ -0,0 +1,79 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SALTKEYIVPOOL_H_
+#define __SALTKEYIVPOOL_H_
+
+#include <QByteArray>
+#include <QScopedPointer>
+
+#include "securebytearray.h"
+
+class SaltKeyIVPoolPrivate;
+
+/*!
+ * \brief The SaltKeyIVPool class
+ *
+ * `SaltKeyIVPool` keeps a few ready-made (salt, key, IV) triples for
+ * encrypting the vault with a fresh salt on every save, so that a save
+ * does not have to wait for `Crypter::makeKeyAndIVFromPassword()`.
+ *
+ * The pool is refilled on a `CryptoExecutor::Background` thread after
+ * the master password has been set and after each triple taken from it.
+ *
+ * All methods are thread-safe.
+ */
+class SaltKeyIVPool
+{
+public:
+  struct Entry {
+    bool isValid(void) const
+    {
+      return !salt.isEmpty();
+    }
+    QByteArray salt;
+    SecureByteArray key;
+    SecureByteArray IV;
+  };
+
+  explicit SaltKeyIVPool(int capacity = DefaultCapacity);
+  ~SaltKeyIVPool();
+
+  static const int DefaultCapacity = 3;
+
+  int capacity(void) const;
+  int count(void) const;
+
+  void setMasterPassword(const SecureByteArray &masterPassword);
+  bool tryTake(Entry &entry);
+  Entry take(void);
+  void clear(void);
+  void waitForFinished(void);
+
+private:
+  void refill(void);
+  void fill(void);
+
+  QScopedPointer<SaltKeyIVPoolPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(SaltKeyIVPool)
+  Q_DISABLE_COPY(SaltKeyIVPool)
+};
+
+
+#endif // __SALTKEYIVPOOL_H_
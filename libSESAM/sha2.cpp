@@ -0,0 +1,236 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "sha2.h"
+#include "cpufeatures.h"
+
+#if defined(SESAM_X86_SIMD)
+#include <immintrin.h>
+#endif
+
+
+const Sha256::Word Sha256::InitialState[Sha256::StateWords] = {
+  0x6a09e667UL, 0xbb67ae85UL, 0x3c6ef372UL, 0xa54ff53aUL,
+  0x510e527fUL, 0x9b05688cUL, 0x1f83d9abUL, 0x5be0cd19UL
+};
+
+
+const Sha512::Word Sha512::InitialState[Sha512::StateWords] = {
+  Q_UINT64_C(0x6a09e667f3bcc908), Q_UINT64_C(0xbb67ae8584caa73b),
+  Q_UINT64_C(0x3c6ef372fe94f82b), Q_UINT64_C(0xa54ff53a5f1d36f1),
+  Q_UINT64_C(0x510e527fade682d1), Q_UINT64_C(0x9b05688c2b3e6c1f),
+  Q_UINT64_C(0x1f83d9abfb41bd6b), Q_UINT64_C(0x5be0cd19137e2179)
+};
+
+
+const Sha384::Word Sha384::InitialState[Sha384::StateWords] = {
+  Q_UINT64_C(0xcbbb9d5dc1059ed8), Q_UINT64_C(0x629a292a367cd507),
+  Q_UINT64_C(0x9159015a3070dd17), Q_UINT64_C(0x152fecd8f70e5939),
+  Q_UINT64_C(0x67332667ffc00b31), Q_UINT64_C(0x8eb44a8768581511),
+  Q_UINT64_C(0xdb0c2e0d64f98fa7), Q_UINT64_C(0x47b5481dbefa4fa4)
+};
+
+
+const Sha256::Word Sha256::K[64] = {
+  0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+  0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+  0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+  0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+  0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+  0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+  0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+  0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
+};
+
+
+const Sha512::Word Sha512::K[80] = {
+  Q_UINT64_C(0x428a2f98d728ae22), Q_UINT64_C(0x7137449123ef65cd), Q_UINT64_C(0xb5c0fbcfec4d3b2f), Q_UINT64_C(0xe9b5dba58189dbbc),
+  Q_UINT64_C(0x3956c25bf348b538), Q_UINT64_C(0x59f111f1b605d019), Q_UINT64_C(0x923f82a4af194f9b), Q_UINT64_C(0xab1c5ed5da6d8118),
+  Q_UINT64_C(0xd807aa98a3030242), Q_UINT64_C(0x12835b0145706fbe), Q_UINT64_C(0x243185be4ee4b28c), Q_UINT64_C(0x550c7dc3d5ffb4e2),
+  Q_UINT64_C(0x72be5d74f27b896f), Q_UINT64_C(0x80deb1fe3b1696b1), Q_UINT64_C(0x9bdc06a725c71235), Q_UINT64_C(0xc19bf174cf692694),
+  Q_UINT64_C(0xe49b69c19ef14ad2), Q_UINT64_C(0xefbe4786384f25e3), Q_UINT64_C(0x0fc19dc68b8cd5b5), Q_UINT64_C(0x240ca1cc77ac9c65),
+  Q_UINT64_C(0x2de92c6f592b0275), Q_UINT64_C(0x4a7484aa6ea6e483), Q_UINT64_C(0x5cb0a9dcbd41fbd4), Q_UINT64_C(0x76f988da831153b5),
+  Q_UINT64_C(0x983e5152ee66dfab), Q_UINT64_C(0xa831c66d2db43210), Q_UINT64_C(0xb00327c898fb213f), Q_UINT64_C(0xbf597fc7beef0ee4),
+  Q_UINT64_C(0xc6e00bf33da88fc2), Q_UINT64_C(0xd5a79147930aa725), Q_UINT64_C(0x06ca6351e003826f), Q_UINT64_C(0x142929670a0e6e70),
+  Q_UINT64_C(0x27b70a8546d22ffc), Q_UINT64_C(0x2e1b21385c26c926), Q_UINT64_C(0x4d2c6dfc5ac42aed), Q_UINT64_C(0x53380d139d95b3df),
+  Q_UINT64_C(0x650a73548baf63de), Q_UINT64_C(0x766a0abb3c77b2a8), Q_UINT64_C(0x81c2c92e47edaee6), Q_UINT64_C(0x92722c851482353b),
+  Q_UINT64_C(0xa2bfe8a14cf10364), Q_UINT64_C(0xa81a664bbc423001), Q_UINT64_C(0xc24b8b70d0f89791), Q_UINT64_C(0xc76c51a30654be30),
+  Q_UINT64_C(0xd192e819d6ef5218), Q_UINT64_C(0xd69906245565a910), Q_UINT64_C(0xf40e35855771202a), Q_UINT64_C(0x106aa07032bbd1b8),
+  Q_UINT64_C(0x19a4c116b8d2d0c8), Q_UINT64_C(0x1e376c085141ab53), Q_UINT64_C(0x2748774cdf8eeb99), Q_UINT64_C(0x34b0bcb5e19b48a8),
+  Q_UINT64_C(0x391c0cb3c5c95a63), Q_UINT64_C(0x4ed8aa4ae3418acb), Q_UINT64_C(0x5b9cca4f7763e373), Q_UINT64_C(0x682e6ff3d6b2b8a3),
+  Q_UINT64_C(0x748f82ee5defb2fc), Q_UINT64_C(0x78a5636f43172f60), Q_UINT64_C(0x84c87814a1f0ab72), Q_UINT64_C(0x8cc702081a6439ec),
+  Q_UINT64_C(0x90befffa23631e28), Q_UINT64_C(0xa4506cebde82bde9), Q_UINT64_C(0xbef9a3f7b2c67915), Q_UINT64_C(0xc67178f2e372532b),
+  Q_UINT64_C(0xca273eceea26619c), Q_UINT64_C(0xd186b8c721c0c207), Q_UINT64_C(0xeada7dd6cde0eb1e), Q_UINT64_C(0xf57d4f7fee6ed178),
+  Q_UINT64_C(0x06f067aa72176fba), Q_UINT64_C(0x0a637dc5a2c898a6), Q_UINT64_C(0x113f9804bef90dae), Q_UINT64_C(0x1b710b35131c471b),
+  Q_UINT64_C(0x28db77f523047d84), Q_UINT64_C(0x32caab7b40c72493), Q_UINT64_C(0x3c9ebe0a15c9bebc), Q_UINT64_C(0x431d67c49c100d4c),
+  Q_UINT64_C(0x4cc5d4becb3e42b6), Q_UINT64_C(0x597f299cfc657e2a), Q_UINT64_C(0x5fcb6fab3ad6faec), Q_UINT64_C(0x6c44198c4a475817)
+};
+
+
+static inline quint32 rotr32(quint32 x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+
+static inline quint64 rotr64(quint64 x, int n)
+{
+  return (x >> n) | (x << (64 - n));
+}
+
+
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+
+void Sha256::transform(Word *state, const Word *block)
+{
+  Word W[64];
+  for (int t = 0; t < 16; ++t) {
+    W[t] = block[t];
+  }
+  for (int t = 16; t < 64; ++t) {
+    const Word s0 = rotr32(W[t - 15], 7) ^ rotr32(W[t - 15], 18) ^ (W[t - 15] >> 3);
+    const Word s1 = rotr32(W[t - 2], 17) ^ rotr32(W[t - 2], 19) ^ (W[t - 2] >> 10);
+    W[t] = W[t - 16] + s0 + W[t - 7] + s1;
+  }
+  Word a = state[0], b = state[1], c = state[2], d = state[3];
+  Word e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int t = 0; t < 64; ++t) {
+    const Word T1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + CH(e, f, g) + K[t] + W[t];
+    const Word T2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + MAJ(a, b, c);
+    h = g;
+    g = f;
+    f = e;
+    e = d + T1;
+    d = c;
+    c = b;
+    b = a;
+    a = T1 + T2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+
+void Sha512::transform(Word *state, const Word *block)
+{
+  Word W[80];
+  for (int t = 0; t < 16; ++t) {
+    W[t] = block[t];
+  }
+  for (int t = 16; t < 80; ++t) {
+    const Word s0 = rotr64(W[t - 15], 1) ^ rotr64(W[t - 15], 8) ^ (W[t - 15] >> 7);
+    const Word s1 = rotr64(W[t - 2], 19) ^ rotr64(W[t - 2], 61) ^ (W[t - 2] >> 6);
+    W[t] = W[t - 16] + s0 + W[t - 7] + s1;
+  }
+  Word a = state[0], b = state[1], c = state[2], d = state[3];
+  Word e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int t = 0; t < 80; ++t) {
+    const Word T1 = h + (rotr64(e, 14) ^ rotr64(e, 18) ^ rotr64(e, 41)) + CH(e, f, g) + K[t] + W[t];
+    const Word T2 = (rotr64(a, 28) ^ rotr64(a, 34) ^ rotr64(a, 39)) + MAJ(a, b, c);
+    h = g;
+    g = f;
+    f = e;
+    e = d + T1;
+    d = c;
+    c = b;
+    b = a;
+    a = T1 + T2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+
+#if defined(SESAM_X86_SIMD)
+/*!
+ * \brief sha256TransformNI
+ *
+ * SHA-256 compression with `SHA256RNDS2`, `SHA256MSG1` and `SHA256MSG2`.
+ * Each iteration of the loop runs four rounds; the four registers in `W`
+ * hold the last 16 message schedule words.
+ */
+SESAM_TARGET("sha,sse4.1,ssse3")
+static void sha256TransformNI(quint32 *state, const quint32 *block)
+{
+  __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 0));
+  __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+  tmp = _mm_shuffle_epi32(tmp, 0xb1);
+  state1 = _mm_shuffle_epi32(state1, 0x1b);
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+  const __m128i abef = state0;
+  const __m128i cdgh = state1;
+  __m128i W[4];
+  for (int i = 0; i < 4; ++i) {
+    W[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 4 * i));
+  }
+  for (int i = 0; i < 16; ++i) {
+    if (i >= 4) {
+      const __m128i w7 = _mm_alignr_epi8(W[(i + 3) & 3], W[(i + 2) & 3], 4);
+      W[i & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(W[i & 3], W[(i + 1) & 3]), w7), W[(i + 3) & 3]);
+    }
+    __m128i msg = _mm_add_epi32(W[i & 3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(Sha256::K + 4 * i)));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+  }
+  state0 = _mm_add_epi32(state0, abef);
+  state1 = _mm_add_epi32(state1, cdgh);
+  tmp = _mm_shuffle_epi32(state0, 0x1b);
+  state1 = _mm_shuffle_epi32(state1, 0xb1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 0), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+#endif
+
+
+bool Sha256NI::isSupported(void)
+{
+#if defined(SESAM_X86_SIMD)
+  return CPUFeatures::has(CPUFeatures::SHA) && CPUFeatures::has(CPUFeatures::SSE41) && CPUFeatures::has(CPUFeatures::SSSE3);
+#else
+  return false;
+#endif
+}
+
+
+void Sha256NI::transform(Word *state, const Word *block)
+{
+#if defined(SESAM_X86_SIMD)
+  sha256TransformNI(state, block);
+#else
+  Sha256::transform(state, block);
+#endif
+}
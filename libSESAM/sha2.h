@@ -0,0 +1,127 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SHA2_H_
+#define __SHA2_H_
+
+#include <QtGlobal>
+#include <QtEndian>
+
+/*!
+ * \brief The Sha256 struct
+ *
+ * Parameters and compression function of SHA-256 (FIPS 180-4).
+ *
+ * The compression function works on message blocks which have already
+ * been converted to host byte order. That way callers which feed
+ * digests back into the hash function (like HMAC inside of PBKDF2)
+ * can skip the byte swapping altogether.
+ */
+struct Sha256
+{
+  typedef quint32 Word;
+  enum {
+    BlockSize = 64,
+    DigestSize = 32,
+    StateWords = 8,
+    BlockWords = BlockSize / sizeof(Word),
+    DigestWords = DigestSize / sizeof(Word)
+  };
+  static const Word InitialState[StateWords];
+  static const Word K[64];
+  static void transform(Word *state, const Word *block);
+};
+
+
+/*!
+ * \brief The Sha256NI struct
+ *
+ * SHA-256 with the compression function implemented on top of the
+ * x86 SHA extensions. Only use it if `isSupported()` returns `true`.
+ */
+struct Sha256NI : public Sha256
+{
+  static bool isSupported(void);
+  static void transform(Word *state, const Word *block);
+};
+
+
+/*!
+ * \brief The Sha512 struct
+ *
+ * Parameters and compression function of SHA-512 (FIPS 180-4).
+ */
+struct Sha512
+{
+  typedef quint64 Word;
+  enum {
+    BlockSize = 128,
+    DigestSize = 64,
+    StateWords = 8,
+    BlockWords = BlockSize / sizeof(Word),
+    DigestWords = DigestSize / sizeof(Word)
+  };
+  static const Word InitialState[StateWords];
+  static const Word K[80];
+  static void transform(Word *state, const Word *block);
+};
+
+
+/*!
+ * \brief The Sha384 struct
+ *
+ * SHA-384 is SHA-512 with a different initial state and a truncated digest.
+ */
+struct Sha384
+{
+  typedef quint64 Word;
+  enum {
+    BlockSize = 128,
+    DigestSize = 48,
+    StateWords = 8,
+    BlockWords = BlockSize / sizeof(Word),
+    DigestWords = DigestSize / sizeof(Word)
+  };
+  static const Word InitialState[StateWords];
+  static void transform(Word *state, const Word *block)
+  {
+    Sha512::transform(state, block);
+  }
+};
+
+
+template <class Word>
+inline void loadBigEndian(Word *dst, const uchar *src, int nWords)
+{
+  for (int i = 0; i < nWords; ++i, src += sizeof(Word)) {
+    dst[i] = qFromBigEndian<Word>(src);
+  }
+}
+
+
+template <class Word>
+inline void storeBigEndian(uchar *dst, const Word *src, int nWords)
+{
+  for (int i = 0; i < nWords; ++i, dst += sizeof(Word)) {
+    qToBigEndian<Word>(src[i], dst);
+  }
+}
+
+
+#endif // __SHA2_H_
@@ -0,0 +1,328 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <climits>
+#include <cstring>
+
+#include "sha512multibuffer.h"
+#include "cpufeatures.h"
+#include "hmacengine.h"
+#include "sha2.h"
+#include "util.h"
+
+#if defined(SESAM_X86_SIMD)
+#include <immintrin.h>
+#endif
+
+
+#if defined(SESAM_X86_SIMD)
+
+#define ROTR256(x, n) _mm256_or_si256(_mm256_srli_epi64((x), (n)), _mm256_slli_epi64((x), 64 - (n)))
+#define ADD256(a, b) _mm256_add_epi64((a), (b))
+#define XOR256(a, b) _mm256_xor_si256((a), (b))
+
+SESAM_TARGET("avx2")
+static void sha512TransformAVX2(quint64 *state, const quint64 *block)
+{
+  __m256i W[80];
+  for (int t = 0; t < 16; ++t) {
+    W[t] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 4 * t));
+  }
+  for (int t = 16; t < 80; ++t) {
+    const __m256i s0 = XOR256(XOR256(ROTR256(W[t - 15], 1), ROTR256(W[t - 15], 8)), _mm256_srli_epi64(W[t - 15], 7));
+    const __m256i s1 = XOR256(XOR256(ROTR256(W[t - 2], 19), ROTR256(W[t - 2], 61)), _mm256_srli_epi64(W[t - 2], 6));
+    W[t] = ADD256(ADD256(W[t - 16], s0), ADD256(W[t - 7], s1));
+  }
+  __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 0));
+  __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 4));
+  __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 8));
+  __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 12));
+  __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 16));
+  __m256i f = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 20));
+  __m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 24));
+  __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + 28));
+  for (int t = 0; t < 80; ++t) {
+    const __m256i S1 = XOR256(XOR256(ROTR256(e, 14), ROTR256(e, 18)), ROTR256(e, 41));
+    const __m256i ch = XOR256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+    const __m256i T1 = ADD256(ADD256(ADD256(h, S1), ADD256(ch, W[t])), _mm256_set1_epi64x(qint64(Sha512::K[t])));
+    const __m256i S0 = XOR256(XOR256(ROTR256(a, 28), ROTR256(a, 34)), ROTR256(a, 39));
+    const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+    const __m256i T2 = ADD256(S0, maj);
+    h = g;
+    g = f;
+    f = e;
+    e = ADD256(d, T1);
+    d = c;
+    c = b;
+    b = a;
+    a = ADD256(T1, T2);
+  }
+  const __m256i result[8] = { a, b, c, d, e, f, g, h };
+  for (int i = 0; i < 8; ++i) {
+    __m256i *const s = reinterpret_cast<__m256i*>(state + 4 * i);
+    _mm256_storeu_si256(s, ADD256(_mm256_loadu_si256(s), result[i]));
+  }
+}
+
+
+#define ROTR512(x, n) _mm512_ror_epi64((x), (n))
+#define ADD512(a, b) _mm512_add_epi64((a), (b))
+#define XOR3_512(a, b, c) _mm512_ternarylogic_epi64((a), (b), (c), 0x96)
+
+SESAM_TARGET("avx512f")
+static void sha512TransformAVX512(quint64 *state, const quint64 *block)
+{
+  __m512i W[80];
+  for (int t = 0; t < 16; ++t) {
+    W[t] = _mm512_loadu_si512(block + 8 * t);
+  }
+  for (int t = 16; t < 80; ++t) {
+    const __m512i s0 = XOR3_512(ROTR512(W[t - 15], 1), ROTR512(W[t - 15], 8), _mm512_srli_epi64(W[t - 15], 7));
+    const __m512i s1 = XOR3_512(ROTR512(W[t - 2], 19), ROTR512(W[t - 2], 61), _mm512_srli_epi64(W[t - 2], 6));
+    W[t] = ADD512(ADD512(W[t - 16], s0), ADD512(W[t - 7], s1));
+  }
+  __m512i a = _mm512_loadu_si512(state + 0);
+  __m512i b = _mm512_loadu_si512(state + 8);
+  __m512i c = _mm512_loadu_si512(state + 16);
+  __m512i d = _mm512_loadu_si512(state + 24);
+  __m512i e = _mm512_loadu_si512(state + 32);
+  __m512i f = _mm512_loadu_si512(state + 40);
+  __m512i g = _mm512_loadu_si512(state + 48);
+  __m512i h = _mm512_loadu_si512(state + 56);
+  for (int t = 0; t < 80; ++t) {
+    const __m512i S1 = XOR3_512(ROTR512(e, 14), ROTR512(e, 18), ROTR512(e, 41));
+    const __m512i ch = _mm512_ternarylogic_epi64(e, f, g, 0xca);
+    const __m512i T1 = ADD512(ADD512(ADD512(h, S1), ADD512(ch, W[t])), _mm512_set1_epi64(qint64(Sha512::K[t])));
+    const __m512i S0 = XOR3_512(ROTR512(a, 28), ROTR512(a, 34), ROTR512(a, 39));
+    const __m512i maj = _mm512_ternarylogic_epi64(a, b, c, 0xe8);
+    const __m512i T2 = ADD512(S0, maj);
+    h = g;
+    g = f;
+    f = e;
+    e = ADD512(d, T1);
+    d = c;
+    c = b;
+    b = a;
+    a = ADD512(T1, T2);
+  }
+  const __m512i result[8] = { a, b, c, d, e, f, g, h };
+  for (int i = 0; i < 8; ++i) {
+    quint64 *const s = state + 8 * i;
+    _mm512_storeu_si512(s, ADD512(_mm512_loadu_si512(s), result[i]));
+  }
+}
+
+#endif
+
+
+static const Sha512MultiBuffer::Kernel ScalarKernel = { "scalar", 1, &Sha512::transform };
+#if defined(SESAM_X86_SIMD)
+static const Sha512MultiBuffer::Kernel AVX2Kernel = { "AVX2", 4, &sha512TransformAVX2 };
+static const Sha512MultiBuffer::Kernel AVX512Kernel = { "AVX-512", 8, &sha512TransformAVX512 };
+#endif
+
+
+static int collectKernels(Sha512MultiBuffer::Kernel *kernels)
+{
+  int n = 0;
+  kernels[n++] = ScalarKernel;
+#if defined(SESAM_X86_SIMD)
+  if (CPUFeatures::has(CPUFeatures::AVX2)) {
+    kernels[n++] = AVX2Kernel;
+  }
+  if (CPUFeatures::has(CPUFeatures::AVX512F)) {
+    kernels[n++] = AVX512Kernel;
+  }
+#endif
+  return n;
+}
+
+
+/*!
+ * \brief Sha512MultiBuffer::availableKernels
+ *
+ * \param kernels Receives a pointer to the list of kernels usable on this CPU, ordered by increasing lane count.
+ * \return Number of kernels in the list.
+ */
+int Sha512MultiBuffer::availableKernels(const Sha512MultiBuffer::Kernel **kernels)
+{
+  static Kernel available[3];
+  static const int n = collectKernels(available);
+  *kernels = available;
+  return n;
+}
+
+
+/*!
+ * \brief Sha512MultiBuffer::bestKernel
+ *
+ * \return The kernel with the most lanes supported by this CPU.
+ */
+const Sha512MultiBuffer::Kernel &Sha512MultiBuffer::bestKernel(void)
+{
+  const Kernel *kernels;
+  const int n = availableKernels(&kernels);
+  return kernels[n - 1];
+}
+
+
+/*!
+ * \brief Sha512MultiBuffer::pbkdf2
+ *
+ * Derives PBKDF2-HMAC-SHA512 keys for all `jobs`.
+ *
+ * Every lane of `kernel` works on its own job. The lanes run in lock step
+ * until the job with the fewest remaining iterations is done; its result is
+ * stored and the lane is refilled with the next pending job. That way jobs
+ * with differing iteration counts still keep all lanes busy. The last job
+ * is finished on the scalar path instead of dragging idle lanes along.
+ *
+ * Each job's `derivedKey` must point to `Sha512::DigestSize` writable bytes.
+ */
+void Sha512MultiBuffer::pbkdf2(const Sha512MultiBuffer::Job *jobs, int count, const Sha512MultiBuffer::Kernel &kernel)
+{
+  static const int DW = Sha512::DigestWords;
+  static const int BW = Sha512::BlockWords;
+  const int L = kernel.lanes;
+  quint64 inner[DW * MaxLanes];
+  quint64 outer[DW * MaxLanes];
+  quint64 block[BW * MaxLanes];
+  quint64 acc[DW * MaxLanes];
+  quint64 state[DW * MaxLanes];
+  int laneJob[MaxLanes];
+  int remaining[MaxLanes];
+  memset(block, 0, sizeof(block));
+  memset(inner, 0, sizeof(inner));
+  memset(outer, 0, sizeof(outer));
+  memset(acc, 0, sizeof(acc));
+  int next = 0;
+  int active = 0;
+
+  auto fill = [&](int lane) -> bool {
+    while (next < count) {
+      const Job &job = jobs[next];
+      const HMACEngine<Sha512> hmac(job.pwd, job.pwdSize);
+      HMACEngine<Sha512>::PBKDF2Chain chain;
+      hmac.beginPBKDF2(job.salt, job.saltSize, chain);
+      if (job.iterations <= 1) {
+        HMACEngine<Sha512>::finishPBKDF2(chain, job.derivedKey);
+        ++next;
+        continue;
+      }
+      for (int w = 0; w < DW; ++w) {
+        inner[w * L + lane] = hmac.innerState()[w];
+        outer[w * L + lane] = hmac.outerState()[w];
+        acc[w * L + lane] = chain.acc[w];
+      }
+      for (int w = 0; w < BW; ++w) {
+        block[w * L + lane] = chain.block[w];
+      }
+      laneJob[lane] = next++;
+      remaining[lane] = job.iterations - 1;
+      return true;
+    }
+    laneJob[lane] = -1;
+    return false;
+  };
+
+  auto retire = [&](int lane) {
+    quint64 digest[DW];
+    for (int w = 0; w < DW; ++w) {
+      digest[w] = acc[w * L + lane];
+    }
+    storeBigEndian(jobs[laneJob[lane]].derivedKey, digest, DW);
+    SecureErase(digest, sizeof(digest));
+  };
+
+  for (int lane = 0; lane < L; ++lane) {
+    if (fill(lane)) {
+      ++active;
+    }
+  }
+
+  while (active > 1 || (active == 1 && L == 1)) {
+    int steps = INT_MAX;
+    for (int lane = 0; lane < L; ++lane) {
+      if (laneJob[lane] >= 0) {
+        steps = qMin(steps, remaining[lane]);
+      }
+    }
+    for (int i = 0; i < steps; ++i) {
+      memcpy(state, inner, DW * L * sizeof(quint64));
+      kernel.transform(state, block);
+      memcpy(block, state, DW * L * sizeof(quint64));
+      memcpy(state, outer, DW * L * sizeof(quint64));
+      kernel.transform(state, block);
+      memcpy(block, state, DW * L * sizeof(quint64));
+      for (int w = 0; w < DW * L; ++w) {
+        acc[w] ^= state[w];
+      }
+    }
+    for (int lane = 0; lane < L; ++lane) {
+      if (laneJob[lane] >= 0) {
+        remaining[lane] -= steps;
+        if (remaining[lane] == 0) {
+          retire(lane);
+          if (!fill(lane)) {
+            --active;
+          }
+        }
+      }
+    }
+  }
+
+  if (active == 1) {
+    int lane = 0;
+    while (laneJob[lane] < 0) {
+      ++lane;
+    }
+    quint64 laneInner[DW], laneOuter[DW], laneBlock[BW], laneAcc[DW], laneState[DW];
+    for (int w = 0; w < DW; ++w) {
+      laneInner[w] = inner[w * L + lane];
+      laneOuter[w] = outer[w * L + lane];
+      laneAcc[w] = acc[w * L + lane];
+    }
+    for (int w = 0; w < BW; ++w) {
+      laneBlock[w] = block[w * L + lane];
+    }
+    for (int i = 0; i < remaining[lane]; ++i) {
+      memcpy(laneState, laneInner, sizeof(laneState));
+      Sha512::transform(laneState, laneBlock);
+      memcpy(laneBlock, laneState, sizeof(laneState));
+      memcpy(laneState, laneOuter, sizeof(laneState));
+      Sha512::transform(laneState, laneBlock);
+      for (int w = 0; w < DW; ++w) {
+        laneBlock[w] = laneState[w];
+        laneAcc[w] ^= laneState[w];
+      }
+    }
+    storeBigEndian(jobs[laneJob[lane]].derivedKey, laneAcc, DW);
+    SecureErase(laneInner, sizeof(laneInner));
+    SecureErase(laneOuter, sizeof(laneOuter));
+    SecureErase(laneBlock, sizeof(laneBlock));
+    SecureErase(laneAcc, sizeof(laneAcc));
+    SecureErase(laneState, sizeof(laneState));
+  }
+
+  SecureErase(inner, sizeof(inner));
+  SecureErase(outer, sizeof(outer));
+  SecureErase(block, sizeof(block));
+  SecureErase(acc, sizeof(acc));
+  SecureErase(state, sizeof(state));
+}
@@ -0,0 +1,67 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SHA512MULTIBUFFER_H_
+#define __SHA512MULTIBUFFER_H_
+
+#include <QtGlobal>
+
+
+/*!
+ * \brief The Sha512MultiBuffer class
+ *
+ * SHA-512 compression of several independent messages at once.
+ *
+ * A kernel processes `lanes` messages in parallel. State and message words are
+ * interleaved by lane, i.e. word `w` of lane `l` lives at index `w * lanes + l`,
+ * so that one SIMD register holds the same word of every lane.
+ *
+ * Kernels for AVX2 (4 lanes) and AVX-512 (8 lanes) are selected at runtime if
+ * the CPU supports them; the portable `Sha512::transform()` serves as the
+ * single-lane fallback.
+ */
+class Sha512MultiBuffer
+{
+public:
+  enum { MaxLanes = 8 };
+
+  typedef void (*Transform)(quint64 *state, const quint64 *block);
+
+  struct Kernel {
+    const char *name;
+    int lanes;
+    Transform transform;
+  };
+
+  struct Job {
+    const char *pwd;
+    int pwdSize;
+    const char *salt;
+    int saltSize;
+    int iterations;
+    uchar *derivedKey;
+  };
+
+  static int availableKernels(const Kernel **kernels);
+  static const Kernel &bestKernel(void);
+  static void pbkdf2(const Job *jobs, int count, const Kernel &kernel = bestKernel());
+};
+
+
+#endif // __SHA512MULTIBUFFER_H_
@@ -0,0 +1,147 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "speculativederiver.h"
+#include "derivedkeycache.h"
+#include "cancellationtoken.h"
+#include "password.h"
+#include "derivation.h"
+
+#include "cryptoexecutor.h"
+
+#include <QFuture>
+#include <QList>
+#include <QSharedPointer>
+
+
+const int SpeculativeDeriver::MaxCandidates = 2;
+
+
+class SpeculativeDeriverPrivate {
+public:
+  SpeculativeDeriverPrivate(DerivedKeyCache *cache)
+    : cache(cache)
+    , token(new CancellationToken)
+    , tag(QString("speculation:%1").arg(quintptr(this), 0, 16))
+  { /* ... */ }
+  ~SpeculativeDeriverPrivate()
+  {
+    CryptoExecutor::instance().cancel(tag);
+    token->cancel();
+    waitForDone();
+  }
+  void waitForDone(void)
+  {
+    foreach (QFuture<void> future, futures) {
+      future.waitForFinished();
+    }
+    futures.clear();
+  }
+  static void derive(DerivedKeyCache *cache, const SecureByteArray &key, const DomainSettings &ds, QSharedPointer<CancellationToken> token);
+  DerivedKeyCache *cache;
+  QSharedPointer<CancellationToken> token;
+  const QString tag;
+  QList<QFuture<void> > futures;
+};
+
+
+void SpeculativeDeriverPrivate::derive(DerivedKeyCache *cache, const SecureByteArray &key, const DomainSettings &ds, QSharedPointer<CancellationToken> token)
+{
+  if (token->isCancelled())
+    return;
+  const QByteArray &fingerprint = Password::keyFingerprint(key, ds);
+  if (cache->contains(fingerprint))
+    return;
+  DerivationRequest request(key, ds);
+  request.passwordTemplate.clear();
+  const DerivationResult &result = Derivation::derive(request, token.data());
+  if (!result.aborted) {
+    cache->insert(fingerprint, result.derivedKey);
+  }
+}
+
+
+SpeculativeDeriver::SpeculativeDeriver(DerivedKeyCache *cache)
+  : d_ptr(new SpeculativeDeriverPrivate(cache))
+{ /* ... */ }
+
+
+SpeculativeDeriver::~SpeculativeDeriver()
+{ /* ... */ }
+
+
+/*!
+ * \brief SpeculativeDeriver::speculate
+ *
+ * Cancels all running speculative derivations and starts deriving the keys
+ * for the first `MaxCandidates` of `candidates` that are neither deleted nor
+ * have a legacy password and whose keys are not cached yet. Returns immediately.
+ */
+void SpeculativeDeriver::speculate(const SecureByteArray &key, const DomainSettingsList &candidates)
+{
+  Q_D(SpeculativeDeriver);
+  cancel();
+  int n = 0;
+  foreach (const DomainSettings &ds, candidates) {
+    if (n == MaxCandidates)
+      break;
+    if (ds.deleted || !ds.legacyPassword.isEmpty())
+      continue;
+    DerivedKeyCache *cache = d->cache;
+    const QSharedPointer<CancellationToken> token = d->token;
+    d->futures.append(CryptoExecutor::instance().run(CryptoExecutor::Background, d->tag, [cache, key, ds, token]() {
+      SpeculativeDeriverPrivate::derive(cache, key, ds, token);
+    }));
+    ++n;
+  }
+}
+
+
+/*!
+ * \brief SpeculativeDeriver::cancel
+ *
+ * Asks all running speculative derivations to stop. Does not wait for them;
+ * derivations cancelled this way don't touch the cache.
+ */
+void SpeculativeDeriver::cancel(void)
+{
+  Q_D(SpeculativeDeriver);
+  CryptoExecutor::instance().cancel(d->tag);
+  d->token->cancel();
+  d->token = QSharedPointer<CancellationToken>(new CancellationToken);
+  for (QList<QFuture<void> >::iterator f = d->futures.begin(); f != d->futures.end(); ) {
+    if (f->isFinished()) {
+      f = d->futures.erase(f);
+    }
+    else {
+      ++f;
+    }
+  }
+}
+
+
+/*!
+ * \brief SpeculativeDeriver::waitForDone
+ *
+ * Blocks until all speculative derivations have finished or stopped.
+ */
+void SpeculativeDeriver::waitForDone(void)
+{
+  d_ptr->waitForDone();
+}
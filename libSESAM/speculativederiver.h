@@ -0,0 +1,61 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SPECULATIVEDERIVER_H_
+#define __SPECULATIVEDERIVER_H_
+
+#include <QScopedPointer>
+
+#include "domainsettingslist.h"
+#include "securebytearray.h"
+
+class DerivedKeyCache;
+class SpeculativeDeriverPrivate;
+
+/*!
+ * \brief The SpeculativeDeriver class
+ *
+ * `SpeculativeDeriver` derives the keys of domains the user is likely
+ * to select next and puts them into a `DerivedKeyCache`, from where
+ * `Password::update()` picks them up without running PBKDF2.
+ *
+ * The work runs in the `CryptoExecutor::Background` class, which always
+ * leaves a thread free for interactive work. Each call to `speculate()`
+ * cancels the derivations started by the previous call.
+ */
+class SpeculativeDeriver
+{
+public:
+  explicit SpeculativeDeriver(DerivedKeyCache *cache);
+  ~SpeculativeDeriver();
+
+  static const int MaxCandidates;
+
+  void speculate(const SecureByteArray &key, const DomainSettingsList &candidates);
+  void cancel(void);
+  void waitForDone(void);
+
+private:
+  QScopedPointer<SpeculativeDeriverPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(SpeculativeDeriver)
+  Q_DISABLE_COPY(SpeculativeDeriver)
+};
+
+
+#endif // __SPECULATIVEDERIVER_H_
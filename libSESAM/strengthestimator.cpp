@@ -0,0 +1,930 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "strengthestimator.h"
+
+#include <QHash>
+#include <QDate>
+#include <QStringList>
+#include <QtMath>
+
+#include <cmath>
+#include <limits>
+
+namespace {
+
+  /* Frequency tables, most frequent first. An entry's rank is its position
+   * in the list; if a word occurs in several lists, the lowest rank counts.
+   */
+  const char *const CommonPasswords[] = {
+    "123456", "password", "12345678", "qwerty", "123456789", "12345", "1234", "111111",
+    "1234567", "dragon", "123123", "baseball", "abc123", "football", "monkey", "letmein",
+    "696969", "shadow", "master", "666666", "qwertyuiop", "123321", "mustang", "1234567890",
+    "michael", "654321", "pussy", "superman", "1qaz2wsx", "7777777", "fuckyou", "121212",
+    "000000", "qazwsx", "123qwe", "killer", "trustno1", "jordan", "jennifer", "zxcvbnm",
+    "asdfgh", "hunter", "buster", "soccer", "harley", "batman", "andrew", "tigger",
+    "sunshine", "iloveyou", "fuckme", "2000", "charlie", "robert", "thomas", "hockey",
+    "ranger", "daniel", "starwars", "klaster", "112233", "george", "asshole", "computer",
+    "michelle", "jessica", "pepper", "1111", "zxcvbn", "555555", "11111111", "131313",
+    "freedom", "777777", "pass", "fuck", "maggie", "159753", "aaaaaa", "ginger",
+    "princess", "joshua", "cheese", "amanda", "summer", "love", "ashley", "6969",
+    "nicole", "chelsea", "biteme", "matthew", "access", "yankees", "987654321", "dallas",
+    "austin", "thunder", "taylor", "matrix", "william", "corvette", "hello", "martin",
+    "heather", "secret", "fucker", "merlin", "diamond", "1234qwer", "gfhjkm", "hammer",
+    "silver", "222222", "88888888", "anthony", "justin", "test", "bailey", "q1w2e3r4t5",
+    "patrick", "internet", "scooter", "orange", "11111", "golfer", "cookie", "richard",
+    "samantha", "bigdog", "guitar", "jackson", "whatever", "mickey", "chicken", "sparky",
+    "snoopy", "maverick", "phoenix", "camaro", "sexy", "peanut", "morgan", "welcome",
+    "falcon", "cowboy", "ferrari", "samsung", "andrea", "smokey", "steelers", "joseph",
+    "mercedes", "dakota", "arsenal", "eagles", "melissa", "boomer", "booboo", "spider",
+    "nascar", "monster", "tigers", "yellow", "xxxxxx", "123123123", "gateway", "marina",
+    "diablo", "bulldog", "qwer1234", "compaq", "purple", "hardcore", "banana", "junior",
+    "hannah", "123654", "porsche", "lakers", "iceman", "money", "cowboys", "987654",
+    "london", "tennis", "999999", "ncc1701", "coffee", "scooby", "0000", "miller",
+    "boston", "q1w2e3r4", "fuckoff", "brandon", "yamaha", "chester", "mother", "forever",
+    "johnny", "edward", "333333", "oliver", "redsox", "player", "nikita", "knight",
+    "fender", "barney", "midnight", "please", "brandy", "chicago", "badboy", "iwantu",
+    "slayer", "rangers", "charles", "angel", "flower", "bigdaddy", "rabbit", "wizard",
+    "bigdick", "jasper", "enter", "rachel", "chris", "steven", "winner", "adidas",
+    "victoria", "natasha", "1q2w3e4r", "jasmine", "winter", "prince", "panties", "marine",
+    "ghbdtn", "fishing", "cocacola", "casper", "james", "232323", "raiders", "888888",
+    "marlboro", "gandalf", "asdfasdf", "crystal", "87654321", "12344321", "sexsex", "golden",
+    "blowme", "bigtits", "8675309", "panther", "lauren", "angela", "bitch", "spanky",
+    "thx1138", "angels", "madison", "winston", "shannon", "mike", "toyota", "blowjob",
+    "jordan23", "canada", "sophie", "apples", "dick", "tiger", "razz", "123abc",
+    "pokemon", "qazxsw", "55555", "qwaszx", "muffin", "johnson", "murphy", "cooper",
+    "jonathan", "liverpoo", "david", "danielle", "159357", "jackie", "1990", "123456a",
+    "789456", "turtle", "horny", "abcd1234", "scorpion", "qazwsxedc", "101010", "butter",
+    "carlos", "password1", "dennis", "slipknot", "qwerty123", "booger", "asdf", "1991",
+    "black", "startrek", "12341234", "cameron", "newyork", "rainbow", "nathan", "john",
+    "1992", "rocket", "viking", "redskins", "butthead", "asdfghjkl", "1212", "sierra",
+    "peaches", "gemini", "doctor", "wilson", "sandra", "helpme", "qwertyui", "victor",
+    "florida", "dolphin", "pookie", "captain", "tucker", "blue", "liverpool", "theman",
+    "bandit", "dolphins", "maddog", "packers", "jaguar", "lovers", "nicholas", "united",
+    "tiffany", "maxwell", "zzzzzz", "nirvana", "jeremy", "suckit", "stupid", "porn",
+    "monica", "elephant", "giants", "jackass", "hotdog", "rosebud", "success", "debbie",
+    "mountain", "444444", "xxxxxxxx", "warrior", "1q2w3e4r5t", "q1w2e3", "123456q", "albert",
+    "metallic", "lucky", "azerty", "7777", "shithead", "alex", "bond007", "alexis",
+    "1111111", "samson", "5150", "willie", "scorpio", "bonnie", "gators", "benjamin",
+    "voodoo", "driver", "dexter", "2112", "jason", "calvin", "freddy", "212121",
+    "creative", "12345a", "sydney", "rush2112", "1989", "asdfghjk", "red123", "bubba",
+    "4815162342", "passw0rd", "trouble", "gunner", "happy", "fucking", "gordon", "legend",
+    "jessie", "stella", "qwert", "eminem", "arthur", "apple", "nissan", "bullshit",
+    "bear", "america", "1qazxsw2", "nothing", "parker", "4444", "rebecca", "qweqwe",
+    "garfield", "01012011", "beavis", "69696969", "jack", "asdasd", "december", "2222",
+    "102030", "252525", "11223344", "magic", "apollo", "skippy", "315475", "girls",
+    "kitten", "golf", "copper", "braves", "shelby", "godzilla", "beaver", "fred",
+    "tomcat", "august", "buddy", "airborne", "1993", "1988", "lifehack", "qqqqqq",
+    "brooklyn", "animal", "platinum", "phantom", "online", "xavier", "darkness", "blink182",
+    "power", "fish", "green", "789789", "voyager", "police", "travis", "12qwaszx",
+    "heaven", "snowball", "lover", "abcdef", "00000", "pakistan", "007007", "walter",
+    "playboy", "blazer", "cricket", "sniper", "hooters", "donkey", "willow", "loveme",
+    "saturn", "therock", "redwings", "bigboy", "pumpkin", "trinity", "williams", "tits",
+    "nintendo", "digital", "destiny", "topgun", "runner", "marvin", "guinness", "chance",
+    "bubbles", "testing", "fire", "november", "minecraft", "asdf1234", "lasvegas", "sergey",
+    "broncos", "cartman", "private", "celtic", "birdie", "little", "cassie", "babygirl",
+    "donald", "beatles", "1313", "dickhead", "family", "12321", "school", "louise",
+    "gabriel", "eclipse", "fluffy", "147258369", "lol123", "explorer", "beer", "nelson",
+    "flyers", "spencer", "scott", "lovely", "gibson", "doggie", "cherry", "andrey",
+    "snickers", "buffalo", "pantera", "metallica", "member", "carter", "qwertyu", "peter",
+    "alexande", "steve", "bronco", "paradise", "goober", "5555", "samuel", "montana",
+    "mexico", "dreams", "michigan", "cock", "carolina", "yankee", "friends", "magnum",
+    "surfer", "poopoo", "maximus", "genius", "cool", "vampire", "lacrosse", "asd123",
+    "aaaa", "christin", "kimberly", "speedy", "sharon", "carmen", "111222", "kristina",
+    "sammy", "racing", "ou812", "sabrina", "horses", "0987654321", "qwerty1", "pimpin",
+    "baby", "stalker", "enigma", "147147", "star", "poohbear", "boobies", "147258",
+    "simple", "bollocks", "12345q", "marcus", "brian", "1987", "qweasdzxc", "drowssap",
+    "hahaha", "caroline", "barbara", "dave", "viper", "drummer", "action", "einstein",
+    "bitches", "genesis", "hello1", "scotty", "friend", "forest", "010203", "hotrod",
+    "google", "vanessa", "spitfire", "badger", "maryjane", "friday", "alaska", "1232323q",
+    "tester", "jester", "jake", "champion", "billy", "147852", "rock", "hawaii",
+    "badass", "chevy", "420420", "walker", "stephen", "eagle1", "bill", "1986",
+    "october", "gregory", "svetlana", "pamela", "1984", "music", "shorty", "westside",
+    "stanley", "diesel", "courtney", "242424", "kevin", "porno", "hitman", "boobs",
+    "mark", "12345qwert", "reddog", "frank", "qwe123", "popcorn", "patricia", "aaaaaaaa",
+    "1969", "teresa", "mozart", "buddha", "anderson", "paul", "melanie", "abcdefg",
+    "security", "lucky1", "lizard", "denise", "3333", "a12345", "123789", "ruslan",
+    "stargate", "simpsons", "scarface", "eagle", "123456789a", "thumper", "olivia", "naruto",
+    "1234554321", "general", "cherokee", "a123456", "vincent", "usuckballz1", "spooky", "qweasd",
+    "cumshot", "free", "frankie", "douglas", "death", "1980", "loveyou", "kitty",
+    "kelly", "veronica", "suzuki", "semperfi", "penguin", "mercury", "liberty", "spirit",
+    "scotland", "natalie", "marley", "vikings", "system", "sucker", "king", "allison",
+    "hallo", "hallo123", "passwort", "schatz", "ficken", "schalke04", "werder", "bayern",
+    "qwertz", "qwertzuiop", "asdfghjkl", "yxcvbnm", "geheim", "sommer", "blume", "fussball",
+    Q_NULLPTR
+  };
+
+  const char *const EnglishWords[] = {
+    "you", "the", "to", "and", "it", "that", "what", "of", "me", "is",
+    "in", "this", "know", "for", "no", "have", "my", "don", "just", "not",
+    "do", "be", "on", "your", "was", "we", "with", "so", "but", "all",
+    "well", "are", "he", "oh", "about", "right", "like", "here", "get", "yeah",
+    "out", "go", "if", "can", "up", "want", "think", "that's", "now", "there",
+    "one", "at", "they", "how", "good", "gonna", "come", "really", "let", "see",
+    "why", "look", "or", "from", "will", "time", "okay", "would", "yes", "his",
+    "who", "back", "never", "take", "some", "love", "man", "tell", "them", "then",
+    "make", "when", "been", "her", "she", "could", "more", "because", "him", "where",
+    "need", "thing", "sorry", "life", "mean", "little", "maybe", "sure", "thank", "much",
+    "way", "say", "should", "anything", "nothing", "first", "only", "great", "people", "night",
+    "something", "never", "gotta", "down", "please", "help", "hey", "guy", "thanks", "fine",
+    "home", "day", "money", "talk", "ever", "everything", "again", "hell", "work", "old",
+    "call", "girl", "better", "woman", "still", "stop", "leave", "dead", "world", "family",
+    "friend", "house", "hear", "stay", "father", "mother", "kill", "long", "keep", "place",
+    "last", "kind", "heart", "happy", "name", "believe", "baby", "little", "care", "boy",
+    "dream", "water", "fire", "light", "dark", "blue", "green", "black", "white", "summer",
+    "winter", "spring", "autumn", "sun", "moon", "star", "sky", "rain", "snow", "storm",
+    "tiger", "lion", "eagle", "wolf", "horse", "dog", "cat", "bird", "fish", "dragon",
+    "king", "queen", "prince", "princess", "angel", "devil", "god", "magic", "power", "secret",
+    "password", "computer", "internet", "login", "admin", "user", "welcome", "hello", "monkey", "master",
+    "correct", "battery", "staple", "horse", "apple", "orange", "banana", "cherry", "lemon", "chocolate",
+    Q_NULLPTR
+  };
+
+  const char *const GermanWords[] = {
+    "ich", "die", "der", "und", "nicht", "sie", "das", "ist", "du", "ein",
+    "es", "zu", "wir", "mit", "den", "ja", "mir", "was", "mich", "auf",
+    "dich", "sich", "hier", "eine", "von", "wie", "noch", "dass", "aber", "ihr",
+    "habe", "nein", "dir", "bin", "war", "wenn", "hat", "nur", "gut", "einen",
+    "kann", "jetzt", "mal", "so", "auch", "uns", "sind", "schon", "hast", "da",
+    "mein", "doch", "alles", "bitte", "los", "immer", "wird", "nach", "haben", "ihn",
+    "wieder", "oder", "weiß", "kommen", "danke", "warum", "leben", "liebe", "herz", "sonne",
+    "mond", "stern", "himmel", "wasser", "feuer", "erde", "luft", "sommer", "winter", "fruehling",
+    "herbst", "blume", "baum", "wald", "berg", "meer", "vogel", "hund", "katze", "pferd",
+    "maus", "tiger", "loewe", "adler", "drache", "koenig", "prinzessin", "engel", "teufel", "schatz",
+    "mama", "papa", "kind", "freund", "freundin", "familie", "haus", "schule", "arbeit", "geld",
+    "geheim", "passwort", "kennwort", "zugang", "hallo", "willkommen", "computer", "fussball", "schokolade", "kaffee",
+    "montag", "dienstag", "mittwoch", "donnerstag", "freitag", "samstag", "sonntag", "januar", "februar", "maerz",
+    "april", "mai", "juni", "juli", "august", "september", "oktober", "november", "dezember", "deutschland",
+    "berlin", "hamburg", "muenchen", "koeln", "frankfurt", "stuttgart", "hannover", "bayern", "schalke", "borussia",
+    Q_NULLPTR
+  };
+
+  const char *const Names[] = {
+    "michael", "thomas", "andreas", "stefan", "christian", "peter", "markus", "daniel", "alexander", "frank",
+    "martin", "jan", "tobias", "sebastian", "florian", "matthias", "david", "john", "james", "robert",
+    "william", "richard", "joseph", "charles", "george", "paul", "mark", "steven", "kevin", "brian",
+    "anna", "maria", "sabine", "julia", "laura", "lisa", "sarah", "katharina", "andrea", "stefanie",
+    "nicole", "claudia", "susanne", "petra", "sandra", "mary", "patricia", "linda", "barbara", "elizabeth",
+    "jennifer", "susan", "jessica", "emma", "olivia", "sophie", "hannah", "lena", "leon", "lukas",
+    "jonas", "finn", "elias", "noah", "ben", "paul", "felix", "max", "moritz", "oliver",
+    Q_NULLPTR
+  };
+
+  const char *const *const RankedLists[] = {
+    CommonPasswords, EnglishWords, GermanWords, Names
+  };
+
+  /* Keyboard layouts. Every token holds the unshifted and the shifted
+   * character of a key. Keys of a row start `offset` half keys to the
+   * right of the first key in the top row.
+   */
+  struct LayoutRow {
+    const char *tokens;
+    int offset;
+  };
+
+  const LayoutRow QwertyRows[] = {
+    { "`~ 1! 2@ 3# 4$ 5% 6^ 7& 8* 9( 0) -_ =+", 0 },
+    { "qQ wW eE rR tT yY uU iI oO pP [{ ]} \\|", 3 },
+    { "aA sS dD fF gG hH jJ kK lL ;: '\"", 4 },
+    { "zZ xX cC vV bB nN mM ,< .> /?", 5 },
+    { Q_NULLPTR, 0 }
+  };
+
+  const LayoutRow QwertzRows[] = {
+    { "^° 1! 2\" 3§ 4$ 5% 6& 7/ 8( 9) 0= ß? ´`", 0 },
+    { "qQ wW eE rR tT zZ uU iI oO pP üÜ +*", 3 },
+    { "aA sS dD fF gG hH jJ kK lL öÖ äÄ #'", 4 },
+    { "<> yY xX cC vV bB nN mM ,; .: -_", 3 },
+    { Q_NULLPTR, 0 }
+  };
+
+  const LayoutRow KeypadRows[] = {
+    { "/ * -", 2 },
+    { "7 8 9 +", 0 },
+    { "4 5 6", 0 },
+    { "1 2 3", 0 },
+    { "0 .", 0 },
+    { Q_NULLPTR, 0 }
+  };
+
+  const int MinWordLength = 3;
+  const int MaxWordLength = 24;
+  const int MinYearSpace = 20;
+  const int MinYear = 1000;
+  const int MaxYear = 2050;
+  // zxcvbn's MIN_GUESSES_BEFORE_GROWING_SEQUENCE
+  const qreal SequenceGrowthLog10 = 4;
+  const qreal BruteforceCardinalityLog10 = 1;
+  const qreal Log10Two = 0.30102999566398120;
+
+
+  struct Key {
+    int x2;
+    int y;
+    bool shifted;
+  };
+
+
+  struct Graph {
+    QHash<QChar, Key> keys;
+    bool slanted;
+    int keyCount;
+    qreal averageDegree;
+
+    // \return an id for the direction from `a` to `b`, or -1 if they aren't adjacent
+    int direction(const Key &a, const Key &b) const
+    {
+      const int dx = b.x2 - a.x2;
+      const int dy = b.y - a.y;
+      const bool adjacent = slanted
+          ? (dy == 0 && qAbs(dx) == 2) || (qAbs(dy) == 1 && qAbs(dx) == 1)
+          : qAbs(dy) <= 1 && qAbs(dx) <= 2 && (dx != 0 || dy != 0);
+      return adjacent ? (dy + 1) * 5 + dx + 2 : -1;
+    }
+  };
+
+
+  struct Tables {
+    QHash<QString, int> ranks;
+    QVector<Graph> graphs;
+
+    Tables(void)
+    {
+      for (size_t l = 0; l < sizeof(RankedLists) / sizeof(RankedLists[0]); ++l) {
+        for (int i = 0; RankedLists[l][i] != Q_NULLPTR; ++i) {
+          const QString &word = QString::fromUtf8(RankedLists[l][i]);
+          const int rank = ranks.value(word, i + 1);
+          ranks.insert(word, qMin(rank, i + 1));
+        }
+      }
+      graphs.append(makeGraph(QwertyRows, true));
+      graphs.append(makeGraph(QwertzRows, true));
+      graphs.append(makeGraph(KeypadRows, false));
+    }
+
+    static Graph makeGraph(const LayoutRow *rows, bool slanted)
+    {
+      Graph g;
+      g.slanted = slanted;
+      QVector<Key> positions;
+      for (int y = 0; rows[y].tokens != Q_NULLPTR; ++y) {
+        const QStringList &tokens = QString::fromUtf8(rows[y].tokens).split(' ', QString::SkipEmptyParts);
+        for (int k = 0; k < tokens.size(); ++k) {
+          Key key = { 2 * k + rows[y].offset, y, false };
+          positions.append(key);
+          g.keys.insert(tokens.at(k).at(0), key);
+          if (tokens.at(k).size() > 1) {
+            key.shifted = true;
+            g.keys.insert(tokens.at(k).at(1), key);
+          }
+        }
+      }
+      int degrees = 0;
+      foreach (const Key &a, positions) {
+        foreach (const Key &b, positions) {
+          if (g.direction(a, b) >= 0) {
+            ++degrees;
+          }
+        }
+      }
+      g.keyCount = positions.size();
+      g.averageDegree = qreal(degrees) / qreal(g.keyCount);
+      return g;
+    }
+  };
+
+
+  const Tables &tables(void)
+  {
+    static const Tables t;
+    return t;
+  }
+
+
+  qreal binomial(int n, int k)
+  {
+    if (k < 0 || k > n)
+      return 0;
+    qreal r = 1;
+    for (int d = 1; d <= k; ++d) {
+      r = r * (n - d + 1) / d;
+    }
+    return r;
+  }
+
+
+  qreal log10Factorial(int n)
+  {
+    return std::lgamma(n + 1.0) / M_LN10;
+  }
+
+
+  // \return log10(10^a + 10^b)
+  qreal log10Sum(qreal a, qreal b)
+  {
+    const qreal hi = qMax(a, b);
+    const qreal lo = qMin(a, b);
+    return hi + std::log10(1 + std::pow(10.0, lo - hi));
+  }
+
+
+  qreal uppercaseVariationsLog10(const QString &token)
+  {
+    int upper = 0;
+    int lower = 0;
+    foreach (const QChar &c, token) {
+      if (c.isUpper()) {
+        ++upper;
+      }
+      else if (c.isLower()) {
+        ++lower;
+      }
+    }
+    if (upper == 0)
+      return 0;
+    if (lower == 0 || (upper == 1 && (token.at(0).isUpper() || token.at(token.size() - 1).isUpper())))
+      return Log10Two;
+    qreal variations = 0;
+    for (int i = 1; i <= qMin(upper, lower); ++i) {
+      variations += binomial(upper + lower, i);
+    }
+    return std::log10(variations);
+  }
+
+
+  QChar unl33t(QChar c, bool one2l)
+  {
+    switch (c.unicode()) {
+    case '4': case '@': return 'a';
+    case '8': return 'b';
+    case '(': case '{': case '[': case '<': return 'c';
+    case '3': return 'e';
+    case '6': case '9': return 'g';
+    case '1': case '!': case '|': return one2l ? 'l' : 'i';
+    case '0': return 'o';
+    case '$': case '5': return 's';
+    case '7': case '+': return 't';
+    case '%': return 'x';
+    case '2': return 'z';
+    default: return c;
+    }
+  }
+
+
+  qreal l33tVariationsLog10(const QString &token, const QString &plain)
+  {
+    QHash<QChar, QChar> subs;
+    for (int i = 0; i < token.size(); ++i) {
+      if (token.at(i) != plain.at(i)) {
+        subs.insert(token.at(i), plain.at(i));
+      }
+    }
+    qreal variations = 0;
+    for (QHash<QChar, QChar>::const_iterator sub = subs.constBegin(); sub != subs.constEnd(); ++sub) {
+      const int subbed = token.count(sub.key());
+      const int unsubbed = token.count(sub.value());
+      if (unsubbed == 0) {
+        variations += Log10Two;
+      }
+      else {
+        qreal v = 0;
+        for (int i = 1; i <= qMin(subbed, unsubbed); ++i) {
+          v += binomial(subbed + unsubbed, i);
+        }
+        variations += std::log10(v);
+      }
+    }
+    return variations;
+  }
+
+
+  qreal spatialGuessesLog10(const Graph &g, int length, int turns, int shifted, int unshifted)
+  {
+    qreal guesses = 0;
+    for (int i = 2; i <= length; ++i) {
+      const int possibleTurns = qMin(turns, i - 1);
+      for (int j = 1; j <= possibleTurns; ++j) {
+        guesses += binomial(i - 1, j - 1) * g.keyCount * std::pow(g.averageDegree, j);
+      }
+    }
+    if (shifted > 0) {
+      if (unshifted == 0) {
+        guesses *= 2;
+      }
+      else {
+        qreal variations = 0;
+        for (int i = 1; i <= qMin(shifted, unshifted); ++i) {
+          variations += binomial(shifted + unshifted, i);
+        }
+        guesses *= variations;
+      }
+    }
+    return std::log10(guesses);
+  }
+
+
+  bool validDate(int day, int month, int year, int yearDigits, int &fullYear)
+  {
+    if (day < 1 || day > 31 || month < 1 || month > 12)
+      return false;
+    if (yearDigits == 2) {
+      fullYear = year < 50 ? 2000 + year : 1900 + year;
+      return true;
+    }
+    fullYear = year;
+    return yearDigits == 4 && year >= MinYear && year <= MaxYear;
+  }
+
+
+  /* Tries to read `parts` (day, month and year in any of the orders d-m-y,
+   * m-d-y and y-m-d) as a date.
+   *
+   * \return the year that lies closest to `referenceYear`, or 0
+   */
+  int bestYear(const QStringList &parts, int referenceYear)
+  {
+    static const int Orders[3][3] = { { 0, 1, 2 }, { 1, 0, 2 }, { 2, 1, 0 } };
+    int best = 0;
+    for (int o = 0; o < 3; ++o) {
+      const QString &d = parts.at(Orders[o][0]);
+      const QString &m = parts.at(Orders[o][1]);
+      const QString &y = parts.at(Orders[o][2]);
+      if (d.size() > 2 || m.size() > 2)
+        continue;
+      int year;
+      if (validDate(d.toInt(), m.toInt(), y.toInt(), y.size(), year)) {
+        if (best == 0 || qAbs(year - referenceYear) < qAbs(best - referenceYear)) {
+          best = year;
+        }
+      }
+    }
+    return best;
+  }
+
+}
+
+
+class StrengthEstimatorPrivate
+{
+public:
+  StrengthEstimatorPrivate(void)
+    : referenceYear(QDate::currentDate().year())
+  { /* ... */ }
+  ~StrengthEstimatorPrivate()
+  { /* ... */ }
+
+  struct State {
+    qreal lpi;
+    qreal lg;
+    int match;
+    bool bruteforce;
+  };
+
+  // matches ending at one position and the best covers of the prefix up to it
+  struct Row {
+    QVector<StrengthEstimator::Match> matches;
+    QVector<State> states;
+    int bestLength;
+  };
+
+  void addMatch(Row &row, StrengthEstimator::Pattern pattern, int i, int j, qreal guessesLog10)
+  {
+    static const qreal MinMultiCharGuessesLog10 = std::log10(51.0);
+    StrengthEstimator::Match m;
+    m.pattern = pattern;
+    m.i = i;
+    m.j = j;
+    m.guessesLog10 = (pattern == StrengthEstimator::Bruteforce) ? guessesLog10 : qMax(guessesLog10, MinMultiCharGuessesLog10);
+    row.matches.append(m);
+  }
+
+  void matchDictionary(Row &row, int n);
+  void matchSpatial(Row &row, int n);
+  void matchSequence(Row &row, int n);
+  void matchRepeat(Row &row, int n);
+  void matchDate(Row &row, int n);
+  void matchBruteforce(Row &row, int n);
+  void solve(Row &row, int n);
+  void push(QChar c);
+
+  QString password;
+  QString lower;
+  QVector<Row> rows;
+  QHash<QString, qreal> baseGuesses;
+  int referenceYear;
+};
+
+
+void StrengthEstimatorPrivate::matchDictionary(Row &row, int n)
+{
+  const QHash<QString, int> &ranks = tables().ranks;
+  for (int len = MinWordLength; len <= qMin(MaxWordLength, n + 1); ++len) {
+    const int i = n - len + 1;
+    const QString &token = password.mid(i, len);
+    const QString &word = lower.mid(i, len);
+    const qreal upper = uppercaseVariationsLog10(token);
+    int rank = ranks.value(word, 0);
+    if (rank > 0) {
+      addMatch(row, StrengthEstimator::Dictionary, i, n, std::log10(qreal(rank)) + upper);
+    }
+    QString reversed(len, Qt::Uninitialized);
+    for (int k = 0; k < len; ++k) {
+      reversed[k] = word.at(len - 1 - k);
+    }
+    if (reversed != word && (rank = ranks.value(reversed, 0)) > 0) {
+      addMatch(row, StrengthEstimator::ReversedDictionary, i, n, std::log10(qreal(rank)) + upper + Log10Two);
+    }
+    for (int variant = 0; variant < 2; ++variant) {
+      QString plain = word;
+      for (int k = 0; k < len; ++k) {
+        plain[k] = unl33t(word.at(k), variant == 1);
+      }
+      if (plain != word && (rank = ranks.value(plain, 0)) > 0) {
+        addMatch(row, StrengthEstimator::L33tDictionary, i, n, std::log10(qreal(rank)) + upper + l33tVariationsLog10(word, plain));
+      }
+    }
+  }
+}
+
+
+void StrengthEstimatorPrivate::matchSpatial(Row &row, int n)
+{
+  foreach (const Graph &g, tables().graphs) {
+    QHash<QChar, Key>::const_iterator last = g.keys.constFind(password.at(n));
+    if (last == g.keys.constEnd())
+      continue;
+    int shifted = last->shifted ? 1 : 0;
+    int turns = 0;
+    int frontDirection = -1;
+    Key front = *last;
+    for (int i = n - 1; i >= 0; --i) {
+      QHash<QChar, Key>::const_iterator key = g.keys.constFind(password.at(i));
+      if (key == g.keys.constEnd())
+        break;
+      const int dir = g.direction(*key, front);
+      if (dir < 0)
+        break;
+      if (dir != frontDirection) {
+        ++turns;
+      }
+      frontDirection = dir;
+      front = *key;
+      if (key->shifted) {
+        ++shifted;
+      }
+      const int length = n - i + 1;
+      if (length >= 3) {
+        addMatch(row, StrengthEstimator::Spatial, i, n, spatialGuessesLog10(g, length, turns, shifted, length - shifted));
+      }
+    }
+  }
+}
+
+
+void StrengthEstimatorPrivate::matchSequence(Row &row, int n)
+{
+  if (n < 2)
+    return;
+  const int delta = password.at(n).unicode() - password.at(n - 1).unicode();
+  if (delta == 0 || qAbs(delta) > 5)
+    return;
+  for (int i = n - 2; i >= 0 && password.at(i + 1).unicode() - password.at(i).unicode() == delta; --i) {
+    const QChar first = password.at(i);
+    qreal base;
+    if (QString("aAzZ019").contains(first)) {
+      base = 4;
+    }
+    else if (first.isDigit()) {
+      base = 10;
+    }
+    else {
+      base = 26;
+    }
+    if (delta < 0) {
+      base *= 2;
+    }
+    addMatch(row, StrengthEstimator::Sequence, i, n, std::log10(base * (n - i + 1)));
+  }
+}
+
+
+void StrengthEstimatorPrivate::matchRepeat(Row &row, int n)
+{
+  for (int len = 1; 2 * len <= n + 1; ++len) {
+    const QString &base = password.mid(n - len + 1, len);
+    qreal baseLog10 = -1;
+    for (int count = 2; count * len <= n + 1; ++count) {
+      const int i = n - count * len + 1;
+      if (password.midRef(i, len) != base)
+        break;
+      if (baseLog10 < 0) {
+        QHash<QString, qreal>::const_iterator cached = baseGuesses.constFind(base);
+        if (cached == baseGuesses.constEnd()) {
+          cached = baseGuesses.insert(base, StrengthEstimator::guessesLog10(base));
+        }
+        baseLog10 = cached.value();
+      }
+      addMatch(row, StrengthEstimator::Repeat, i, n, baseLog10 + std::log10(qreal(count)));
+    }
+  }
+}
+
+
+void StrengthEstimatorPrivate::matchDate(Row &row, int n)
+{
+  static const QString Separators = " /\\_.-";
+  for (int len = 4; len <= qMin(10, n + 1); ++len) {
+    const int i = n - len + 1;
+    const QString &token = password.mid(i, len);
+    int firstNonDigit = -1;
+    for (int k = 0; k < len && firstNonDigit < 0; ++k) {
+      if (!token.at(k).isDigit()) {
+        firstNonDigit = k;
+      }
+    }
+    int year = 0;
+    qreal factor = 1;
+    if (firstNonDigit < 0) {
+      const int number = token.toInt();
+      if (len == 4 && number >= 1900 && number <= MaxYear) {
+        addMatch(row, StrengthEstimator::Date, i, n, std::log10(qreal(qMax(MinYearSpace, qAbs(number - referenceYear)))));
+      }
+      if (len > 8)
+        continue;
+      for (int yearDigits = 2; yearDigits <= 4; yearDigits += 2) {
+        for (int a = 1; a <= 2; ++a) {
+          const int b = len - yearDigits - a;
+          if (b < 1 || b > 2)
+            continue;
+          const QStringList yearLast = QStringList() << token.left(a) << token.mid(a, b) << token.right(yearDigits);
+          const QStringList yearFirst = QStringList() << token.left(yearDigits) << token.mid(yearDigits, a) << token.right(b);
+          foreach (int y, QList<int>() << bestYear(yearLast, referenceYear) << bestYear(yearFirst, referenceYear)) {
+            if (y != 0 && (year == 0 || qAbs(y - referenceYear) < qAbs(year - referenceYear))) {
+              year = y;
+            }
+          }
+        }
+      }
+    }
+    else {
+      const QChar sep = token.at(firstNonDigit);
+      if (!Separators.contains(sep))
+        continue;
+      const QStringList &parts = token.split(sep);
+      bool ok = parts.size() == 3;
+      foreach (const QString &part, parts) {
+        ok = ok && part.size() >= 1 && part.size() <= 4;
+        foreach (const QChar &c, part) {
+          ok = ok && c.isDigit();
+        }
+      }
+      if (!ok)
+        continue;
+      year = bestYear(parts, referenceYear);
+      factor = 4;
+    }
+    if (year != 0) {
+      addMatch(row, StrengthEstimator::Date, i, n, std::log10(365.0 * qMax(MinYearSpace, qAbs(year - referenceYear)) * factor));
+    }
+  }
+}
+
+
+void StrengthEstimatorPrivate::matchBruteforce(Row &row, int n)
+{
+  static const qreal SingleCharGuessesLog10 = std::log10(11.0);
+  for (int i = n; i >= 0; --i) {
+    const int length = n - i + 1;
+    addMatch(row, StrengthEstimator::Bruteforce, i, n, length == 1 ? SingleCharGuessesLog10 : length * BruteforceCardinalityLog10);
+  }
+}
+
+
+/* Finds the cheapest covers of the password up to `n` for every number of
+ * matches, following zxcvbn: a cover of `l` matches costs
+ * l! * (product of the matches' guesses) + 10000^(l - 1).
+ * Consecutive brute-force matches are not combined, as a single longer one
+ * covers the same characters.
+ */
+void StrengthEstimatorPrivate::solve(Row &row, int n)
+{
+  State none;
+  none.lpi = 0;
+  none.lg = std::numeric_limits<qreal>::infinity();
+  none.match = -1;
+  none.bruteforce = false;
+  row.states.fill(none, n + 2);
+  for (int mi = 0; mi < row.matches.size(); ++mi) {
+    const StrengthEstimator::Match &m = row.matches.at(mi);
+    const bool bruteforce = m.pattern == StrengthEstimator::Bruteforce;
+    if (m.i == 0) {
+      State s = { m.guessesLog10, log10Sum(m.guessesLog10, 0), mi, bruteforce };
+      if (s.lg < row.states.at(1).lg) {
+        row.states[1] = s;
+      }
+      continue;
+    }
+    const QVector<State> &previous = rows.at(m.i - 1).states;
+    for (int l = 1; l < previous.size(); ++l) {
+      const State &p = previous.at(l);
+      if (p.match < 0 || (bruteforce && p.bruteforce))
+        continue;
+      const qreal lpi = p.lpi + m.guessesLog10;
+      State s = { lpi, log10Sum(log10Factorial(l + 1) + lpi, SequenceGrowthLog10 * l), mi, bruteforce };
+      if (s.lg < row.states.at(l + 1).lg) {
+        row.states[l + 1] = s;
+      }
+    }
+  }
+  row.bestLength = 1;
+  for (int l = 2; l < row.states.size(); ++l) {
+    if (row.states.at(l).lg < row.states.at(row.bestLength).lg) {
+      row.bestLength = l;
+    }
+  }
+}
+
+
+void StrengthEstimatorPrivate::push(QChar c)
+{
+  password.append(c);
+  lower.append(c.toLower());
+  const int n = password.size() - 1;
+  rows.append(Row());
+  Row &row = rows.last();
+  matchDictionary(row, n);
+  matchSpatial(row, n);
+  matchSequence(row, n);
+  matchRepeat(row, n);
+  matchDate(row, n);
+  matchBruteforce(row, n);
+  solve(row, n);
+}
+
+
+StrengthEstimator::StrengthEstimator(void)
+  : d_ptr(new StrengthEstimatorPrivate)
+{ /* ... */ }
+
+
+StrengthEstimator::~StrengthEstimator()
+{ /* ... */ }
+
+
+/*!
+ * \brief StrengthEstimator::setPassword
+ *
+ * Replaces the password. Only the characters after the common prefix of
+ * the old and the new password are evaluated.
+ */
+void StrengthEstimator::setPassword(const QString &password)
+{
+  Q_D(StrengthEstimator);
+  int common = 0;
+  const int maxCommon = qMin(password.size(), d->password.size());
+  while (common < maxCommon && password.at(common) == d->password.at(common)) {
+    ++common;
+  }
+  chop(d->password.size() - common);
+  append(password.mid(common));
+}
+
+
+void StrengthEstimator::append(const QString &chars)
+{
+  Q_D(StrengthEstimator);
+  foreach (const QChar &c, chars) {
+    d->push(c);
+  }
+}
+
+
+void StrengthEstimator::chop(int n)
+{
+  Q_D(StrengthEstimator);
+  n = qBound(0, n, d->password.size());
+  d->password.chop(n);
+  d->lower.chop(n);
+  d->rows.resize(d->password.size());
+}
+
+
+/*!
+ * \brief StrengthEstimator::clear
+ *
+ * Forgets the password and overwrites the estimator's copies of it.
+ */
+void StrengthEstimator::clear(void)
+{
+  Q_D(StrengthEstimator);
+  d->password.fill(QChar());
+  d->lower.fill(QChar());
+  d->password.clear();
+  d->lower.clear();
+  d->rows.clear();
+  d->baseGuesses.clear();
+}
+
+
+const QString &StrengthEstimator::password(void) const
+{
+  return d_ptr->password;
+}
+
+
+/*!
+ * \brief StrengthEstimator::guessesLog10
+ *
+ * \return The decimal logarithm of the estimated number of guesses
+ * needed to find the password.
+ */
+qreal StrengthEstimator::guessesLog10(void) const
+{
+  if (d_ptr->rows.isEmpty())
+    return 0;
+  const StrengthEstimatorPrivate::Row &row = d_ptr->rows.last();
+  return row.states.at(row.bestLength).lg;
+}
+
+
+/*!
+ * \brief StrengthEstimator::score
+ *
+ * \return zxcvbn's score from 0 (too guessable) to 4 (very unguessable).
+ */
+int StrengthEstimator::score(void) const
+{
+  const qreal g = guessesLog10();
+  if (g < 3)
+    return 0;
+  if (g < 6)
+    return 1;
+  if (g < 8)
+    return 2;
+  if (g < 10)
+    return 3;
+  return 4;
+}
+
+
+/*!
+ * \brief StrengthEstimator::sequence
+ *
+ * \return The matches the estimate is based on, in password order.
+ */
+QVector<StrengthEstimator::Match> StrengthEstimator::sequence(void) const
+{
+  Q_D(const StrengthEstimator);
+  QVector<Match> matches;
+  if (d->rows.isEmpty())
+    return matches;
+  int k = d->rows.size() - 1;
+  int l = d->rows.last().bestLength;
+  while (k >= 0 && l > 0) {
+    const StrengthEstimatorPrivate::Row &row = d->rows.at(k);
+    const Match &m = row.matches.at(row.states.at(l).match);
+    matches.prepend(m);
+    k = m.i - 1;
+    --l;
+  }
+  return matches;
+}
+
+
+qreal StrengthEstimator::guessesLog10(const QString &password)
+{
+  StrengthEstimator estimator;
+  estimator.append(password);
+  return estimator.guessesLog10();
+}
+
+
+/*!
+ * \brief StrengthEstimator::crackSeconds
+ *
+ * \return The average time in seconds to find a password with the given
+ * number of guesses at a rate of `guessesPerSecond`.
+ */
+qreal StrengthEstimator::crackSeconds(qreal guessesLog10, qreal guessesPerSecond)
+{
+  if (qFuzzyIsNull(guessesPerSecond))
+    return std::numeric_limits<qreal>::infinity();
+  return .5 * std::pow(10.0, guessesLog10) / guessesPerSecond;
+}
@@ -0,0 +1,92 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __STRENGTHESTIMATOR_H_
+#define __STRENGTHESTIMATOR_H_
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+#include <QScopedPointer>
+
+class StrengthEstimatorPrivate;
+
+/*!
+ * \brief The StrengthEstimator class
+ *
+ * Estimates how many guesses an attacker needs to find a password, in the
+ * spirit of Dropbox's zxcvbn.
+ *
+ * The password is matched against common passwords and words (also
+ * reversed and in l33t spelling), keyboard walks on QWERTY, QWERTZ and
+ * keypad layouts, character sequences, repeats and dates. Every match
+ * gets a guess estimate. The cheapest way to cover the whole password
+ * with matches and brute-forced gaps determines the result.
+ *
+ * The estimator keeps the state of this search for every prefix of the
+ * password. Appending characters only evaluates matches that end in the
+ * new characters. Removing characters drops the state of the removed
+ * positions. `setPassword()` reuses everything up to the first changed
+ * character, so it can be fed the complete text on every keystroke.
+ */
+class StrengthEstimator
+{
+public:
+  enum Pattern {
+    Bruteforce,
+    Dictionary,
+    ReversedDictionary,
+    L33tDictionary,
+    Spatial,
+    Sequence,
+    Repeat,
+    Date
+  };
+
+  struct Match {
+    Pattern pattern;
+    int i;
+    int j;
+    qreal guessesLog10;
+  };
+
+  StrengthEstimator(void);
+  ~StrengthEstimator();
+
+  void setPassword(const QString &password);
+  void append(const QString &chars);
+  void chop(int n);
+  void clear(void);
+  const QString &password(void) const;
+
+  qreal guessesLog10(void) const;
+  int score(void) const;
+  QVector<Match> sequence(void) const;
+
+  static qreal guessesLog10(const QString &password);
+  static qreal crackSeconds(qreal guessesLog10, qreal guessesPerSecond);
+
+private:
+  QScopedPointer<StrengthEstimatorPrivate> d_ptr;
+  Q_DECLARE_PRIVATE(StrengthEstimator)
+  Q_DISABLE_COPY(StrengthEstimator)
+};
+
+
+#endif // __STRENGTHESTIMATOR_H_
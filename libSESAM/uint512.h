@@ -0,0 +1,104 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __UINT512_H_
+#define __UINT512_H_
+
+#include <QtGlobal>
+
+#include "util.h"
+
+
+/*!
+ * \brief The UInt512 class
+ *
+ * Unsigned 512 bit integer stored in eight 64 bit limbs, just large
+ * enough to hold a PBKDF2-HMAC-SHA512 key. The only arithmetic it
+ * offers is in-place division by a small divisor, which is all that
+ * `Password::remix()` needs to pick characters from the derived key.
+ */
+class UInt512
+{
+public:
+  enum {
+    Limbs = 8,
+    Size = Limbs * sizeof(quint64)
+  };
+
+  UInt512(void)
+  {
+    SecureErase(mLimb, sizeof(mLimb));
+  }
+
+  /*!
+   * Interprets `size` bytes at `bytes` as a big-endian number. `size` must not exceed `UInt512::Size`.
+   */
+  UInt512(const uchar *bytes, int size)
+  {
+    Q_ASSERT_X(size <= Size, "UInt512::UInt512()", "size must be <= 64");
+    SecureErase(mLimb, sizeof(mLimb));
+    for (int i = 0; i < size; ++i) {
+      const int bit = 8 * (size - 1 - i);
+      mLimb[bit / 64] |= quint64(bytes[i]) << (bit % 64);
+    }
+  }
+
+  ~UInt512()
+  {
+    SecureErase(mLimb, sizeof(mLimb));
+  }
+
+  /*!
+   * Divides the number by `divisor` in place and returns the remainder.
+   * `divisor` must be greater than 0.
+   *
+   * Each limb is processed as two 32 bit halves, so that the partial
+   * dividend (remainder << 32 | half) always fits into 64 bits.
+   */
+  quint32 divMod(quint32 divisor)
+  {
+    Q_ASSERT_X(divisor > 0, "UInt512::divMod()", "divisor must be > 0");
+    quint64 rem = 0;
+    for (int i = Limbs - 1; i >= 0; --i) {
+      const quint64 hi = (rem << 32) | (mLimb[i] >> 32);
+      const quint64 qHi = hi / divisor;
+      rem = hi % divisor;
+      const quint64 lo = (rem << 32) | (mLimb[i] & 0xffffffffU);
+      const quint64 qLo = lo / divisor;
+      rem = lo % divisor;
+      mLimb[i] = (qHi << 32) | qLo;
+    }
+    return quint32(rem);
+  }
+
+  bool isZero(void) const
+  {
+    quint64 acc = 0;
+    for (int i = 0; i < Limbs; ++i) {
+      acc |= mLimb[i];
+    }
+    return acc == 0;
+  }
+
+private:
+  quint64 mLimb[Limbs];
+};
+
+
+#endif // __UINT512_H_
@@ -0,0 +1,280 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "vaultaudit.h"
+#include "passwordbatch.h"
+#include "passwordtemplateplan.h"
+#include "strengthestimator.h"
+#include "password.h"
+#include "crypter.h"
+#include "cryptoexecutor.h"
+#include "util.h"
+
+#include <QAtomicInt>
+#include <QCryptographicHash>
+#include <QFuture>
+#include <QHash>
+#include <QMessageAuthenticationCode>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QThread>
+
+#include <algorithm>
+
+
+const int VaultAudit::DefaultMinIterations = 4096;
+const qreal VaultAudit::DefaultMinGuessesLog10 = 12;
+
+static const int ChunkSize = 64;
+static const int MacKeySize = 32;
+
+
+/*!
+ * \brief VaultAudit::Finding::severity
+ *
+ * \return A weighted sum of the issues of the entry; a breached password
+ * outweighs all other issues together, a reused password all but that.
+ */
+int VaultAudit::Finding::severity(void) const
+{
+  int s = 0;
+  if (issues & Breached)
+    s += 32;
+  if (issues & Reused)
+    s += 16;
+  if (issues & WeakPassword)
+    s += 8;
+  if (issues & InvalidTemplate)
+    s += 4;
+  if (issues & LowIterations)
+    s += 2;
+  if (issues & Expired)
+    s += 1;
+  return s;
+}
+
+
+static void wipe(QVector<SecureByteArray> &digests)
+{
+  for (int k = 0; k < digests.size(); ++k) {
+    digests[k].invalidate();
+  }
+}
+
+
+/*!
+ * \brief VaultAudit::run
+ *
+ * Audits all domains that are not marked as deleted. Blocks until the
+ * audit is finished or cancelled, so better call it from a worker thread.
+ *
+ * \param domains The domains to audit.
+ * \param KGK The key generation key to derive the generated passwords from.
+ * \param options Thresholds, breach lookup and number of worker threads.
+ * If `options.breachCheck` is empty, no breach lookup is done. It is called
+ * from several threads at the same time, so it must be thread-safe.
+ * The checks run on the calling thread and on `CryptoExecutor::Normal` helpers.
+ * Reused passwords are found by comparing HMACs under a key that is
+ * generated for this run only; all HMACs are wiped before returning.
+ * \param progress Called with the number of finished steps and the total number
+ * of steps (two per generated password, one per legacy password). Calls are
+ * serialized, but may come from any thread.
+ * \param token If not `Q_NULLPTR`, checked between steps.
+ * \return One finding per audited domain in list order, also for domains
+ * without issues; empty if the audit has been cancelled.
+ */
+QVector<VaultAudit::Finding> VaultAudit::run(const DomainSettingsList &domains, const SecureByteArray &KGK, const Options &options, const ProgressCallback &progress, const CancellationToken *token)
+{
+  auto cancelled = [token](void) {
+    return token != Q_NULLPTR && token->isCancelled();
+  };
+
+  QVector<int> audited;
+  DomainSettingsList generated;
+  QVector<int> generatedIndex;
+  audited.reserve(domains.size());
+  for (int i = 0; i < domains.size(); ++i) {
+    const DomainSettings &ds = domains.at(i);
+    if (ds.deleted)
+      continue;
+    audited.append(i);
+    if (ds.legacyPassword.isEmpty()) {
+      generated.append(ds);
+      generatedIndex.append(i);
+    }
+  }
+
+  const int total = audited.size() + generated.size();
+  QAtomicInt done;
+  QMutex progressMutex;
+  auto step = [&](void) {
+    const int n = done.fetchAndAddOrdered(1) + 1;
+    if (progress) {
+      QMutexLocker locker(&progressMutex);
+      progress(n, total);
+    }
+  };
+
+  QVector<SecureString> passwords(domains.size());
+  QVector<int> derivationErrors(domains.size(), Password::NoError);
+  PasswordBatch::derive(generated, KGK, [&](const PasswordBatch::Result &result) {
+    const int i = generatedIndex.at(result.index);
+    passwords[i] = result.password;
+    derivationErrors[i] = result.error;
+    step();
+  }, token, options.maxThreads);
+  if (cancelled())
+    return QVector<Finding>();
+
+  QVector<Finding> findings(audited.size());
+  const SecureByteArray macKey = Crypter::randomBytes(MacKeySize);
+  QVector<SecureByteArray> digests(audited.size());
+  auto check = [&](int k) {
+    const int i = audited.at(k);
+    const DomainSettings &ds = domains.at(i);
+    Finding &f = findings[k];
+    f.index = i;
+    f.domainName = ds.domainName;
+    f.userName = ds.userName;
+    f.iterations = ds.iterations;
+    f.expiryDate = ds.expiryDate;
+    f.legacy = !ds.legacyPassword.isEmpty();
+    if (ds.expired())
+      f.issues |= Expired;
+    if (!f.legacy && ds.iterations < options.minIterations)
+      f.issues |= LowIterations;
+    const SecureString &pwd = f.legacy ? ds.legacyPassword : passwords.at(i);
+    if (f.legacy) {
+      f.guessesLog10 = StrengthEstimator::guessesLog10(pwd);
+    }
+    else if (derivationErrors.at(i) != Password::NoError) {
+      f.issues |= InvalidTemplate;
+    }
+    else {
+      f.guessesLog10 = PasswordTemplatePlan::get(ds.passwordTemplate, ds.extraCharacters)->guessesLog10();
+    }
+    if (pwd.isEmpty())
+      return;
+    if (f.guessesLog10 < options.minGuessesLog10)
+      f.issues |= WeakPassword;
+    if (options.breachCheck && options.breachCheck(pwd, &f.breachCount))
+      f.issues |= Breached;
+    SecureByteArray utf8 = pwd.toUtf8();
+    digests[k] = QMessageAuthenticationCode::hash(utf8, macKey, QCryptographicHash::Sha256);
+    utf8.invalidate();
+  };
+
+  const int chunkCount = (audited.size() + ChunkSize - 1) / ChunkSize;
+  QAtomicInt nextChunk(0);
+  auto work = [&](void) {
+    forever {
+      const int c = nextChunk.fetchAndAddOrdered(1);
+      if (c >= chunkCount)
+        return;
+      const int k1 = qMin((c + 1) * ChunkSize, audited.size());
+      for (int k = c * ChunkSize; k < k1 && !cancelled(); ++k) {
+        check(k);
+        step();
+      }
+    }
+  };
+  const QString tag = QString("vaultaudit:%1").arg(quintptr(&nextChunk), 0, 16);
+  const int helperCount = qMin(chunkCount, options.maxThreads > 0 ? options.maxThreads : QThread::idealThreadCount()) - 1;
+  QVector<QFuture<void> > helpers;
+  for (int h = 0; h < helperCount; ++h) {
+    helpers.append(CryptoExecutor::instance().run(CryptoExecutor::Normal, tag, work));
+  }
+  work();
+  CryptoExecutor::instance().cancel(tag);
+  foreach (QFuture<void> helper, helpers) {
+    helper.waitForFinished();
+  }
+  for (int i = 0; i < passwords.size(); ++i) {
+    SecureErase(passwords[i]);
+  }
+  if (cancelled()) {
+    wipe(digests);
+    return QVector<Finding>();
+  }
+
+  QHash<QByteArray, int> uses;
+  uses.reserve(audited.size());
+  for (int k = 0; k < digests.size(); ++k) {
+    if (!digests.at(k).isEmpty()) {
+      ++uses[digests.at(k)];
+    }
+  }
+  QHash<QByteArray, int> groups;
+  for (int k = 0; k < digests.size(); ++k) {
+    if (digests.at(k).isEmpty())
+      continue;
+    const int n = uses.value(digests.at(k));
+    if (n < 2)
+      continue;
+    if (!groups.contains(digests.at(k))) {
+      groups.insert(digests.at(k), groups.size());
+    }
+    Finding &f = findings[k];
+    f.issues |= Reused;
+    f.reuseGroup = groups.value(digests.at(k));
+    f.reuseCount = n;
+  }
+  uses.clear();
+  groups.clear();
+  wipe(digests);
+  return findings;
+}
+
+
+/*!
+ * \brief VaultAudit::sort
+ *
+ * Sorts `findings` by `key`. The sort is stable, so sorting by a
+ * secondary key first and then by the primary key works as expected.
+ */
+void VaultAudit::sort(QVector<Finding> &findings, SortKey key, Qt::SortOrder order)
+{
+  std::function<bool(const Finding &, const Finding &)> less;
+  switch (key) {
+  case BySeverity:
+    less = [](const Finding &a, const Finding &b) { return a.severity() < b.severity(); };
+    break;
+  case ByDomainName:
+    less = [](const Finding &a, const Finding &b) { return QString::localeAwareCompare(a.domainName, b.domainName) < 0; };
+    break;
+  case ByUserName:
+    less = [](const Finding &a, const Finding &b) { return QString::localeAwareCompare(a.userName, b.userName) < 0; };
+    break;
+  case ByIterations:
+    less = [](const Finding &a, const Finding &b) { return a.iterations < b.iterations; };
+    break;
+  case ByStrength:
+    less = [](const Finding &a, const Finding &b) { return a.guessesLog10 < b.guessesLog10; };
+    break;
+  }
+  if (order == Qt::AscendingOrder) {
+    std::stable_sort(findings.begin(), findings.end(), less);
+  }
+  else {
+    std::stable_sort(findings.begin(), findings.end(), [&less](const Finding &a, const Finding &b) {
+      return less(b, a);
+    });
+  }
+}
@@ -0,0 +1,115 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __VAULTAUDIT_H_
+#define __VAULTAUDIT_H_
+
+#include <QString>
+#include <QVector>
+#include <QDateTime>
+
+#include <functional>
+
+#include "securebytearray.h"
+#include "securestring.h"
+#include "domainsettingslist.h"
+#include "cancellationtoken.h"
+
+
+/*!
+ * \brief The VaultAudit class
+ *
+ * Checks all domains of a vault for security problems: passwords that
+ * are used for more than one domain, passwords found in a breach list,
+ * weak passwords or templates, expired entries and low iteration counts.
+ *
+ * Generated passwords are derived with `PasswordBatch`, then all entries
+ * are checked in parallel. Reused passwords are found by bucketing a hash
+ * of every password, so the audit scales linearly with the vault size.
+ */
+class VaultAudit
+{
+public:
+  enum Issue {
+    NoIssue = 0x00,
+    Expired = 0x01,
+    LowIterations = 0x02,
+    WeakPassword = 0x04,
+    InvalidTemplate = 0x08,
+    Reused = 0x10,
+    Breached = 0x20
+  };
+
+  enum SortKey {
+    BySeverity,
+    ByDomainName,
+    ByUserName,
+    ByIterations,
+    ByStrength
+  };
+
+  struct Finding {
+    Finding(void)
+      : index(-1)
+      , legacy(false)
+      , issues(NoIssue)
+      , reuseGroup(-1)
+      , reuseCount(0)
+      , breachCount(0)
+      , guessesLog10(0)
+      , iterations(0)
+    { /* ... */ }
+    int severity(void) const;
+    int index;
+    QString domainName;
+    QString userName;
+    bool legacy;
+    int issues;
+    int reuseGroup;
+    int reuseCount;
+    quint32 breachCount;
+    qreal guessesLog10;
+    int iterations;
+    QDateTime expiryDate;
+  };
+
+  typedef std::function<bool(const SecureString &password, quint32 *breachCount)> BreachCheck;
+  typedef std::function<void(int done, int total)> ProgressCallback;
+
+  struct Options {
+    Options(void)
+      : minIterations(DefaultMinIterations)
+      , minGuessesLog10(DefaultMinGuessesLog10)
+      , maxThreads(-1)
+    { /* ... */ }
+    int minIterations;
+    qreal minGuessesLog10;
+    BreachCheck breachCheck;
+    int maxThreads;
+  };
+
+  static const int DefaultMinIterations;
+  static const qreal DefaultMinGuessesLog10;
+
+  static QVector<Finding> run(const DomainSettingsList &domains, const SecureByteArray &KGK, const Options &options, const ProgressCallback &progress = ProgressCallback(), const CancellationToken *token = Q_NULLPTR);
+  static void sort(QVector<Finding> &findings, SortKey key, Qt::SortOrder order = Qt::AscendingOrder);
+};
+
+
+#endif // __VAULTAUDIT_H_
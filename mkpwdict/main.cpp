@@ -0,0 +1,202 @@
+/*
+
+    Copyright (c) 2015-2018 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "passworddictionary.h"
+#include "breachedhashlist.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+
+
+static QString nextWord(QFile &in)
+{
+  return QString::fromLatin1(in.readLine()).trimmed();
+}
+
+
+/* Streams the list into the dictionary. Returns `false` and sets `outOfOrder`
+ * as soon as a word sorts before its predecessor.
+ */
+static bool buildFromSortedList(QFile &in, PasswordDictionaryBuilder &builder, bool &outOfOrder)
+{
+  QByteArray previous;
+  outOfOrder = false;
+  while (!in.atEnd()) {
+    const QByteArray &key = PasswordDictionary::key(nextWord(in));
+    if (key.isEmpty())
+      continue;
+    if (key < previous) {
+      outOfOrder = true;
+      return false;
+    }
+    if (!builder.addKey(key))
+      return false;
+    previous = key;
+  }
+  return true;
+}
+
+
+static bool buildFromUnsortedList(QFile &in, PasswordDictionaryBuilder &builder)
+{
+  QVector<QByteArray> keys;
+  while (!in.atEnd()) {
+    const QByteArray &key = PasswordDictionary::key(nextWord(in));
+    if (!key.isEmpty()) {
+      keys.append(key);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  foreach (const QByteArray &key, keys) {
+    if (!builder.addKey(key))
+      return false;
+  }
+  return true;
+}
+
+
+/* Reads lines of the form `<40 hex digits>[:<breach count>]`, as found in
+ * the SHA-1 "Pwned Passwords" downloads ordered by hash.
+ */
+static bool buildHashList(QFile &in, BreachedHashListBuilder &builder, QString &errorString)
+{
+  quint64 lineNo = 0;
+  while (!in.atEnd()) {
+    const QByteArray &line = in.readLine().trimmed();
+    ++lineNo;
+    if (line.isEmpty())
+      continue;
+    const int colon = line.indexOf(':');
+    const QByteArray &hex = (colon < 0) ? line : line.left(colon);
+    const QByteArray &sha1 = QByteArray::fromHex(hex);
+    bool countOk = true;
+    const quint32 breachCount = (colon < 0) ? 1 : line.mid(colon + 1).toUInt(&countOk);
+    if (!countOk || hex.size() != 2 * BreachedHashList::HashSize || sha1.size() != BreachedHashList::HashSize) {
+      errorString = QString("line %1: malformed hash record").arg(lineNo);
+      return false;
+    }
+    if (!builder.add(sha1, breachCount)) {
+      errorString = QString("line %1: %2").arg(lineNo).arg(builder.errorString());
+      return false;
+    }
+  }
+  return true;
+}
+
+
+static int makeHashList(QFile &in, const QString &outFilename, QTextStream &out, QTextStream &err)
+{
+  QSaveFile list(outFilename);
+  if (!list.open(QIODevice::WriteOnly)) {
+    err << "Cannot create " << outFilename << ": " << list.errorString() << endl;
+    return 1;
+  }
+  BreachedHashListBuilder builder(&list);
+  QString errorString;
+  if (!buildHashList(in, builder, errorString) || !builder.finish() || !list.commit()) {
+    err << "Cannot write " << outFilename << ": " << (errorString.isEmpty() ? list.errorString() : errorString) << endl;
+    return 1;
+  }
+  out << builder.count() << " hashes, " << in.size() << " -> " << QFileInfo(outFilename).size() << " bytes" << endl;
+  return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("mkpwdict");
+  QCoreApplication::setApplicationVersion(QTSESAM_VERSION);
+  QTextStream err(stderr);
+  QTextStream out(stdout);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Converts a list of breached passwords (one per line, Latin-1) into a compact Qt-SESAM password dictionary,\n"
+                                   "or a list of SHA-1 hashes sorted by hash (HASH[:COUNT] per line) into a breached hash list.");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  QCommandLineOption blockSizeOption(QStringList() << "b" << "block-size", "Number of entries per block (default: 64).", "entries", QString::number(PasswordDictionary::DefaultBlockSize));
+  parser.addOption(blockSizeOption);
+  QCommandLineOption sha1Option(QStringList() << "s" << "sha1", "Input is a list of SHA-1 hashes.");
+  parser.addOption(sha1Option);
+  parser.addPositionalArgument("input", "Text file with one password (or hash) per line.");
+  parser.addPositionalArgument("output", "Dictionary (or hash list) file to write.");
+  parser.process(app);
+
+  const QStringList &args = parser.positionalArguments();
+  if (args.size() != 2) {
+    parser.showHelp(1);
+  }
+  bool ok = false;
+  const int blockSize = parser.value(blockSizeOption).toInt(&ok);
+  if (!ok || blockSize < 1) {
+    err << "Invalid block size: " << parser.value(blockSizeOption) << endl;
+    return 1;
+  }
+
+  QFile in(args.at(0));
+  if (!in.open(QIODevice::ReadOnly)) {
+    err << "Cannot open " << args.at(0) << ": " << in.errorString() << endl;
+    return 1;
+  }
+  if (parser.isSet(sha1Option))
+    return makeHashList(in, args.at(1), out, err);
+
+  quint64 count = 0;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    QSaveFile dict(args.at(1));
+    if (!dict.open(QIODevice::WriteOnly)) {
+      err << "Cannot create " << args.at(1) << ": " << dict.errorString() << endl;
+      return 1;
+    }
+    PasswordDictionaryBuilder builder(&dict, blockSize);
+    bool outOfOrder = false;
+    in.seek(0);
+    ok = (attempt == 0)
+        ? buildFromSortedList(in, builder, outOfOrder)
+        : buildFromUnsortedList(in, builder);
+    if (outOfOrder) {
+      err << "Input is not sorted, sorting in memory ..." << endl;
+      dict.cancelWriting();
+      continue;
+    }
+    if (!ok || !builder.finish() || !dict.commit()) {
+      err << "Cannot write " << args.at(1) << ": " << (builder.errorString().isEmpty() ? dict.errorString() : builder.errorString()) << endl;
+      return 1;
+    }
+    count = builder.count();
+    break;
+  }
+
+  const qint64 inSize = in.size();
+  const qint64 outSize = QFileInfo(args.at(1)).size();
+  out << count << " passwords, " << inSize << " -> " << outSize << " bytes";
+  if (outSize > 0) {
+    out << QString(" (%1:1)").arg(qreal(inSize) / qreal(outSize), 0, 'f', 1);
+  }
+  out << endl;
+  return 0;
+}